@@ -633,6 +633,9 @@ struct FDropItem
 
 const double MinVel = EQUAL_EPSILON;
 
+// Set when the current map's blockmap keeps packed thing positions that must follow every move.
+extern bool PackedBlockThings;
+
 // Map Object definition.
 class AActor : public DThinker
 {
@@ -1196,6 +1199,7 @@ private:
 public:
 	void LinkToWorld (FLinkContext *ctx, bool spawningmapthing=false, sector_t *sector = NULL);
 	void UnlinkFromWorld(FLinkContext *ctx);
+	void UpdateBlockThings();
 	void AdjustFloorClip ();
 	bool IsMapActor();
 	int GetTics(FState * newstate);
@@ -1337,14 +1341,24 @@ public:
 	{
 		__Pos.X = npos.X;
 		__Pos.Y = npos.Y;
+		if (PackedBlockThings && BlockNode != nullptr) UpdateBlockThings();
 	}
 	void SetXYZ(double xx, double yy, double zz)
 	{
 		__Pos = { xx,yy,zz };
+		if (PackedBlockThings && BlockNode != nullptr) UpdateBlockThings();
 	}
 	void SetXYZ(const DVector3 &npos)
 	{
 		__Pos = npos;
+		if (PackedBlockThings && BlockNode != nullptr) UpdateBlockThings();
+	}
+
+	// Must be called after changing radius without relinking, so that the
+	// packed blockmap doesn't filter with the old one.
+	void UpdateBlockRadius()
+	{
+		if (PackedBlockThings && BlockNode != nullptr) UpdateBlockThings();
 	}
 
 	double VelXYToSpeed() const
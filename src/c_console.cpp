@@ -913,6 +913,8 @@ int PrintString (int iprintlevel, const char *outline)
 
 extern bool gameisdead;
 
+thread_local FPrintBuffer *PrintCapture;
+
 int VPrintf (int printlevel, const char *format, va_list parms)
 {
 	if (gameisdead)
@@ -920,9 +922,31 @@ int VPrintf (int printlevel, const char *format, va_list parms)
 
 	FString outline;
 	outline.VFormat (format, parms);
+	if (PrintCapture != nullptr)
+	{
+		PrintCapture->Messages.Push({ printlevel, outline });
+		return (int)outline.Len();
+	}
 	return PrintString (printlevel, outline.GetChars());
 }
 
+//==========================================================================
+//
+// FPrintBuffer :: Flush
+//
+// Prints everything that was captured. Must be called on the main thread.
+//
+//==========================================================================
+
+void FPrintBuffer::Flush()
+{
+	for (auto &msg : Messages)
+	{
+		PrintString(msg.PrintLevel, msg.Text.GetChars());
+	}
+	Messages.Clear();
+}
+
 int Printf (int printlevel, const char *format, ...)
 {
 	va_list argptr;
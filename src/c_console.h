@@ -36,6 +36,7 @@
 
 #include <stdarg.h>
 #include "basictypes.h"
+#include "zstring.h"
 
 struct event_t;
 
@@ -70,6 +71,22 @@ int PrintString (int printlevel, const char *string);
 int PrintStringHigh (const char *string);
 int VPrintf (int printlevel, const char *format, va_list parms) GCCFORMAT(2);
 
+// While set, everything printed on this thread is collected here instead,
+// so that output of work done on several threads can be printed in order.
+struct FPrintBuffer
+{
+	struct Entry
+	{
+		int PrintLevel;
+		FString Text;
+	};
+	TArray<Entry> Messages;
+
+	void Flush();
+};
+
+extern thread_local FPrintBuffer *PrintCapture;
+
 void C_DrawConsole ();
 void C_ToggleConsole (void);
 void C_FullConsole (void);
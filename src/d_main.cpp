@@ -101,6 +101,7 @@
 #include "types.h"
 #include "i_system.h"
 #include "g_cvars.h"
+#include "g_benchmark.h"
 #include "r_data/r_vanillatrans.h"
 
 EXTERN_CVAR(Bool, hud_althud)
@@ -663,6 +664,9 @@ void D_Display ()
 	int wipe_type;
 	sector_t *viewsec;
 
+	if (benchmarking)
+		G_BenchmarkRenderFrame();	// renders offscreen, the benchmark never draws to the screen
+
 	if (nodrawers || screen == NULL)
 		return; 				// for comparative timing / profiling
 	
@@ -2620,7 +2624,11 @@ void D_DoomMain (void)
 				throw CNoRunExit();
 			}
 
-			V_Init2();
+			// A headless benchmark keeps the dummy frame buffer from startup and never opens a window.
+			if (!Args->CheckParm("-benchmark") || !Args->CheckParm("-timedemo"))
+			{
+				V_Init2();
+			}
 			UpdateJoystickMenu(NULL);
 			UpdateVRModes();
 
@@ -73,6 +73,7 @@
 #include "intermission/intermission.h"
 #include "g_levellocals.h"
 #include "events.h"
+#include "i_time.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -102,8 +103,73 @@
 #define GCSWEEPCOST		10
 #define GCFINALIZECOST	100
 
+// Number of single steps between clock checks when a tic budget is set.
+#define GCBUDGETCHECK	16
+
+// Objects up to this size are allocated from slabs, in size classes of SLABGRANULARITY bytes.
+#define SLABMAXOBJECT	4096
+#define SLABGRANULARITY	32
+#define SLABSIZE		65536
+
+// Every object gets a header in front of it that points to the slab it came from.
+#define SLABHEADER		16
+
 // TYPES -------------------------------------------------------------------
 
+// Histogram of collector pauses for the gcstats command.
+struct FGCPauseHistogram
+{
+	enum { NUM_BUCKETS = 9 };
+	static const unsigned Limits[NUM_BUCKETS - 1];	// upper bounds in microseconds
+
+	unsigned Counts[NUM_BUCKETS];
+	unsigned Num;
+	uint64_t Total;
+	uint64_t Max;
+
+	void Reset()
+	{
+		memset(Counts, 0, sizeof(Counts));
+		Num = 0;
+		Total = Max = 0;
+	}
+
+	void Add(uint64_t us)
+	{
+		int i = 0;
+		while (i < NUM_BUCKETS - 1 && us >= Limits[i]) i++;
+		Counts[i]++;
+		Num++;
+		Total += us;
+		Max = MAX(Max, us);
+	}
+
+	void Print(const char *title) const;
+};
+
+struct FObjectSlabClass;
+
+// One block of equally sized object slots.
+struct FObjectSlab
+{
+	FObjectSlab *Next, *Prev;		// in the owner's list of slabs with free slots
+	FObjectSlabClass *Owner;
+	uint8_t *Memory;
+	void *FreeList;
+	unsigned Used;
+	bool Partial;
+};
+
+struct FObjectSlabClass
+{
+	size_t SlotSize;
+	unsigned SlotsPerSlab;
+	unsigned NumSlabs;
+	unsigned NumEmpty;
+	unsigned Used;
+	FObjectSlab *Partial;
+};
+
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 
 // PUBLIC FUNCTION PROTOTYPES ----------------------------------------------
@@ -116,9 +182,12 @@ extern DThinker *NextToThink;
 
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
 
+// Maximum time in microseconds the incremental collector may spend per game tic. 0 means no limit.
+CVAR(Int, gc_ticbudget, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
 namespace GC
 {
-size_t AllocBytes;
+std::atomic<size_t> AllocBytes;
 size_t Threshold;
 size_t Estimate;
 DObject *Gray;
@@ -135,8 +204,146 @@ bool FinalGC;
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
+static int BudgetTic = -1;
+static uint64_t TicTime;			// nanoseconds spent in Step() during BudgetTic
+static unsigned BudgetOverruns;		// Step() calls cut short by the budget
+static unsigned BudgetSkips;		// Step() calls skipped because the budget was used up
+static FGCPauseHistogram StepPauses, TicPauses;
+
+// Plain pointers so that nothing here gets destroyed before the final collection at exit.
+static FObjectSlabClass *SlabClasses[SLABMAXOBJECT / SLABGRANULARITY + 1];
+static size_t LargeObjects;
+
 // CODE --------------------------------------------------------------------
 
+//==========================================================================
+//
+// Object slabs
+//
+// DObjects are allocated and freed all the time during play, so instead of
+// going through the heap for each of them they are taken from fixed size
+// slots in larger blocks, with one set of blocks per size class.
+//
+//==========================================================================
+
+static void LinkPartial(FObjectSlab *slab)
+{
+	auto cls = slab->Owner;
+	slab->Prev = nullptr;
+	slab->Next = cls->Partial;
+	if (cls->Partial != nullptr) cls->Partial->Prev = slab;
+	cls->Partial = slab;
+	slab->Partial = true;
+}
+
+static void UnlinkPartial(FObjectSlab *slab)
+{
+	auto cls = slab->Owner;
+	if (slab->Prev != nullptr) slab->Prev->Next = slab->Next;
+	else cls->Partial = slab->Next;
+	if (slab->Next != nullptr) slab->Next->Prev = slab->Prev;
+	slab->Next = slab->Prev = nullptr;
+	slab->Partial = false;
+}
+
+static FObjectSlab *NewSlab(FObjectSlabClass *cls)
+{
+	auto slab = new FObjectSlab;
+	slab->Owner = cls;
+	slab->Memory = (uint8_t *)malloc(SLABSIZE);
+	if (slab->Memory == nullptr)
+	{
+		I_FatalError("Could not allocate %d bytes for objects", SLABSIZE);
+	}
+	slab->Used = 0;
+
+	// Build the free list in address order so that objects allocated in sequence end up next to each other.
+	slab->FreeList = nullptr;
+	for (unsigned i = cls->SlotsPerSlab; i-- > 0; )
+	{
+		void **slot = (void **)(slab->Memory + i * cls->SlotSize);
+		*slot = slab->FreeList;
+		slab->FreeList = slot;
+	}
+	cls->NumSlabs++;
+	cls->NumEmpty++;
+	LinkPartial(slab);
+	return slab;
+}
+
+void *AllocObject(size_t size)
+{
+	uint8_t *block;
+
+	if (size > SLABMAXOBJECT)
+	{
+		block = (uint8_t *)M_Malloc(size + SLABHEADER);
+		*(FObjectSlab **)block = nullptr;
+		LargeObjects++;
+		return block + SLABHEADER;
+	}
+
+	unsigned index = unsigned((size + SLABGRANULARITY - 1) / SLABGRANULARITY);
+	auto cls = SlabClasses[index];
+	if (cls == nullptr)
+	{
+		cls = SlabClasses[index] = new FObjectSlabClass;
+		cls->SlotSize = index * SLABGRANULARITY + SLABHEADER;
+		cls->SlotsPerSlab = unsigned(SLABSIZE / cls->SlotSize);
+		cls->NumSlabs = cls->NumEmpty = cls->Used = 0;
+		cls->Partial = nullptr;
+	}
+
+	auto slab = cls->Partial != nullptr ? cls->Partial : NewSlab(cls);
+	block = (uint8_t *)slab->FreeList;
+	slab->FreeList = *(void **)block;
+	if (slab->Used++ == 0) cls->NumEmpty--;
+	if (slab->FreeList == nullptr) UnlinkPartial(slab);
+	cls->Used++;
+	AllocBytes += cls->SlotSize;
+
+	*(FObjectSlab **)block = slab;
+	return block + SLABHEADER;
+}
+
+void FreeObject(void *mem)
+{
+	if (mem == nullptr) return;
+
+	uint8_t *block = (uint8_t *)mem - SLABHEADER;
+	auto slab = *(FObjectSlab **)block;
+	if (slab == nullptr)
+	{
+		LargeObjects--;
+		M_Free(block);
+		return;
+	}
+
+	auto cls = slab->Owner;
+	*(void **)block = slab->FreeList;
+	slab->FreeList = block;
+	cls->Used--;
+	AllocBytes -= cls->SlotSize;
+	if (!slab->Partial) LinkPartial(slab);
+
+	if (--slab->Used == 0)
+	{
+		// Keep one empty slab per size class so that an object getting spawned
+		// and destroyed over and over does not allocate a new slab every time.
+		if (cls->NumEmpty > 0)
+		{
+			UnlinkPartial(slab);
+			free(slab->Memory);
+			delete slab;
+			cls->NumSlabs--;
+		}
+		else
+		{
+			cls->NumEmpty++;
+		}
+	}
+}
+
 //==========================================================================
 //
 // SetThreshold
@@ -400,27 +607,56 @@ static size_t SingleStep()
 
 void Step()
 {
+	if (gametic != BudgetTic)
+	{
+		if (TicTime > 0) TicPauses.Add(TicTime / 1000);
+		TicTime = 0;
+		BudgetTic = gametic;
+	}
+
+	// The budget is ignored once memory has grown to twice the live size
+	// of the last collection so that the collector can never fall behind
+	// allocation indefinitely.
+	uint64_t budget = gc_ticbudget > 0 && !FinalGC && AllocBytes / 2 <= Estimate ? (uint64_t)gc_ticbudget * 1000 : 0;
+	if (budget > 0 && TicTime >= budget)
+	{
+		// Try again next tic. The threshold stays as is so that no debt is lost.
+		BudgetSkips++;
+		return;
+	}
+
+	uint64_t start = I_nsTime();
 	size_t lim = (GCSTEPSIZE/100) * StepMul;
 	size_t olim;
+	int steps = 0;
 	if (lim == 0)
 	{
 		lim = (~(size_t)0) / 2;		// no limit
 	}
+	size_t steplim = lim;
+	size_t paid = GCSTEPSIZE;
 	Dept += AllocBytes - Threshold;
 	do
 	{
 		olim = lim;
 		lim -= SingleStep();
+		if (budget > 0 && ++steps % GCBUDGETCHECK == 0 && TicTime + (I_nsTime() - start) >= budget)
+		{
+			// Only the work actually done gets paid off. The rest is carried over to the next step.
+			if (lim < steplim) paid = (size_t)((double)GCSTEPSIZE * (steplim - lim) / steplim);
+			BudgetOverruns++;
+			break;
+		}
 	} while (olim > lim && State != GCS_Pause);
 	if (State != GCS_Pause)
 	{
-		if (Dept < GCSTEPSIZE)
+		if (Dept < paid)
 		{
-			Threshold = AllocBytes + GCSTEPSIZE;	// - lim/StepMul
+			Threshold = AllocBytes + paid;	// - lim/StepMul
 		}
 		else
 		{
-			Dept -= GCSTEPSIZE;
+			Dept -= paid;
 			Threshold = AllocBytes;
 		}
 	}
@@ -430,6 +666,10 @@ void Step()
 		SetThreshold();
 	}
 	StepCount++;
+
+	uint64_t elapsed = I_nsTime() - start;
+	TicTime += elapsed;
+	StepPauses.Add(elapsed / 1000);
 }
 
 //==========================================================================
@@ -610,6 +850,82 @@ ADD_STAT(gc)
 	return out;
 }
 
+//==========================================================================
+//
+// FGCPauseHistogram :: Print
+//
+//==========================================================================
+
+const unsigned FGCPauseHistogram::Limits[NUM_BUCKETS - 1] = { 50, 100, 250, 500, 1000, 2000, 5000, 10000 };
+
+void FGCPauseHistogram::Print(const char *title) const
+{
+	Printf(TEXTCOLOR_YELLOW "%s: %u, avg %.1f us, max %llu us\n", title, Num,
+		Num > 0 ? double(Total) / Num : 0., (unsigned long long)Max);
+	for (int i = 0; i < NUM_BUCKETS; i++)
+	{
+		if (i < NUM_BUCKETS - 1)
+		{
+			Printf("  < %5u us: %u\n", Limits[i], Counts[i]);
+		}
+		else
+		{
+			Printf(" >= %5u us: %u\n", Limits[i - 1], Counts[i]);
+		}
+	}
+}
+
+//==========================================================================
+//
+// CCMD gcstats
+//
+// Prints histograms of the time spent in the collector, both per step
+// and per game tic.
+//
+//==========================================================================
+
+CCMD(gcstats)
+{
+	if (argv.argc() > 1 && stricmp(argv[1], "reset") == 0)
+	{
+		GC::StepPauses.Reset();
+		GC::TicPauses.Reset();
+		GC::BudgetOverruns = GC::BudgetSkips = 0;
+		return;
+	}
+	if (argv.argc() > 1 && stricmp(argv[1], "slabs") == 0)
+	{
+		Printf(TEXTCOLOR_YELLOW "Slot size   Slabs   Used slots   Free slots\n");
+		for (auto cls : GC::SlabClasses)
+		{
+			if (cls != nullptr && cls->NumSlabs > 0)
+			{
+				Printf("%9zu  %6u  %11u  %11u\n", cls->SlotSize, cls->NumSlabs, cls->Used, cls->NumSlabs * cls->SlotsPerSlab - cls->Used);
+			}
+		}
+		return;
+	}
+	GC::StepPauses.Print("GC steps");
+	GC::TicPauses.Print("Tics with GC activity");
+	if (gc_ticbudget > 0)
+	{
+		Printf("Tic budget %d us: %u steps cut short, %u steps deferred\n", *gc_ticbudget, GC::BudgetOverruns, GC::BudgetSkips);
+	}
+
+	unsigned slabs = 0, used = 0, slots = 0;
+	for (auto cls : GC::SlabClasses)
+	{
+		if (cls != nullptr)
+		{
+			slabs += cls->NumSlabs;
+			used += cls->Used;
+			slots += cls->NumSlabs * cls->SlotsPerSlab;
+		}
+	}
+	Printf("Object slabs: %u (%u KB), %u of %u slots used (%.1f%% free), %zu large objects\n",
+		slabs, slabs * (SLABSIZE / 1024), used, slots, slots > 0 ? 100. * (slots - used) / slots : 0., GC::LargeObjects);
+}
+
 //==========================================================================
 //
 // CCMD gc
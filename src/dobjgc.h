@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <atomic>
 class DObject;
 class FSerializer;
 
@@ -40,7 +41,8 @@ namespace GC
 	};
 
 	// Number of bytes currently allocated through M_Malloc/M_Realloc.
-	extern size_t AllocBytes;
+	// Atomic because the worker pool's jobs allocate, too.
+	extern std::atomic<size_t> AllocBytes;
 
 	// Amount of memory to allocate before triggering a collection.
 	extern size_t Threshold;
@@ -78,6 +80,12 @@ namespace GC
 	// Frees all objects, whether they're dead or not.
 	void FreeAll();
 
+	// Allocates memory for a DObject. Small objects come from slabs of equally sized slots.
+	void *AllocObject(size_t size);
+
+	// Releases memory allocated by AllocObject.
+	void FreeObject(void *mem);
+
 	// Does one collection step.
 	void Step();
 
@@ -2718,6 +2718,7 @@ void FParser::SF_MoveCamera(void)
 		bool finishedangle = false;
 
 		cam->radius = 1 / 8192.;
+		cam->UpdateBlockRadius();
 		cam->Height = 1 / 8192.;
 
 		if (campos != targpos)
@@ -3283,6 +3284,7 @@ void FParser::SF_Resurrect()
 		mo->SetState(state);
 		mo->Height = mo->GetDefault()->Height;
 		mo->radius = mo->GetDefault()->radius;
+		mo->UpdateBlockRadius();
 		mo->Revive();
 		mo->target = nullptr;
 	}
@@ -3566,7 +3568,10 @@ void FParser::SF_MobjRadius(void)
 		if(t_argc > 1)
 		{
 			if(mo) 
+			{
 				mo->radius = floatvalue(t_argv[1]);
+				mo->UpdateBlockRadius();
+			}
 		}
 		t_return.setDouble(mo ? mo->radius : 0.);
 	}
@@ -0,0 +1,391 @@
+//-----------------------------------------------------------------------------
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// Headless playsim benchmark.
+//
+// Started with -timedemo <demo> -benchmark <file.json>. The game runs without
+// creating a window and without sound, plays the demo back as fast as possible
+// and writes the cost of every playsim tic to a JSON file when the demo ends.
+//
+// -benchmarkthinkers adds the time spent per thinker class. Timing every
+// thinker costs time of its own, which then shows up in the tic times, and
+// it keeps the thinkers from being ticked in parallel, so it is off by default.
+//
+// With -benchmarkrender <width>x<height> every frame is also rendered by the
+// software renderer (or the poly renderer, depending on vid_rendermode) into
+// an offscreen canvas of that size. The frame time, the renderer's own stage
+// timings and a CRC32 of the rendered image are recorded for each frame, so
+// that both speed and output can be compared between builds. They are written
+// to the "frames" array, their totals to the "render" object. The scene is
+// rendered on a single thread meanwhile, so the images do not depend on timing.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <memory>
+
+#include "doomtype.h"
+#include "g_benchmark.h"
+#include "i_time.h"
+#include "stats.h"
+#include "name.h"
+#include "files.h"
+#include "serializer.h"
+#include "c_console.h"
+#include "d_player.h"
+#include "g_game.h"
+#include "g_levellocals.h"
+#include "r_renderer.h"
+#include "r_utility.h"
+#include "v_video.h"
+#include "m_crc32.h"
+#include "swrenderer/scene/r_scene.h"
+#include "polyrenderer/poly_renderer.h"
+
+extern cycle_t SightCycles;
+extern cycle_t CheckPositionCycles;
+extern cycle_t VMCycles[10];
+
+EXTERN_CVAR(Int, r_scene_multithreaded)
+
+bool benchmarking;
+bool benchmarkthinkers;
+
+struct FBenchmarkThinker
+{
+	int numcalls = 0;
+	double time = 0;
+};
+
+static FString BenchmarkFile;
+static TArray<double> TicTimes;
+static TMap<FName, FBenchmarkThinker> ThinkerTimes;
+static double SightTime, CheckPositionTime, VMTime;
+static double TicCheckPositionTime, TicVMTime;
+static uint64_t TicStart;
+
+struct FBenchmarkFrame
+{
+	double time;
+	double stages[4];
+	uint32_t crc;
+};
+
+static std::unique_ptr<DCanvas> RenderCanvas;
+static TArray<FBenchmarkFrame> Frames;
+static const char *const *StageNames;
+static int SavedSceneThreads;
+
+static const char *const SWStageNames[] = { "walls_ms", "planes_ms", "masked_ms", "drawerwait_ms" };
+static const char *const PolyStageNames[] = { "cull_ms", "opaque_ms", "masked_ms", "drawerwait_ms" };
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void G_BeginBenchmark(const char *filename, bool profilethinkers, int renderwidth, int renderheight)
+{
+	benchmarking = true;
+	benchmarkthinkers = profilethinkers;
+	BenchmarkFile = filename;
+	TicTimes.Clear();
+	ThinkerTimes.Clear();
+	Frames.Clear();
+	SightTime = CheckPositionTime = VMTime = 0;
+
+	RenderCanvas.reset();
+	if (renderwidth > 0 && renderheight > 0)
+	{
+		if (V_IsHardwareRenderer())
+		{
+			Printf("Render benchmark needs vid_rendermode 0 to 3, only the playsim will be measured\n");
+		}
+		else
+		{
+			RenderCanvas.reset(new DCanvas(renderwidth, renderheight, V_IsTrueColor()));
+			StageNames = V_IsPolyRenderer() ? PolyStageNames : SWStageNames;
+
+			// With several scene threads the view is split at column boundaries that follow the
+			// measured cost of the previous frames, so the image could differ between runs.
+			// One scene thread keeps the CRCs comparable. The drawers still run threaded.
+			SavedSceneThreads = r_scene_multithreaded;
+			r_scene_multithreaded = 0;
+		}
+	}
+}
+
+//==========================================================================
+//
+// Called around P_Ticker. The sight counters get reset by P_Ticker itself,
+// the others keep running so only their difference is taken.
+//
+//==========================================================================
+
+void G_BenchmarkTicStart()
+{
+	TicCheckPositionTime = CheckPositionCycles.TimeMS();
+	TicVMTime = VMCycles[0].TimeMS();
+	TicStart = I_nsTime();
+}
+
+void G_BenchmarkTicEnd()
+{
+	TicTimes.Push((I_nsTime() - TicStart) / 1e6);
+	SightTime += SightCycles.TimeMS();
+	CheckPositionTime += CheckPositionCycles.TimeMS() - TicCheckPositionTime;
+	VMTime += VMCycles[0].TimeMS() - TicVMTime;
+}
+
+void G_BenchmarkThinker(FName classname, int numcalls, double time)
+{
+	auto &info = ThinkerTimes[classname];
+	info.numcalls += numcalls;
+	info.time += time;
+}
+
+//==========================================================================
+//
+// Called once per displayed frame in place of D_Display's rendering.
+// The stage timings are the same ones the fps stat shows, which the
+// renderers reset at the start of every view.
+//
+//==========================================================================
+
+void G_BenchmarkRenderFrame()
+{
+	if (RenderCanvas == nullptr || gamestate != GS_LEVEL) return;
+
+	player_t *player = &players[consoleplayer];
+	if (player->camera == nullptr)
+	{
+		player->camera = player->mo;
+	}
+	AActor *cam = player->camera;
+	if (cam == nullptr) return;
+
+	R_SetFOV(r_viewpoint, cam->player ? cam->player->FOV : cam->CameraFOV);
+
+	uint64_t start = I_nsTime();
+	SWRenderer->RenderViewToCanvas(cam, RenderCanvas.get());
+
+	FBenchmarkFrame frame;
+	frame.time = (I_nsTime() - start) / 1e6;
+	if (V_IsPolyRenderer())
+	{
+		frame.stages[0] = PolyCullCycles.TimeMS();
+		frame.stages[1] = PolyOpaqueCycles.TimeMS();
+		frame.stages[2] = PolyMaskedCycles.TimeMS();
+		frame.stages[3] = PolyDrawerWaitCycles.TimeMS();
+	}
+	else
+	{
+		frame.stages[0] = swrenderer::WallCycles.TimeMS();
+		frame.stages[1] = swrenderer::PlaneCycles.TimeMS();
+		frame.stages[2] = swrenderer::MaskedCycles.TimeMS();
+		frame.stages[3] = swrenderer::DrawerWaitCycles.TimeMS();
+	}
+
+	// Only hash the visible part of each row. The pitch padding is never written to.
+	int pixelsize = RenderCanvas->IsBgra() ? 4 : 1;
+	int rowbytes = RenderCanvas->GetWidth() * pixelsize;
+	int pitchbytes = RenderCanvas->GetPitch() * pixelsize;
+	const uint8_t *pixels = RenderCanvas->GetPixels();
+	uint32_t crc = 0;
+	for (int y = 0; y < RenderCanvas->GetHeight(); y++)
+	{
+		crc = AddCRC32(crc, pixels + y * pitchbytes, rowbytes);
+	}
+	frame.crc = crc;
+	Frames.Push(frame);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static double Percentile(const TArray<double> &sorted, double p)
+{
+	if (sorted.Size() == 0) return 0;
+	return sorted[std::min<unsigned>(sorted.Size() - 1, unsigned(p * sorted.Size()))];
+}
+
+//==========================================================================
+//
+// Writes the "render" totals and the "frames" array of a render benchmark.
+//
+//==========================================================================
+
+static void WriteRenderBenchmark(FSerializer &arc)
+{
+	TArray<double> sorted;
+	double total = 0;
+	double stages[4] = { 0, 0, 0, 0 };
+	for (auto &frame : Frames)
+	{
+		sorted.Push(frame.time);
+		total += frame.time;
+		for (int i = 0; i < 4; i++) stages[i] += frame.stages[i];
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	int numframes = Frames.Size();
+	int width = RenderCanvas->GetWidth();
+	int height = RenderCanvas->GetHeight();
+	double mean = numframes > 0 ? total / numframes : 0;
+	double median = Percentile(sorted, 0.5);
+	double p95 = Percentile(sorted, 0.95);
+	double p99 = Percentile(sorted, 0.99);
+	double max = numframes > 0 ? sorted.Last() : 0;
+
+	if (arc.BeginObject("render"))
+	{
+		arc.AddString("renderer", StageNames == PolyStageNames ? "poly" : "software");
+		arc("width", width)
+			("height", height)
+			("frames", numframes)
+			("total_ms", total)
+			("mean_ms", mean)
+			("median_ms", median)
+			("p95_ms", p95)
+			("p99_ms", p99)
+			("max_ms", max);
+		for (int i = 0; i < 4; i++)
+		{
+			arc(StageNames[i], stages[i]);
+		}
+		arc.EndObject();
+	}
+
+	if (arc.BeginArray("frames"))
+	{
+		for (auto &frame : Frames)
+		{
+			arc.BeginObject(nullptr);
+			arc("ms", frame.time);
+			for (int i = 0; i < 4; i++)
+			{
+				arc(StageNames[i], frame.stages[i]);
+			}
+			arc.AddString("crc", FStringf("%08x", frame.crc).GetChars());
+			arc.EndObject();
+		}
+		arc.EndArray();
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void G_WriteBenchmark(const char *demoname)
+{
+	if (!benchmarking) return;
+	benchmarking = false;
+
+	TArray<double> sorted = TicTimes;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0;
+	for (auto t : sorted) total += t;
+
+	int tics = sorted.Size();
+	double mean = tics > 0 ? total / tics : 0;
+	double median = Percentile(sorted, 0.5);
+	double p95 = Percentile(sorted, 0.95);
+	double p99 = Percentile(sorted, 0.99);
+	double max = tics > 0 ? sorted.Last() : 0;
+
+	struct SortedThinker
+	{
+		FName className;
+		FBenchmarkThinker info;
+	};
+	TArray<SortedThinker> thinkers;
+	TMap<FName, FBenchmarkThinker>::Iterator it(ThinkerTimes);
+	TMap<FName, FBenchmarkThinker>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		thinkers.Push({ pair->Key, pair->Value });
+	}
+	std::sort(thinkers.begin(), thinkers.end(), [](const SortedThinker &left, const SortedThinker &right)
+	{
+		return right.info.time < left.info.time;
+	});
+
+	FSerializer arc(nullptr);
+	arc.OpenWriter(true);
+	arc.AddString("demo", demoname);
+	arc("tics", tics)
+		("total_ms", total)
+		("mean_ms", mean)
+		("median_ms", median)
+		("p95_ms", p95)
+		("p99_ms", p99)
+		("max_ms", max)
+		("checkposition_ms", CheckPositionTime)
+		("checksight_ms", SightTime)
+		("vm_ms", VMTime);
+
+	if (benchmarkthinkers && arc.BeginArray("thinkers"))
+	{
+		for (auto &t : thinkers)
+		{
+			arc.BeginObject(nullptr);
+			arc.AddString("class", t.className.GetChars());
+			arc("calls", t.info.numcalls)
+				("ms", t.info.time);
+			arc.EndObject();
+		}
+		arc.EndArray();
+	}
+	if (arc.BeginArray("tic_ms"))
+	{
+		for (auto &t : TicTimes)
+		{
+			arc(nullptr, t);
+		}
+		arc.EndArray();
+	}
+	if (RenderCanvas != nullptr)
+	{
+		WriteRenderBenchmark(arc);
+		r_scene_multithreaded = SavedSceneThreads;
+	}
+	benchmarkthinkers = false;
+
+	unsigned len;
+	const char *output = arc.GetOutput(&len);
+	auto fw = FileWriter::Open(BenchmarkFile);
+	if (fw == nullptr || fw->Write(output, len) != len)
+	{
+		Printf("Could not write benchmark results to %s\n", BenchmarkFile.GetChars());
+	}
+	else
+	{
+		Printf("Benchmark results written to %s\n", BenchmarkFile.GetChars());
+	}
+	delete fw;
+
+	RenderCanvas.reset();
+	Frames.Reset();
+}
@@ -0,0 +1,16 @@
+#ifndef __G_BENCHMARK_H
+#define __G_BENCHMARK_H
+
+class FName;
+
+extern bool benchmarking;
+extern bool benchmarkthinkers;
+
+void G_BeginBenchmark(const char *filename, bool profilethinkers, int renderwidth = 0, int renderheight = 0);
+void G_BenchmarkTicStart();
+void G_BenchmarkTicEnd();
+void G_BenchmarkThinker(FName classname, int numcalls, double time);
+void G_BenchmarkRenderFrame();
+void G_WriteBenchmark(const char *demoname);
+
+#endif
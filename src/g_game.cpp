@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <memory>
+#include <mutex>
+#include <future>
 
 #include "i_time.h"
 #include "templates.h"
@@ -76,8 +78,10 @@
 #include "i_system.h"
 
 #include "g_hub.h"
+#include "g_benchmark.h"
 #include "g_levellocals.h"
 #include "events.h"
+#include "ctpl.h"
 
 
 static FRandom pr_dmspawn ("DMSpawn");
@@ -96,18 +100,22 @@ void	G_DoVictory (void);
 void	G_DoWorldDone (void);
 void	G_DoSaveGame (bool okForQuicksave, FString filename, const char *description);
 void	G_DoAutoSave ();
+static void G_CheckPendingSaves ();
+static void G_WaitForPendingSaves ();
 
 void STAT_Serialize(FSerializer &file);
 bool WriteZip(const char *filename, TArray<FString> &filenames, TArray<FCompressedBuffer> &content);
 
 FIntCVar gameskill ("skill", 2, CVAR_SERVERINFO|CVAR_LATCH);
 CVAR(Bool, save_formatted, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use formatted JSON for saves (more readable but a larger files and a bit slower.
+CVAR(Bool, save_binary, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)		// use the binary format for saves and hub snapshots (smaller and faster but not human readable).
 CVAR (Int, deathmatch, 0, CVAR_SERVERINFO|CVAR_LATCH);
 CVAR (Bool, chasedemo, false, 0);
 CVAR (Bool, storesavepic, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR (Bool, longsavemessages, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR (String, save_dir, "", CVAR_ARCHIVE|CVAR_GLOBALCONFIG);
 CVAR (Bool, cl_waitforsave, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR (Bool, save_async, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);	// compress and write savegames on a background thread.
 CVAR (Bool, enablescriptscreenshot, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 EXTERN_CVAR (Float, con_midtime);
 
@@ -1033,6 +1041,8 @@ void G_Ticker ()
 		AddCommandString ("toggle fullscreen");
 	}
 
+	G_CheckPendingSaves ();
+
 	// do things to change the game state
 	oldgamestate = gamestate;
 	while (gameaction != ga_nothing)
@@ -1184,7 +1194,9 @@ void G_Ticker ()
 	switch (gamestate)
 	{
 	case GS_LEVEL:
+		if (benchmarking) G_BenchmarkTicStart();
 		P_Ticker ();
+		if (benchmarking) G_BenchmarkTicEnd();
 		primaryLevel->automap->Ticker ();
 		break;
 
@@ -1801,6 +1813,9 @@ void G_DoLoadGame ()
 	hidecon = gameaction == ga_loadgamehidecon;
 	gameaction = ga_nothing;
 
+	// The file may still be in the process of being written.
+	G_WaitForPendingSaves ();
+
 	std::unique_ptr<FResourceFile> resfile(FResourceFile::OpenResourceFile(savename.GetChars(), true, true));
 	if (resfile == nullptr)
 	{
@@ -2161,6 +2176,136 @@ static void PutSavePic (FileWriter *file, int width, int height)
 	}
 }
 
+//==========================================================================
+//
+// Background save writing
+//
+// With save_async the game thread only serializes everything. Deflating
+// the JSON, writing the zip and reporting the result is left to a worker
+// thread; the result is picked up by G_Ticker. The pool has only one
+// thread so saves always finish in the order they were made, which means
+// waiting for the last one is waiting for all of them.
+//
+//==========================================================================
+
+struct FPendingSave
+{
+	FString filename;
+	FString description;
+	bool okForQuicksave;
+	bool written;
+	TArray<FString> filenames;
+	TArray<FCompressedBuffer> content;	// all buffers belong to the job.
+};
+
+static std::unique_ptr<ctpl::thread_pool> SavePool;	// started by the first asynchronous save
+static std::mutex SaveMutex;
+static TArray<FPendingSave *> FinishedSaves;
+static std::future<void> LastSave;
+static int PendingSaves;
+
+//==========================================================================
+//
+// Reports the outcome of a save. This must be called on the game thread.
+//
+//==========================================================================
+
+static void G_SaveFinished(const FString &filename, const FString &description, bool okForQuicksave, bool written)
+{
+	savegameManager.NotifyNewSave (filename, description, okForQuicksave);
+
+	// Check whether the file is ok by trying to open it.
+	FResourceFile *test = written ? FResourceFile::OpenResourceFile(filename, true) : nullptr;
+	if (test != nullptr)
+	{
+		delete test;
+		if (longsavemessages) Printf ("%s (%s)\n", GStrings("GGSAVED"), filename.GetChars());
+		else Printf ("%s\n", GStrings("GGSAVED"));
+	}
+	else Printf(PRINT_HIGH, "%s\n", GStrings("TXT_SAVEFAILED"));
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void G_CheckPendingSaves()
+{
+	if (PendingSaves == 0) return;
+
+	TArray<FPendingSave *> finished;
+	{
+		std::lock_guard<std::mutex> lock(SaveMutex);
+		finished = std::move(FinishedSaves);
+	}
+	for (auto save : finished)
+	{
+		PendingSaves--;
+		G_SaveFinished(save->filename, save->description, save->okForQuicksave, save->written);
+		delete save;
+	}
+}
+
+//==========================================================================
+//
+// Blocks until all queued saves are on disk. Called before loading a game
+// and when the engine shuts down.
+//
+//==========================================================================
+
+static void G_WaitForPendingSaves()
+{
+	if (LastSave.valid())
+	{
+		LastSave.wait();
+		LastSave = std::future<void>();
+	}
+	G_CheckPendingSaves();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void G_QueueSave(FPendingSave *save)
+{
+	static bool registered;
+	if (!registered)
+	{
+		registered = true;
+		atterm(G_WaitForPendingSaves);
+	}
+
+	if (SavePool == nullptr)
+	{
+		SavePool.reset(new ctpl::thread_pool(1));
+	}
+
+	PendingSaves++;
+	LastSave = SavePool->push([=](int)
+	{
+		// Everything but the savepic is JSON. The level snapshots from
+		// other maps in the hub have already been deflated when they were
+		// taken so this only affects what was produced for this save.
+		for (unsigned i = 1; i < save->content.Size(); i++)
+		{
+			DeflateBuffer(save->content[i]);
+		}
+		save->written = WriteZip(save->filename, save->filenames, save->content);
+		for (auto &buffer : save->content)
+		{
+			buffer.Clean();
+		}
+
+		std::lock_guard<std::mutex> lock(SaveMutex);
+		FinishedSaves.Push(save);
+	});
+}
+
 void G_DoSaveGame (bool okForQuicksave, FString filename, const char *description)
 {
 	TArray<FCompressedBuffer> savegame_content;
@@ -2186,7 +2331,7 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 	insave = true;
 	try
 	{
-		level.SnapshotLevel();
+		level.SnapshotLevel(!save_async);
 	}
 	catch(CRecoverableError &err)
 	{
@@ -2213,7 +2358,8 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 	FSerializer savegameglobals(nullptr);	// and this for non-level related info that must be saved.
 
 	savegameinfo.OpenWriter(true);
-	savegameglobals.OpenWriter(save_formatted);
+	if (save_binary) savegameglobals.OpenBinaryWriter();
+	else savegameglobals.OpenWriter(save_formatted);
 
 	SaveVersion = SAVEVER;
 	PutSavePic(&savepic, SAVEPICWIDTH, SAVEPICHEIGHT);
@@ -2267,33 +2413,58 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 
 	savegame_content.Push(bufpng);
 	savegame_filenames.Push("savepic.png");
-	savegame_content.Push(savegameinfo.GetCompressedOutput());
-	savegame_filenames.Push("info.json");
-	savegame_content.Push(savegameglobals.GetCompressedOutput());
-	savegame_filenames.Push("globals.json");
-
-	G_WriteSnapshots (savegame_filenames, savegame_content);
-	
+	if (save_async)
+	{
+		savegame_content.Push(savegameinfo.GetStoredOutput());
+		savegame_filenames.Push("info.json");
+		savegame_content.Push(savegameglobals.GetStoredOutput());
+		savegame_filenames.Push("globals.json");
+
+		G_WriteSnapshots (savegame_filenames, savegame_content);
+
+		auto save = new FPendingSave;
+		save->filename = filename;
+		save->description = description;
+		save->okForQuicksave = okForQuicksave;
+		save->written = false;
+		save->filenames = std::move(savegame_filenames);
+		save->content = std::move(savegame_content);
+
+		// The JSON buffers and the current level's snapshot were made for this
+		// save alone so the job can take them over. The savepic lives in a local
+		// BufferWriter and the other snapshots belong to the level infos which
+		// may be replaced before the worker gets to them, so those get copied.
+		for (unsigned i = 0; i < save->content.Size(); i++)
+		{
+			auto &buffer = save->content[i];
+			if (i == 0 || (i > 2 && buffer.mBuffer != level.info->Snapshot.mBuffer))
+			{
+				char *copy = new char[buffer.mCompressedSize];
+				memcpy(copy, buffer.mBuffer, buffer.mCompressedSize);
+				buffer.mBuffer = copy;
+			}
+		}
+		level.info->Snapshot.mBuffer = nullptr;
+		G_QueueSave(save);
+	}
+	else
+	{
+		savegame_content.Push(savegameinfo.GetCompressedOutput());
+		savegame_filenames.Push("info.json");
+		savegame_content.Push(savegameglobals.GetCompressedOutput());
+		savegame_filenames.Push("globals.json");
 
-	WriteZip(filename, savegame_filenames, savegame_content);
+		G_WriteSnapshots (savegame_filenames, savegame_content);
 
-	savegameManager.NotifyNewSave (filename, description, okForQuicksave);
+		bool written = WriteZip(filename, savegame_filenames, savegame_content);
 
-	// delete the JSON buffers we created just above. Everything else will
-	// either still be needed or taken care of automatically.
-	savegame_content[1].Clean();
-	savegame_content[2].Clean();
+		// delete the JSON buffers we created just above. Everything else will
+		// either still be needed or taken care of automatically.
+		savegame_content[1].Clean();
+		savegame_content[2].Clean();
 
-	// Check whether the file is ok by trying to open it.
-	FResourceFile *test = FResourceFile::OpenResourceFile(filename, true);
-	if (test != nullptr)
-	{
-		delete test;
-		if (longsavemessages) Printf ("%s (%s)\n", GStrings("GGSAVED"), filename.GetChars());
-		else Printf ("%s\n", GStrings("GGSAVED"));
+		G_SaveFinished(filename, description, okForQuicksave, written);
 	}
-	else Printf(PRINT_HIGH, "%s\n", GStrings("TXT_SAVEFAILED"));
-
 
 	BackupSaveName = filename;
 
@@ -2787,6 +2958,21 @@ void G_TimeDemo (const char* name)
 	timingdemo = true;
 	singletics = true;
 
+	const char *benchmarkfile = Args->CheckValue("-benchmark");
+	if (benchmarkfile != nullptr)
+	{
+		int renderwidth = 0, renderheight = 0;
+		const char *rendersize = Args->CheckValue("-benchmarkrender");
+		if (rendersize != nullptr && sscanf(rendersize, "%dx%d", &renderwidth, &renderheight) != 2)
+		{
+			Printf("Invalid -benchmarkrender size '%s', expected <width>x<height>\n", rendersize);
+			renderwidth = renderheight = 0;
+		}
+
+		nodrawers = true;
+		G_BeginBenchmark(benchmarkfile, !!Args->CheckParm("-benchmarkthinkers"), renderwidth, renderheight);
+	}
+
 	defdemoname = name;
 	gameaction = (gameaction == ga_loadgame) ? ga_loadgameplaydemo : ga_playdemo;
 }
@@ -2838,6 +3024,11 @@ bool G_CheckDemoStatus (void)
 		{
 			if (timingdemo)
 			{
+				if (benchmarking)
+				{
+					G_WriteBenchmark(defdemoname);
+					throw CExitEvent(0);
+				}
 				// Trying to get back to a stable state after timing a demo
 				// seems to cause problems. I don't feel like fixing that
 				// right now.
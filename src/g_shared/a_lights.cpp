@@ -287,6 +287,18 @@ void DStrobe::Tick ()
 	}
 }
 
+//-----------------------------------------------------------------------------
+//
+// Only touches its own sector and does not use the RNG, so it may
+// be ticked in parallel with effects in other sectors.
+//
+//-----------------------------------------------------------------------------
+
+sector_t *DStrobe::GetTickSector()
+{
+	return m_Sector;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Hexen-style constructor
@@ -385,6 +397,17 @@ void DGlow::Tick ()
 //
 //-----------------------------------------------------------------------------
 
+sector_t *DGlow::GetTickSector()
+{
+	return m_Sector;
+}
+
+//-----------------------------------------------------------------------------
+//
+//
+//
+//-----------------------------------------------------------------------------
+
 void DGlow::Construct(sector_t *sector)
 {
 	Super::Construct(sector);
@@ -439,6 +462,17 @@ void DGlow2::Tick ()
 	m_Sector->SetLightLevel(((m_End - m_Start) * m_Tics) / m_MaxTics + m_Start);
 }
 
+//-----------------------------------------------------------------------------
+//
+// One-shot glows destroy themselves, which must not happen off the main thread.
+//
+//-----------------------------------------------------------------------------
+
+sector_t *DGlow2::GetTickSector()
+{
+	return m_OneShot ? nullptr : m_Sector;
+}
+
 //-----------------------------------------------------------------------------
 //
 //
@@ -501,6 +535,17 @@ void DPhased::Tick ()
 //
 //-----------------------------------------------------------------------------
 
+sector_t *DPhased::GetTickSector()
+{
+	return m_Sector;
+}
+
+//-----------------------------------------------------------------------------
+//
+//
+//
+//-----------------------------------------------------------------------------
+
 int DPhased::PhaseHelper (sector_t *sector, int index, int light, sector_t *prev)
 {
 	if (!sector || sector->validcount == validcount)
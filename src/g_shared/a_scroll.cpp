@@ -226,6 +226,30 @@ void DScroller::Tick ()
 	}
 }
 
+//-----------------------------------------------------------------------------
+//
+// Texture scrollers only change their own sector or side, which belongs to
+// one sector. Carrying scrollers flag the actors in their sector, and an
+// actor can touch several sectors at once.
+//
+//-----------------------------------------------------------------------------
+
+sector_t *DScroller::GetTickSector()
+{
+	switch (m_Type)
+	{
+	case EScroll::sc_side:
+		return m_Side->sector;
+
+	case EScroll::sc_floor:
+	case EScroll::sc_ceiling:
+		return m_Sector;
+
+	default:
+		return nullptr;
+	}
+}
+
 //-----------------------------------------------------------------------------
 //
 // Add_Scroller()
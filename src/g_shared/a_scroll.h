@@ -19,6 +19,7 @@ public:
 
 	void Serialize(FSerializer &arc);
 	void Tick ();
+	sector_t *GetTickSector() override;
 
 	bool AffectsWall (side_t * wall) const { return m_Side == wall; }
 	side_t *GetWall () const { return m_Side; }
@@ -42,9 +42,16 @@
 #include "v_text.h"
 #include "g_levellocals.h"
 #include "a_dynlight.h"
+#include "g_benchmark.h"
+#include "types.h"
+#include "workerpool.h"
 
 
+// 1: tick sector-local thinkers in parallel, 2: additionally verify each parallel batch against a serial tick.
+CVAR(Int, parallelthinkers, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
 static int ThinkCount;
+static int ParallelThinkCount;
 static cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
 extern cycle_t ActionCycles;
@@ -67,6 +74,225 @@ static TMap<FName, ProfileInfo> Profiles;
 static unsigned int profilethinkers, profilelimit;
 DThinker *NextToThink;
 
+//==========================================================================
+//
+// Parallel ticking
+//
+// A thinker whose native Tick() modifies nothing but itself and the sector
+// returned by GetTickSector() may run on a worker thread. All such thinkers
+// sharing a sector are ticked by the same task in list order, so the
+// outcome does not depend on how the tasks get scheduled and is identical
+// to a serial tick.
+//
+// These thinkers only take a few nanoseconds each to tick, so handing a
+// batch to the worker pool only pays off for really large batches.
+//
+//==========================================================================
+
+enum { MIN_PARALLEL_BATCH = 4096 };
+
+static sector_t *GetParallelTickSector(DThinker *node)
+{
+	if (node->ObjectFlags & (OF_JustSpawned | OF_EuthanizeMe))
+	{
+		return nullptr;
+	}
+	IFVIRTUALPTR(node, DThinker, Tick)
+	{
+		// A script override can do anything.
+		if (!(func->VarFlags & VARF_Native)) return nullptr;
+	}
+	return node->GetTickSector();
+}
+
+class FParallelTickBatch
+{
+	TArray<DThinker *> Thinkers;
+	TArray<sector_t *> Sectors;
+	TArray<TArray<DThinker *>> Jobs;
+
+	void TickSerial()
+	{
+		for (auto node : Thinkers)
+		{
+			node->Tick();
+		}
+	}
+
+	void TickParallel()
+	{
+		// Every sector goes to a fixed job, so thinkers sharing a sector stay in list order on one thread.
+		auto &pool = WorkerPool();
+		unsigned numJobs = pool.size() + 1;
+		Jobs.Resize(numJobs);
+		for (auto &job : Jobs)
+		{
+			job.Clear();
+		}
+		for (unsigned i = 0; i < Thinkers.Size(); i++)
+		{
+			Jobs[Sectors[i]->Index() % numJobs].Push(Thinkers[i]);
+		}
+
+		auto tickJob = [](TArray<DThinker *> &job)
+		{
+			for (auto node : job)
+			{
+				node->Tick();
+			}
+		};
+
+		std::vector<std::future<void>> tasks;
+		for (unsigned j = 1; j < numJobs; j++)
+		{
+			auto job = &Jobs[j];
+			tasks.push_back(pool.push([=](int) { tickJob(*job); }));
+		}
+		tickJob(Jobs[0]);
+		WorkerPoolWait(tasks);
+	}
+
+	// Everything of a sector the eligible thinkers can change: the light level, the plane offsets and the texture offsets of its sides.
+	static void SaveSectorState(sector_t *sec, TArray<double> &values)
+	{
+		values.Push(sec->lightlevel);
+		for (int pos = sector_t::floor; pos <= sector_t::ceiling; pos++)
+		{
+			values.Push(sec->planes[pos].xform.xOffs);
+			values.Push(sec->planes[pos].xform.yOffs);
+		}
+		for (auto line : sec->Lines)
+		{
+			for (auto side : line->sidedef)
+			{
+				if (side == nullptr || side->sector != sec) continue;
+				for (auto &part : side->textures)
+				{
+					values.Push(part.xOffset);
+					values.Push(part.yOffset);
+				}
+			}
+		}
+	}
+
+	static void RestoreSectorState(sector_t *sec, const TArray<double> &values, unsigned &index)
+	{
+		sec->lightlevel = (short)values[index++];
+		for (int pos = sector_t::floor; pos <= sector_t::ceiling; pos++)
+		{
+			sec->planes[pos].xform.xOffs = values[index++];
+			sec->planes[pos].xform.yOffs = values[index++];
+		}
+		for (auto line : sec->Lines)
+		{
+			for (auto side : line->sidedef)
+			{
+				if (side == nullptr || side->sector != sec) continue;
+				for (auto &part : side->textures)
+				{
+					part.xOffset = values[index++];
+					part.yOffset = values[index++];
+				}
+			}
+		}
+	}
+
+	void Snapshot(FString &state, TArray<double> &sectorState)
+	{
+		FSerializer arc(Thinkers[0]->Level);
+		arc.OpenWriter(false);
+		arc.BeginArray("thinkers");
+		for (auto node : Thinkers)
+		{
+			arc.BeginObject(nullptr);
+			node->Serialize(arc);
+			arc.EndObject();
+		}
+		arc.EndArray();
+		state = arc.GetOutput();
+
+		sectorState.Clear();
+		for (auto sec : Sectors)
+		{
+			SaveSectorState(sec, sectorState);
+		}
+	}
+
+	void Restore(const FString &state, const TArray<double> &sectorState)
+	{
+		FSerializer arc(Thinkers[0]->Level);
+		arc.OpenReader(state.GetChars(), state.Len());
+		if (arc.BeginArray("thinkers"))
+		{
+			for (auto node : Thinkers)
+			{
+				if (arc.BeginObject(nullptr))
+				{
+					node->Serialize(arc);
+					arc.EndObject();
+				}
+			}
+			arc.EndArray();
+		}
+		// A sector appears once per thinker in it. Restoring it repeatedly is harmless since every copy holds the same values.
+		unsigned index = 0;
+		for (auto sec : Sectors)
+		{
+			RestoreSectorState(sec, sectorState, index);
+		}
+	}
+
+	void TickVerified()
+	{
+		FString before, parallel, serial;
+		TArray<double> beforeSectors, parallelSectors, serialSectors;
+
+		Snapshot(before, beforeSectors);
+		TickParallel();
+		Snapshot(parallel, parallelSectors);
+		Restore(before, beforeSectors);
+		TickSerial();
+		Snapshot(serial, serialSectors);
+
+		// The serial result is what stays in the game, so a mismatch cannot break demo sync.
+		if (parallel.Compare(serial) != 0 || !(parallelSectors == serialSectors))
+		{
+			Printf(TEXTCOLOR_RED "Parallel thinker tick does not match serial tick (%u thinkers)\n", Thinkers.Size());
+		}
+	}
+
+public:
+	void Add(DThinker *node, sector_t *sector)
+	{
+		Thinkers.Push(node);
+		Sectors.Push(sector);
+	}
+
+	void Run()
+	{
+		if (Thinkers.Size() == 0)
+		{
+			return;
+		}
+		if (Thinkers.Size() < MIN_PARALLEL_BATCH)
+		{
+			TickSerial();
+		}
+		else
+		{
+			if (parallelthinkers >= 2) TickVerified();
+			else TickParallel();
+			ParallelThinkCount += Thinkers.Size();
+		}
+		ThinkCount += Thinkers.Size();
+		Thinkers.Clear();
+		Sectors.Clear();
+		GC::CheckGC();
+	}
+};
+
+static FParallelTickBatch ParallelBatch;
+
 //==========================================================================
 //
 //
@@ -94,6 +320,70 @@ void FThinkerCollection::Link(DThinker *thinker, int statnum)
 //
 //==========================================================================
 
+static void PrintProfiles()
+{
+	struct SortedProfileInfo
+	{
+		const char* className;
+		int numcalls;
+		double time;
+	};
+
+	TArray<SortedProfileInfo> sorted;
+	sorted.Grow(Profiles.CountUsed());
+
+	auto it = TMap<FName, ProfileInfo>::Iterator(Profiles);
+	TMap<FName, ProfileInfo>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		sorted.Push({ pair->Key.GetChars(), pair->Value.numcalls, pair->Value.timer.TimeMS() });
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const SortedProfileInfo& left, const SortedProfileInfo& right)
+	{
+		switch (profilethinkers)
+		{
+		case 1: // by name, from A to Z
+			return stricmp(left.className, right.className) < 0;
+		case 2: // by name, from Z to A
+			return stricmp(right.className, left.className) < 0;
+		case 3: // number of calls, ascending
+			return left.numcalls < right.numcalls;
+		case 4: // number of calls, descending
+			return right.numcalls < left.numcalls;
+		case 5: // average time, ascending
+			return left.time / left.numcalls < right.time / right.numcalls;
+		case 6: // average time, descending
+			return right.time / right.numcalls < left.time / left.numcalls;
+		case 7: // total time, ascending
+			return left.time < right.time;
+		default: // total time, descending
+			return right.time < left.time;
+		}
+	});
+
+	Printf(TEXTCOLOR_YELLOW "Total, ms   Averg, ms   Calls   Actor class\n");
+	Printf(TEXTCOLOR_YELLOW "----------  ----------  ------  --------------------\n");
+
+	const unsigned count = MIN(profilelimit > 0 ? profilelimit : UINT_MAX, sorted.Size());
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const SortedProfileInfo& info = sorted[i];
+		Printf("%s%10.6f  %s%10.6f  %s%6d  %s%s\n",
+			profilethinkers >= 7 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time,
+			profilethinkers == 5 || profilethinkers == 6 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time / info.numcalls,
+			profilethinkers == 3 || profilethinkers == 4 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.numcalls,
+			profilethinkers == 1 || profilethinkers == 2 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.className);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 {
 	int i, count;
@@ -106,12 +396,21 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 
 	ThinkCycles.Clock();
 
-	if (!profilethinkers)
+	ParallelThinkCount = 0;
+
+	if (!profilethinkers && !benchmarkthinkers)
 	{
 		// Tick every thinker left from last time
 		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
 		{
-			Thinkers[i].TickThinkers(nullptr);
+			if (parallelthinkers > 0)
+			{
+				Thinkers[i].TickThinkersParallel();
+			}
+			else
+			{
+				Thinkers[i].TickThinkers(nullptr);
+			}
 		}
 
 		// Keep ticking the fresh thinkers until there are no new ones.
@@ -162,63 +461,20 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 		}
 		prof.timer.Unclock();
 
-
-		struct SortedProfileInfo
+		if (benchmarkthinkers)
 		{
-			const char* className;
-			int numcalls;
-			double time;
-		};
-
-		TArray<SortedProfileInfo> sorted;
-		sorted.Grow(Profiles.CountUsed());
-
-		auto it = TMap<FName, ProfileInfo>::Iterator(Profiles);
-		TMap<FName, ProfileInfo>::Pair *pair;
-		while (it.NextPair(pair))
-		{
-			sorted.Push({ pair->Key.GetChars(), pair->Value.numcalls, pair->Value.timer.TimeMS() });
-		}
-
-		std::sort(sorted.begin(), sorted.end(), [](const SortedProfileInfo& left, const SortedProfileInfo& right)
-		{
-			switch (profilethinkers)
+			auto it = TMap<FName, ProfileInfo>::Iterator(Profiles);
+			TMap<FName, ProfileInfo>::Pair *pair;
+			while (it.NextPair(pair))
 			{
-			case 1: // by name, from A to Z
-				return stricmp(left.className, right.className) < 0;
-			case 2: // by name, from Z to A
-				return stricmp(right.className, left.className) < 0;
-			case 3: // number of calls, ascending
-				return left.numcalls < right.numcalls;
-			case 4: // number of calls, descending
-				return right.numcalls < left.numcalls;
-			case 5: // average time, ascending
-				return left.time / left.numcalls < right.time / right.numcalls;
-			case 6: // average time, descending
-				return right.time / right.numcalls < left.time / left.numcalls;
-			case 7: // total time, ascending
-				return left.time < right.time;
-			default: // total time, descending
-				return right.time < left.time;
+				G_BenchmarkThinker(pair->Key, pair->Value.numcalls, pair->Value.timer.TimeMS());
 			}
-		});
-
-		Printf(TEXTCOLOR_YELLOW "Total, ms   Averg, ms   Calls   Actor class\n");
-		Printf(TEXTCOLOR_YELLOW "----------  ----------  ------  --------------------\n");
-
-		const unsigned count = MIN(profilelimit > 0 ? profilelimit : UINT_MAX, sorted.Size());
-
-		for (unsigned i = 0; i < count; ++i)
+		}
+		if (profilethinkers)
 		{
-			const SortedProfileInfo& info = sorted[i];
-			Printf("%s%10.6f  %s%10.6f  %s%6d  %s%s\n",
-				profilethinkers >= 7 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time,
-				profilethinkers == 5 || profilethinkers == 6 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time / info.numcalls,
-				profilethinkers == 3 || profilethinkers == 4 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.numcalls,
-				profilethinkers == 1 || profilethinkers == 2 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.className);
+			PrintProfiles();
+			profilethinkers = 0;
 		}
-
-		profilethinkers = 0;
 	}
 
 	ThinkCycles.Unclock();
@@ -581,6 +837,54 @@ int FThinkerList::TickThinkers(FThinkerList *dest)
 	return count;
 }
 
+//==========================================================================
+//
+// Same as TickThinkers(nullptr), but consecutive runs of sector-local
+// thinkers are collected and ticked as one parallel batch. The batch is
+// flushed before any other thinker ticks so that ordering is preserved.
+//
+//==========================================================================
+
+int FThinkerList::TickThinkersParallel()
+{
+	int count = 0;
+	DThinker *node = GetHead();
+
+	if (node == nullptr)
+	{
+		return 0;
+	}
+
+	while (node != Sentinel)
+	{
+		++count;
+		NextToThink = node->NextThinker;
+		auto sector = GetParallelTickSector(node);
+		if (sector != nullptr)
+		{
+			ParallelBatch.Add(node, sector);
+		}
+		else
+		{
+			ParallelBatch.Run();
+			if (node->ObjectFlags & OF_JustSpawned)
+			{
+				node->CallPostBeginPlay();
+			}
+			if (!(node->ObjectFlags & OF_EuthanizeMe))
+			{
+				ThinkCount++;
+				node->CallTick();
+				node->ObjectFlags &= ~OF_JustSpawned;
+				GC::CheckGC();
+			}
+		}
+		node = NextToThink;
+	}
+	ParallelBatch.Run();
+	return count;
+}
+
 //==========================================================================
 //
 //
@@ -843,6 +1147,11 @@ DEFINE_ACTION_FUNCTION(DThinker, Tick)
 	return 0;
 }
 
+sector_t *DThinker::GetTickSector()
+{
+	return nullptr;
+}
+
 void DThinker::CallTick()
 {
 	IFVIRTUAL(DThinker, Tick)
@@ -1000,6 +1309,6 @@ DThinker *FThinkerIterator::Next (bool exact)
 ADD_STAT (think)
 {
 	FString out;
-	out.Format ("Think time = %04.2f ms - %d thinkers, Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount, ActionCycles.TimeMS());
+	out.Format ("Think time = %04.2f ms - %d thinkers (%d parallel), Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount, ParallelThinkCount, ActionCycles.TimeMS());
 	return out;
 }
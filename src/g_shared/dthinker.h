@@ -45,6 +45,7 @@ struct FState;
 class DThinker;
 class FSerializer;
 struct FLevelLocals;
+struct sector_t;
 
 class FThinkerIterator;
 
@@ -65,6 +66,8 @@ struct FThinkerList
 	void SaveList(FSerializer &arc);
 
 private:
+	int TickThinkersParallel();
+
 	DThinker *Sentinel = nullptr;
 
 	friend struct FThinkerCollection;
@@ -101,6 +104,7 @@ public:
 	virtual ~DThinker ();
 	virtual void Tick ();
 	void CallTick();
+	virtual sector_t *GetTickSector();	// The only sector (sides included) a native Tick() may modify, or nullptr if it can have wider side effects.
 	virtual void PostBeginPlay ();	// Called just before the first tick
 	virtual void CallPostBeginPlay(); // different in actor.
 	virtual void PostSerialize();
@@ -472,6 +472,8 @@ FBlockNode *FBlockNode::Create(AActor *who, int x, int y, int group)
 	block->PrevActor = nullptr;
 	block->PrevBlock = nullptr;
 	block->NextBlock = nullptr;
+	block->Slot = 0;
+	block->OffsetX = block->OffsetY = 0;
 	return block;
 }
 
@@ -480,3 +482,77 @@ void FBlockNode::Release()
 	NextBlock = FreeBlocks;
 	FreeBlocks = this;
 }
+
+//===========================================================================
+//
+// FBlockThings - packed copy of a block's thing links
+//
+//===========================================================================
+
+int FBlockThings::Locks;
+
+void FBlockThings::Add(FBlockNode *node, float x, float y, float radius)
+{
+	if (NumFree > Nodes.Size() / 2 && Locks == 0)
+	{
+		Compact();
+	}
+	node->Slot = Nodes.Push(node);
+	Actors.Push(node->Me);
+	X.Push(x);
+	Y.Push(y);
+	Radius.Push(radius);
+	Shared.Push(0);
+}
+
+void FBlockThings::Remove(FBlockNode *node)
+{
+	unsigned slot = node->Slot;
+	assert(Nodes[slot] == node);
+	Nodes[slot] = nullptr;
+	Actors[slot] = nullptr;
+	// A NaN position fails every overlap test so the scan needs no separate check for free entries.
+	X[slot] = Y[slot] = NAN;
+	Shared[slot] = 0;
+	NumFree++;
+}
+
+// Puts a removed node back into its old slot. Only valid if nothing was compacted in between.
+void FBlockThings::Restore(FBlockNode *node, float x, float y, float radius, bool shared)
+{
+	unsigned slot = node->Slot;
+	assert(Nodes[slot] == nullptr);
+	Nodes[slot] = node;
+	Actors[slot] = node->Me;
+	X[slot] = x;
+	Y[slot] = y;
+	Radius[slot] = radius;
+	Shared[slot] = shared;
+	NumFree--;
+}
+
+void FBlockThings::Compact()
+{
+	unsigned j = 0;
+	for (unsigned i = 0; i < Nodes.Size(); i++)
+	{
+		if (Nodes[i] != nullptr)
+		{
+			Nodes[j] = Nodes[i];
+			Actors[j] = Actors[i];
+			X[j] = X[i];
+			Y[j] = Y[i];
+			Radius[j] = Radius[i];
+			Shared[j] = Shared[i];
+			Nodes[j]->Slot = j;
+			j++;
+		}
+	}
+	Nodes.Resize(j);
+	Actors.Resize(j);
+	X.Resize(j);
+	Y.Resize(j);
+	Radius.Resize(j);
+	Shared.Resize(j);
+	NumFree = 0;
+}
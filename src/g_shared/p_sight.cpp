@@ -40,6 +40,8 @@
 static FRandom pr_botchecksight ("BotCheckSight");
 static FRandom pr_checksight ("CheckSight");
 
+CVAR(Bool, sightcache, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
 /*
 ==============================================================================
 
@@ -52,7 +54,7 @@ This uses specialized forms of the maputils routines for optimized performance
 
 // Performance meters
 static int sightcounts[6];
-static cycle_t SightCycles;
+cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
 enum
@@ -90,6 +92,177 @@ struct SightTask
 static TArray<intercept_t> intercepts (128);
 static TArray<SightTask> portals(32);
 
+//==========================================================================
+//
+// Sight cache
+//
+// Remembers the result of the line of sight traversal for a pair of actors
+// together with the state of every line the trace crossed and of the
+// sectors on both sides of them. As long as neither actor moved and none
+// of these changed, the traversal must produce the same result again, so
+// a monster that keeps looking at a player who stays out of view no longer
+// walks the blockmap every time it checks.
+//
+// Only the traversal is cached. The reject and stealth checks always run
+// so that the random number sequence stays the same.
+//
+// Maps with linked portals or polyobjects are not cached because the set
+// of lines a trace crosses is no longer fixed by the actors' positions.
+// Traces touching 3D floors are not cached either.
+//
+//==========================================================================
+
+struct FSightLineState
+{
+	line_t *line;
+	uint32_t flags;
+	uint32_t activation;
+	int special;
+	int arg1;
+
+	void Set(line_t *ld)
+	{
+		line = ld;
+		flags = ld->flags;
+		activation = ld->activation;
+		special = ld->special;
+		arg1 = ld->args[1];
+	}
+
+	bool Matches() const
+	{
+		return flags == line->flags && activation == line->activation && special == line->special && arg1 == line->args[1];
+	}
+};
+
+struct FSightSectorState
+{
+	sector_t *sector;
+	secplane_t floorplane;
+	secplane_t ceilingplane;
+
+	bool Matches() const
+	{
+		return floorplane == sector->floorplane && ceilingplane == sector->ceilingplane;
+	}
+};
+
+struct FSightCacheEntry
+{
+	enum
+	{
+		MAX_LINES = 64
+	};
+
+	FLevelLocals *Level = nullptr;
+	AActor *t1, *t2;
+	sector_t *startsector;
+	DVector3 pos1, pos2;
+	double height1, height2;
+	int flags;
+	uint32_t compatflags;
+	bool result;
+	bool recording;
+	TArray<FSightLineState> Lines;
+	TArray<FSightSectorState> Sectors;
+
+	bool Matches(AActor *a1, AActor *a2, sector_t *sec, int f) const
+	{
+		return Level == a1->Level && t1 == a1 && t2 == a2 && startsector == sec && flags == f &&
+			compatflags == uint32_t(Level->i_compatflags & COMPATF_TRACE) &&
+			pos1 == a1->Pos() && pos2 == a2->Pos() && height1 == a1->Height && height2 == a2->Height;
+	}
+
+	bool IsValid() const
+	{
+		for (auto &l : Lines)
+		{
+			if (!l.Matches()) return false;
+		}
+		for (auto &s : Sectors)
+		{
+			if (!s.Matches()) return false;
+		}
+		return true;
+	}
+
+	void Begin(AActor *a1, AActor *a2, sector_t *sec, int f)
+	{
+		Level = nullptr;	// not usable until Finish is called
+		t1 = a1;
+		t2 = a2;
+		startsector = sec;
+		pos1 = a1->Pos();
+		pos2 = a2->Pos();
+		height1 = a1->Height;
+		height2 = a2->Height;
+		flags = f;
+		compatflags = uint32_t(a1->Level->i_compatflags & COMPATF_TRACE);
+		recording = sec->e->XFloor.ffloors.Size() == 0 && a2->Sector->e->XFloor.ffloors.Size() == 0;
+		Lines.Clear();
+		Sectors.Clear();
+	}
+
+	void AddSector(sector_t *sec)
+	{
+		for (auto &s : Sectors)
+		{
+			if (s.sector == sec) return;
+		}
+		Sectors.Push({ sec, sec->floorplane, sec->ceilingplane });
+	}
+
+	void AddLine(line_t *ld)
+	{
+		if (!recording) return;
+		if (Lines.Size() >= MAX_LINES ||
+			ld->frontsector->e->XFloor.ffloors.Size() > 0 ||
+			(ld->backsector != nullptr && ld->backsector->e->XFloor.ffloors.Size() > 0))
+		{
+			recording = false;
+			return;
+		}
+		Lines.Reserve(1);
+		Lines.Last().Set(ld);
+		AddSector(ld->frontsector);
+		if (ld->backsector != nullptr) AddSector(ld->backsector);
+	}
+
+	void Finish(FLevelLocals *l, bool res)
+	{
+		if (recording && portals.Size() == 0)
+		{
+			Level = l;
+			result = res;
+		}
+	}
+};
+
+static TArray<FSightCacheEntry> SightCache;
+static int SightCacheHits, SightCacheMisses;
+
+static FSightCacheEntry *P_GetSightCacheEntry(AActor *t1, AActor *t2)
+{
+	enum { CACHE_SIZE = 4096 };
+
+	auto Level = t1->Level;
+	if (Level->Displacements.size > 1 || Level->linePortals.Size() > 0 || Level->Polyobjects.Size() > 0)
+	{
+		return nullptr;
+	}
+	if (SightCache.Size() == 0)
+	{
+		SightCache.Resize(CACHE_SIZE);
+	}
+	size_t hash = (size_t(t1) >> 4) * 31 + (size_t(t2) >> 4);
+	return &SightCache[(hash ^ (hash >> 12)) & (CACHE_SIZE - 1)];
+}
+
+void P_ClearSightCache()
+{
+	SightCache.Reset();
+}
+
 class SightCheck
 {
 	FLevelLocals *Level;
@@ -108,6 +281,7 @@ class SightCheck
 	int portalgroup;
 	bool portalfound;
 	unsigned int myseethrough;
+	FSightCacheEntry *record;
 
 	void P_SightOpening(SightOpening &open, const line_t *linedef, double x, double y);
 	bool PTR_SightTraverse (intercept_t *in);
@@ -117,9 +291,10 @@ class SightCheck
 	bool LineBlocksSight(line_t *ld);
 
 public:
-	SightCheck(FLevelLocals *l)
+	SightCheck(FLevelLocals *l, FSightCacheEntry *r = nullptr)
 	{
 		Level = l;
+		record = r;
 	}
 
 	bool P_SightPathTraverse ();
@@ -451,6 +626,8 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 		return true;		// line isn't crossed
 	}
 
+	if (record != nullptr) record->AddLine(ld);
+
 	if (!portalfound)	// when portals come into play, the quick-outs here may not be performed
 	{
 		if (LineBlocksSight(ld)) return false;
@@ -913,8 +1090,20 @@ sightcounts[0]++;
 		double topslope = bottomslope + t2->Height;
 		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
 
+		FSightCacheEntry *entry = sightcache ? P_GetSightCacheEntry(t1, t2) : nullptr;
+		if (entry != nullptr)
+		{
+			if (entry->Matches(t1, t2, sec, flags) && entry->IsValid())
+			{
+				SightCacheHits++;
+				res = entry->result;
+				goto done;
+			}
+			SightCacheMisses++;
+			entry->Begin(t1, t2, sec, flags);
+		}
 
-		SightCheck s(t1->Level);
+		SightCheck s(t1->Level, entry);
 		s.init(t1, t2, sec, &task, flags);
 		res = s.P_SightPathTraverse ();
 		if (!res)
@@ -931,6 +1120,7 @@ sightcounts[0]++;
 				}
 			}
 		}
+		if (entry != nullptr) entry->Finish(t1->Level, res);
 	}
 
 done:
@@ -941,9 +1131,10 @@ done:
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d, cache %d/%d\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5],
+		SightCacheHits, SightCacheHits + SightCacheMisses);
 	return out;
 }
 
@@ -959,4 +1150,5 @@ void P_ResetSightCounters (bool full)
 	}
 	SightCycles.Reset();
 	memset (sightcounts, 0, sizeof(sightcounts));
+	SightCacheHits = SightCacheMisses = 0;
 }
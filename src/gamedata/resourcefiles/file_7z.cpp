@@ -41,6 +41,10 @@
 #include "cmdlib.h"
 #include "v_text.h"
 #include "w_wad.h"
+#include "c_cvars.h"
+#include "templates.h"
+#include "workerpool.h"
+#include <mutex>
 
 
 
@@ -52,6 +56,10 @@
 
 extern ISzAlloc g_Alloc;
 
+// Decompressed solid blocks of all open archives are kept until together
+// they exceed this many megabytes. The most recently used block is always kept.
+CVAR(Int, archive_7zcachesize, 64, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+
 struct CZDFileInStream
 {
 	ISeekInStream s;
@@ -104,22 +112,105 @@ struct CZDFileInStream
 	}
 };
 
+struct C7zArchive;
+
+//==========================================================================
+//
+// Cache of decompressed solid blocks, shared by all 7z archives so that
+// archive_7zcachesize limits the total. Archives may be opened on several
+// threads at once, so it is locked. A block that is being read from gets
+// taken out of the cache meanwhile, so it can't be freed under its user.
+//
+//==========================================================================
+
+struct F7zBlock
+{
+	C7zArchive *Owner;
+	UInt32 Index;
+	Byte *Buffer;
+	size_t Size;
+};
+
+static std::mutex BlockCacheMutex;
+static TArray<F7zBlock> BlockCache;	// least recently used first
+static size_t BlockCacheSize;
+
+static size_t BlockCacheLimit()
+{
+	return (size_t)MAX<int>(archive_7zcachesize, 0) << 20;
+}
+
+static bool IsBlockCached(C7zArchive *owner, UInt32 index)
+{
+	std::lock_guard<std::mutex> lock(BlockCacheMutex);
+	for (auto &block : BlockCache)
+	{
+		if (block.Owner == owner && block.Index == index) return true;
+	}
+	return false;
+}
+
+static bool TakeCachedBlock(C7zArchive *owner, UInt32 index, F7zBlock &block)
+{
+	std::lock_guard<std::mutex> lock(BlockCacheMutex);
+	for (unsigned i = 0; i < BlockCache.Size(); i++)
+	{
+		if (BlockCache[i].Owner == owner && BlockCache[i].Index == index)
+		{
+			block = BlockCache[i];
+			BlockCacheSize -= block.Size;
+			BlockCache.Delete(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void AddCachedBlock(const F7zBlock &block)
+{
+	TArray<Byte *> freed;
+	{
+		std::lock_guard<std::mutex> lock(BlockCacheMutex);
+		BlockCache.Push(block);
+		BlockCacheSize += block.Size;
+		while (BlockCacheSize > BlockCacheLimit() && BlockCache.Size() > 1)
+		{
+			BlockCacheSize -= BlockCache[0].Size;
+			freed.Push(BlockCache[0].Buffer);
+			BlockCache.Delete(0);
+		}
+	}
+	for (auto buffer : freed) IAlloc_Free(&g_Alloc, buffer);
+}
+
+static void FreeCachedBlocks(C7zArchive *owner)
+{
+	std::lock_guard<std::mutex> lock(BlockCacheMutex);
+	for (unsigned i = BlockCache.Size(); i-- > 0; )
+	{
+		if (BlockCache[i].Owner == owner)
+		{
+			BlockCacheSize -= BlockCache[i].Size;
+			IAlloc_Free(&g_Alloc, BlockCache[i].Buffer);
+			BlockCache.Delete(i);
+		}
+	}
+}
+
 struct C7zArchive
 {
+	typedef F7zBlock FBlock;
+
 	CSzArEx DB;
 	CZDFileInStream ArchiveStream;
 	CLookToRead2 LookStream;
 	Byte StreamBuffer[1<<14];
-	UInt32 BlockIndex;
-	Byte *OutBuffer;
-	size_t OutBufferSize;
 
 	C7zArchive(FileReader &file) : ArchiveStream(file)
 	{
-		if (g_CrcTable[1] == 0)
-		{
-			CrcGenerateTable();
-		}
+		// archives may be opened on several threads at once.
+		static bool crcinit = (CrcGenerateTable(), true);
+		(void)crcinit;
 		file.Seek(0, FileReader::SeekSet);
 		LookToRead2_CreateVTable(&LookStream, false);
 		LookStream.realStream = &ArchiveStream.s;
@@ -127,17 +218,11 @@ struct C7zArchive
 		LookStream.bufSize = sizeof(StreamBuffer);
 		LookStream.buf = StreamBuffer;
 		SzArEx_Init(&DB);
-		BlockIndex = 0xFFFFFFFF;
-		OutBuffer = NULL;
-		OutBufferSize = 0;
 	}
 
 	~C7zArchive()
 	{
-		if (OutBuffer != NULL)
-		{
-			IAlloc_Free(&g_Alloc, OutBuffer);
-		}
+		FreeCachedBlocks(this);
 		SzArEx_Free(&DB, &g_Alloc);
 	}
 
@@ -146,19 +231,151 @@ struct C7zArchive
 		return SzArEx_Open(&DB, &LookStream.vt, &g_Alloc, &g_Alloc);
 	}
 
+	//==========================================================================
+	//
+	// SzAr_DecodeFolder only checks a block's CRC if the archive stores one
+	// for the whole block, which solid archives usually don't. They store one
+	// per file instead, so those get checked before a block enters the cache.
+	//
+	//==========================================================================
+
+	SRes CheckBlock(const FBlock &block)
+	{
+		const CSzAr *db = &DB.db;
+		if (SzBitWithVals_Check(&db->FolderCRCs, block.Index))
+		{
+			return CrcCalc(block.Buffer, block.Size) == db->FolderCRCs.Vals[block.Index] ? SZ_OK : SZ_ERROR_CRC;
+		}
+
+		UInt64 blockStart = DB.UnpackPositions[DB.FolderToFile[block.Index]];
+		for (UInt32 file = DB.FolderToFile[block.Index]; file < DB.FolderToFile[block.Index + 1]; file++)
+		{
+			if (!SzBitWithVals_Check(&DB.CRCs, file)) continue;
+
+			size_t offset = (size_t)(DB.UnpackPositions[file] - blockStart);
+			size_t size = (size_t)(DB.UnpackPositions[file + 1] - DB.UnpackPositions[file]);
+			if (offset + size > block.Size) return SZ_ERROR_FAIL;
+			if (CrcCalc(block.Buffer + offset, size) != DB.CRCs.Vals[file]) return SZ_ERROR_CRC;
+		}
+		return SZ_OK;
+	}
+
 	SRes Extract(UInt32 file_index, char *buffer)
 	{
+		FBlock block = { this, 0xFFFFFFFF, nullptr, 0 };
+		TakeCachedBlock(this, DB.FileToFolder[file_index], block);
+
 		size_t offset, out_size_processed;
 		SRes res = SzArEx_Extract(&DB, &LookStream.vt, file_index,
-			&BlockIndex, &OutBuffer, &OutBufferSize,
+			&block.Index, &block.Buffer, &block.Size,
 			&offset, &out_size_processed,
 			&g_Alloc, &g_Alloc);
 		if (res == SZ_OK)
 		{
-			memcpy(buffer, OutBuffer + offset, out_size_processed);
+			memcpy(buffer, block.Buffer + offset, out_size_processed);
+		}
+		if (block.Buffer != nullptr)
+		{
+			if (res == SZ_OK) AddCachedBlock(block);
+			else IAlloc_Free(&g_Alloc, block.Buffer);
 		}
 		return res;
 	}
+
+	//==========================================================================
+	//
+	// Decompresses the blocks containing the given files on worker threads
+	// and puts them in the cache, as many as fit. The packed data gets read
+	// here first because the archive's reader can only be used by one thread.
+	//
+	//==========================================================================
+
+	void Prefetch(const TArray<UInt32> &files)
+	{
+		struct FPending
+		{
+			FBlock Block;
+			TArray<uint8_t> Packed;
+			UInt64 PackStart;
+			SRes Result;
+		};
+
+		TArray<FPending> pending;
+		size_t total;
+		{
+			std::lock_guard<std::mutex> lock(BlockCacheMutex);
+			total = BlockCacheSize;
+		}
+		for (auto file : files)
+		{
+			UInt32 folder = DB.FileToFolder[file];
+			if (folder == 0xFFFFFFFF || IsBlockCached(this, folder)) continue;
+
+			bool queued = false;
+			for (auto &p : pending) if (p.Block.Index == folder) queued = true;
+			if (queued) continue;
+
+			// Blocks that would push others out of the cache again are not worth it.
+			size_t size = (size_t)SzAr_GetFolderUnpackSize(&DB.db, folder);
+			if (size == 0 || total + size > BlockCacheLimit()) continue;
+			total += size;
+
+			FPending &p = pending[pending.Reserve(1)];
+			p.Block = { this, folder, nullptr, size };
+			p.PackStart = DB.db.PackPositions[DB.db.FoStartPackStreamIndex[folder]];
+			p.Result = SZ_ERROR_FAIL;
+		}
+		// A single block gets decompressed no faster here than on demand.
+		if (pending.Size() < 2) return;
+
+		for (auto &p : pending)
+		{
+			UInt64 packEnd = DB.db.PackPositions[DB.db.FoStartPackStreamIndex[p.Block.Index + 1]];
+			p.Packed.Resize((unsigned)(packEnd - p.PackStart));
+			ArchiveStream.File.Seek((long)(DB.dataPos + p.PackStart), FileReader::SeekSet);
+			if (ArchiveStream.File.Read(p.Packed.Data(), p.Packed.Size()) != (long)p.Packed.Size())
+			{
+				p.Packed.Clear();
+			}
+		}
+
+		std::vector<std::future<void>> tasks;
+		for (auto &p : pending)
+		{
+			if (p.Packed.Size() == 0) continue;
+			FPending *job = &p;
+			tasks.push_back(WorkerPool().push([=](int)
+			{
+				FileReader reader;
+				reader.OpenMemory(job->Packed.Data(), job->Packed.Size());
+				CZDFileInStream stream(reader);
+				CLookToRead2 look;
+				TArray<Byte> lookbuf(1 << 14, true);
+				LookToRead2_CreateVTable(&look, false);
+				look.realStream = &stream.s;
+				look.buf = lookbuf.Data();
+				look.bufSize = lookbuf.Size();
+				LookToRead2_Init(&look);
+
+				job->Block.Buffer = (Byte *)IAlloc_Alloc(&g_Alloc, job->Block.Size);
+				if (job->Block.Buffer != nullptr)
+				{
+					// The folder's pack positions are relative to the start of all packed data
+					// but the reader only contains this folder's, so the start position wraps them around.
+					job->Result = SzAr_DecodeFolder(&DB.db, job->Block.Index, &look.vt, 0 - job->PackStart,
+						job->Block.Buffer, job->Block.Size, &g_Alloc);
+					if (job->Result == SZ_OK) job->Result = CheckBlock(job->Block);
+				}
+			}));
+		}
+		WorkerPoolWait(tasks);
+
+		for (auto &p : pending)
+		{
+			if (p.Result == SZ_OK) AddCachedBlock(p.Block);
+			else if (p.Block.Buffer != nullptr) IAlloc_Free(&g_Alloc, p.Block.Buffer);
+		}
+	}
 };
 //==========================================================================
 //
@@ -191,6 +408,7 @@ class F7ZFile : public FResourceFile
 public:
 	F7ZFile(const char * filename, FileReader &filer);
 	bool Open(bool quiet);
+	virtual void Prefetch(const TArray<uint32_t> &lumps);
 	virtual ~F7ZFile();
 	virtual FResourceLump *GetLump(int no) { return ((unsigned)no < NumLumps)? &Lumps[no] : NULL; }
 };
@@ -338,6 +556,25 @@ F7ZFile::~F7ZFile()
 	}
 }
 
+//==========================================================================
+//
+// 
+//
+//==========================================================================
+
+void F7ZFile::Prefetch(const TArray<uint32_t> &lumps)
+{
+	TArray<UInt32> files;
+	for (auto no : lumps)
+	{
+		if (no < NumLumps && Lumps[no].Cache == nullptr && Lumps[no].LumpSize > 0)
+		{
+			files.Push(Lumps[no].Position);
+		}
+	}
+	if (Archive != nullptr && files.Size() > 0) Archive->Prefetch(files);
+}
+
 //==========================================================================
 //
 // Fills the lump cache and performs decompression
@@ -114,6 +114,7 @@ public:
 	FWadFile(const char * filename, FileReader &file);
 	~FWadFile();
 	void FindStrifeTeaserVoices ();
+	bool IsMappable() const { return true; }
 	FResourceLump *GetLump(int lump) { return &Lumps[lump]; }
 	bool Open(bool quiet);
 };
@@ -385,11 +386,14 @@ void FWadFile::SetNamespace(const char *startmarker, const char *endmarker, name
 // they are such a pain, and breaking them like this was done on purpose.
 // This also renames any S_SKINxx lumps to just S_SKIN.
 //
+// Wads may be opened on several threads at once, so the lumps only get
+// marked with ns_firstskin here. FWadCollection gives each skin wad its
+// own namespace when it adds the file.
+//
 //==========================================================================
 
 void FWadFile::SkinHack ()
 {
-	static int namespc = ns_firstskin;
 	bool skinned = false;
 	bool hasmap = false;
 	uint32_t i;
@@ -413,9 +417,8 @@ void FWadFile::SkinHack ()
 
 				for (j = 0; j < NumLumps; j++)
 				{
-					Lumps[j].Namespace = namespc;
+					Lumps[j].Namespace = ns_firstskin;
 				}
-				namespc++;
 			}
 		}
 		if ((lump->Name[0] == 'M' &&
@@ -40,6 +40,14 @@
 #include "w_wad.h"
 #include "gi.h"
 #include "doomstat.h"
+#include "c_cvars.h"
+#include "m_argv.h"
+
+// A mapped file that gets truncated or rewritten while the engine runs, for
+// example by an editor, crashes it on the next read instead of giving a read
+// error. Turning this off, or -nomapfiles for a single run, reads them
+// through stdio again for that kind of work.
+CVAR(Bool, archive_mapfiles, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
 
 //==========================================================================
@@ -308,7 +316,9 @@ FResourceFile *FResourceFile::OpenResourceFile(const char *filename, bool quiet,
 {
 	FileReader file;
 	if (!file.OpenFile(filename)) return nullptr;
-	return DoOpenResourceFile(filename, file, quiet, containeronly);
+	auto rf = DoOpenResourceFile(filename, file, quiet, containeronly);
+	if (rf != nullptr && rf->IsMappable()) rf->MapFile();
+	return rf;
 }
 
 FResourceFile *FResourceFile::OpenResourceFileFromLump(int lumpnum, bool quiet, bool containeronly)
@@ -323,6 +333,26 @@ FResourceFile *FResourceFile::OpenDirectory(const char *filename, bool quiet)
 	return CheckDir(filename, quiet);
 }
 
+//==========================================================================
+//
+// Replaces the file reader with a memory mapping of the file.
+// Lumps then get their cache pointed directly at the mapped data
+// so caching a lump neither reads it nor copies it to the heap.
+// If the file cannot be mapped the regular reader is kept.
+//
+//==========================================================================
+
+void FResourceFile::MapFile()
+{
+	if (Reader.GetBuffer() != nullptr || !archive_mapfiles || Args->CheckParm("-nomapfiles")) return;
+
+	FileReader mapped;
+	if (mapped.OpenMappedFile(FileName) && mapped.GetLength() == Reader.GetLength())
+	{
+		Reader = std::move(mapped);
+	}
+}
+
 //==========================================================================
 //
 // Resource file base class
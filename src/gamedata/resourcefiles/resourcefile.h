@@ -113,6 +113,14 @@ public:
 	uint32_t GetFirstLump() const { return FirstLump; }
 	void SetFirstLump(uint32_t f) { FirstLump = f; }
 
+	// Archives whose lumps are stored as-is can serve them directly out of a memory mapping.
+	virtual bool IsMappable() const { return false; }
+	void MapFile();
+
+	// Called with lumps that are about to be read, so that archives that can
+	// unpack several of them faster at once can do so ahead of time.
+	virtual void Prefetch(const TArray<uint32_t> &lumps) {}
+
 	virtual void FindStrifeTeaserVoices ();
 	virtual bool Open(bool quiet) = 0;
 	virtual FResourceLump *GetLump(int no) = 0;
@@ -138,6 +146,7 @@ protected:
 
 	FUncompressedFile(const char *filename);
 	FUncompressedFile(const char *filename, FileReader &r);
+	virtual bool IsMappable() const { return true; }
 	virtual FResourceLump *GetLump(int no) { return ((unsigned)no < NumLumps)? &Lumps[no] : NULL; }
 };
 
@@ -44,6 +44,8 @@
 #include "m_argv.h"
 #include "cmdlib.h"
 #include "c_dispatch.h"
+#include "c_console.h"
+#include "templates.h"
 #include "w_wad.h"
 #include "m_crc32.h"
 #include "v_text.h"
@@ -52,6 +54,8 @@
 #include "md5.h"
 #include "doomstat.h"
 #include "vm.h"
+#include "sc_man.h"
+#include "workerpool.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -134,18 +138,63 @@ void FWadCollection::DeleteAll ()
 //
 //==========================================================================
 
+//==========================================================================
+//
+// The directories of all files are read and parsed on worker threads.
+// They are added to the collection in the order given afterward, and
+// everything the workers printed is printed at that point, too, so lump
+// numbers and console output are the same as when opening them one by one.
+//
+//==========================================================================
+
 void FWadCollection::InitMultipleFiles (TArray<FString> &filenames)
 {
-	int numfiles;
+	struct OpenedFile
+	{
+		FileReader Reader;
+		FResourceFile *ResFile = nullptr;
+		FPrintBuffer Messages;
+		std::exception_ptr Error;
+	};
 
 	// open all the files, load headers, and count lumps
 	DeleteAll();
-	numfiles = 0;
+	FScanner::OpenedLumps.Clear();
+	NextSkinNamespace = ns_firstskin;
+
+	TArray<OpenedFile> opened(filenames.Size(), true);
+	std::vector<std::future<void>> tasks;
+	for (unsigned i = 0; i < filenames.Size(); i++)
+	{
+		// Pass the raw string because string reference counts are not thread safe.
+		const char *filename = filenames[i].GetChars();
+		OpenedFile *file = &opened[i];
+		tasks.push_back(WorkerPool().push([=](int)
+		{
+			auto oldcapture = PrintCapture;
+			PrintCapture = &file->Messages;
+			try
+			{
+				file->ResFile = OpenFile(filename, nullptr, file->Reader);
+			}
+			catch (...)
+			{
+				file->Error = std::current_exception();
+			}
+			PrintCapture = oldcapture;
+		}));
+	}
+	WorkerPoolWait(tasks);
 
-	for(unsigned i=0;i<filenames.Size(); i++)
+	for (unsigned i = 0; i < filenames.Size(); i++)
 	{
-		int baselump = NumLumps;
-		AddFile (filenames[i]);
+		opened[i].Messages.Flush();
+		if (opened[i].Error)
+		{
+			for (unsigned j = i + 1; j < filenames.Size(); j++) delete opened[j].ResFile;
+			std::rethrow_exception(opened[i].Error);
+		}
+		AddOpenedFile(filenames[i], opened[i].ResFile, opened[i].Reader);
 	}
 
 	NumLumps = LumpInfo.Size();
@@ -200,9 +249,21 @@ int FWadCollection::AddExternalFile(const char *filename)
 
 void FWadCollection::AddFile (const char *filename, FileReader *wadr)
 {
-	int startlump;
-	bool isdir = false;
 	FileReader wadreader;
+	FResourceFile *resfile = OpenFile(filename, wadr, wadreader);
+	AddOpenedFile(filename, resfile, wadreader);
+}
+
+//==========================================================================
+//
+// Opens a file and reads its directory without touching the collection,
+// so this can run on a worker thread.
+//
+//==========================================================================
+
+FResourceFile *FWadCollection::OpenFile(const char *filename, FileReader *wadr, FileReader &wadreader)
+{
+	bool isdir = false;
 
 	if (wadr == nullptr)
 	{
@@ -211,7 +272,7 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadr)
 		{
 			Printf(TEXTCOLOR_RED "%s: File or Directory not found\n", filename);
 			PrintLastError();
-			return;
+			return NULL;
 		}
 
 		if (!isdir)
@@ -220,30 +281,53 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadr)
 			{ // Didn't find file
 				Printf (TEXTCOLOR_RED "%s: File not found\n", filename);
 				PrintLastError ();
-				return;
+				return NULL;
 			}
 		}
 	}
 	else wadreader = std::move(*wadr);
 
 	if (!batchrun) Printf (" adding %s", filename);
-	startlump = NumLumps;
 
 	FResourceFile *resfile;
 	
 	if (!isdir)
+	{
 		resfile = FResourceFile::OpenResourceFile(filename, wadreader);
+		// Only files opened from disk here can be mapped, embedded ones come from their container.
+		if (resfile != NULL && wadr == nullptr && resfile->IsMappable()) resfile->MapFile();
+	}
 	else
 		resfile = FResourceFile::OpenDirectory(filename);
 
+	return resfile;
+}
+
+//==========================================================================
+//
+// Adds the lumps of an opened file to the collection
+//
+//==========================================================================
+
+void FWadCollection::AddOpenedFile(const char *filename, FResourceFile *resfile, FileReader &wadreader)
+{
 	if (resfile != NULL)
 	{
 		uint32_t lumpstart = LumpInfo.Size();
 
 		resfile->SetFirstLump(lumpstart);
+
+		// Skin wads get their namespace here rather than when they are opened,
+		// so that the numbers follow the file order.
+		int skinns = -1;
 		for (uint32_t i=0; i < resfile->LumpCount(); i++)
 		{
 			FResourceLump *lump = resfile->GetLump(i);
+			if (lump->Namespace == ns_firstskin)
+			{
+				if (skinns < 0) skinns = NextSkinNamespace++;
+				lump->Namespace = skinns;
+			}
 			FWadCollection::LumpRecord *lump_p = &LumpInfo[LumpInfo.Reserve(1)];
 
 			lump_p->lump = lump;
@@ -705,9 +789,42 @@ uint32_t FWadCollection::LumpNameHash (const char *s)
 
 void FWadCollection::InitHashChains (void)
 {
-	char name[8];
+	enum { BATCH = 1024 };
 	unsigned int i, j;
 
+	// Calculating the keys is where the time goes, and it does not depend
+	// on the other lumps, so that is done on worker threads. The chains are
+	// still linked in lump order so that later lumps are found first.
+	TArray<uint32_t> keys(NumLumps * 3, true);
+	auto hashRange = [&](unsigned first, unsigned last)
+	{
+		char name[8];
+		for (unsigned i = first; i < last; i++)
+		{
+			auto lump = LumpInfo[i].lump;
+			uppercopy (name, lump->Name);
+			keys[i * 3] = LumpNameHash (name) % NumLumps;
+
+			if (lump->FullName.IsNotEmpty())
+			{
+				const FString &fullname = lump->FullName;
+				keys[i * 3 + 1] = MakeKey(fullname) % NumLumps;
+
+				auto dot = fullname.LastIndexOf('.');
+				auto slash = fullname.LastIndexOf('/');
+				keys[i * 3 + 2] = MakeKey(fullname, dot > slash ? dot : fullname.Len()) % NumLumps;
+			}
+		}
+	};
+
+	std::vector<std::future<void>> tasks;
+	for (unsigned first = 0; first < NumLumps; first += BATCH)
+	{
+		unsigned last = MIN<unsigned>(first + BATCH, NumLumps);
+		tasks.push_back(WorkerPool().push([=](int) { hashRange(first, last); }));
+	}
+	WorkerPoolWait(tasks);
+
 	// Mark all buckets as empty
 	memset (FirstLumpIndex, 255, NumLumps*sizeof(FirstLumpIndex[0]));
 	memset (NextLumpIndex, 255, NumLumps*sizeof(NextLumpIndex[0]));
@@ -719,27 +836,20 @@ void FWadCollection::InitHashChains (void)
 	// Now set up the chains
 	for (i = 0; i < (unsigned)NumLumps; i++)
 	{
-		uppercopy (name, LumpInfo[i].lump->Name);
-		j = LumpNameHash (name) % NumLumps;
+		j = keys[i * 3];
 		NextLumpIndex[i] = FirstLumpIndex[j];
 		FirstLumpIndex[j] = i;
 
 		// Do the same for the full paths
 		if (LumpInfo[i].lump->FullName.IsNotEmpty())
 		{
-			j = MakeKey(LumpInfo[i].lump->FullName) % NumLumps;
+			j = keys[i * 3 + 1];
 			NextLumpIndex_FullName[i] = FirstLumpIndex_FullName[j];
 			FirstLumpIndex_FullName[j] = i;
 
-			FString nameNoExt = LumpInfo[i].lump->FullName;
-			auto dot = nameNoExt.LastIndexOf('.');
-			auto slash = nameNoExt.LastIndexOf('/');
-			if (dot > slash) nameNoExt.Truncate(dot);
-
-			j = MakeKey(nameNoExt) % NumLumps;
+			j = keys[i * 3 + 2];
 			NextLumpIndex_NoExt[i] = FirstLumpIndex_NoExt[j];
 			FirstLumpIndex_NoExt[j] = i;
-
 		}
 	}
 }
@@ -1452,6 +1562,32 @@ FileReader FWadCollection::ReopenLumpReader(int lump, bool alwayscache)
 	return rl->NewReader();	// This always gets a reader to the cache
 }
 
+//==========================================================================
+//
+// PrefetchLumps
+//
+// Passes the lumps on to the files containing them, so that compressed
+// archives can unpack them together.
+//
+//==========================================================================
+
+void FWadCollection::PrefetchLumps(const TArray<int> &lumps)
+{
+	TArray<TArray<uint32_t>> perfile(Files.Size(), true);
+	for (auto lump : lumps)
+	{
+		if ((unsigned)lump < (unsigned)LumpInfo.Size() && LumpInfo[lump].wadnum >= 0)
+		{
+			int wadnum = LumpInfo[lump].wadnum;
+			perfile[wadnum].Push(lump - Files[wadnum]->GetFirstLump());
+		}
+	}
+	for (unsigned i = 0; i < Files.Size(); i++)
+	{
+		if (perfile[i].Size() > 0) Files[i]->Prefetch(perfile[i]);
+	}
+}
+
 //==========================================================================
 //
 // GetFileReader
@@ -160,6 +160,7 @@ public:
 
 	FileReader OpenLumpReader(int lump);		// opens a reader that redirects to the containing file's one.
 	FileReader ReopenLumpReader(int lump, bool alwayscache = false);		// opens an independent reader.
+	void PrefetchLumps(const TArray<int> &lumps);	// hint that these lumps are going to be read soon.
 
 	int FindLump (const char *name, int *lastlump, bool anyns=false);		// [RH] Find lumps with duplication
 	int FindLumpMulti (const char **names, int *lastlump, bool anyns = false, int *nameindex = NULL); // same with multiple possible names
@@ -209,10 +210,13 @@ protected:
 	uint32_t NumWads;
 
 	int IwadIndex;
+	int NextSkinNamespace = ns_firstskin;
 
 	void InitHashChains ();								// [RH] Set up the lumpinfo hashing
 
 private:
+	static FResourceFile *OpenFile(const char *filename, FileReader *wadr, FileReader &wadreader);
+	void AddOpenedFile(const char *filename, FResourceFile *resfile, FileReader &wadreader);
 	void RenameSprites();
 	void RenameNerve();
 	void FixMacHexen();
@@ -946,7 +946,7 @@ bool MapLoader::CheckNodes(MapData * map, bool rebuilt, int buildtime)
 typedef TArray<uint8_t> MemFile;
 
 
-static FString CreateCacheName(MapData *map, bool create)
+static FString CreateCacheName(MapData *map, bool create, const char *ext = ".gzc")
 {
 	FString path = M_GetCachePath(create);
 	FString lumpname = Wads.GetLumpFullPath(map->lumpnum);
@@ -956,7 +956,7 @@ static FString CreateCacheName(MapData *map, bool create)
 
 	lumpname.ReplaceChars('/', '%');
 	lumpname.ReplaceChars(':', '$');
-	path << '/' << lumpname.Right(lumpname.Len() - separator - 1) << ".gzc";
+	path << '/' << lumpname.Right(lumpname.Len() - separator - 1) << ext;
 	return path;
 }
 
@@ -1145,6 +1145,448 @@ bool MapLoader::CheckCachedNodes(MapData *map)
 	return true;
 }
 
+//==========================================================================
+//
+// Level data caching
+//
+// Data derived from the map's geometry that is too costly to rebuild on
+// every load of a large map goes into a second cache file next to the
+// nodes. Aside from the map checksum every block also stores a checksum
+// of the data it was built from, because compatibility fixes and the node
+// builder can still change the geometry after the map's lumps have been
+// read. The file is memory mapped while the map loads and the blocks are
+// decoded straight from the mapping.
+//
+// File layout:
+//   "ZLVC", version, map MD5
+//   followed by blocks of: id, checksum, size in bytes, data
+//
+// Blocks:
+//   BMAP: a generated blockmap, as ints
+//   SECT: the render sections and the sections and sectors of all subsectors
+//
+//==========================================================================
+
+enum
+{
+	LEVELCACHE_VERSION = 2,
+	LEVELCACHE_MINLINES = 10000,	// Smaller maps load fast enough without.
+	LEVELCACHE_HEADER = 24,
+};
+
+uint32_t MapLoader::GeometryChecksum()
+{
+	uLong crc = crc32(0, nullptr, 0);
+	for (auto &vert : Level->vertexes)
+	{
+		// The cache never leaves the machine, so the doubles' byte order does not matter.
+		double xy[2] = { vert.fX(), vert.fY() };
+		crc = crc32(crc, (const Bytef *)xy, sizeof(xy));
+	}
+	for (auto &line : Level->lines)
+	{
+		uint32_t ndx[2] = { LittleLong(uint32_t(Index(line.v1))), LittleLong(uint32_t(Index(line.v2))) };
+		crc = crc32(crc, (const Bytef *)ndx, sizeof(ndx));
+	}
+	return (uint32_t)crc;
+}
+
+//==========================================================================
+//
+// Everything CreateSections reads: the geometry plus how sides, segs and
+// subsectors are connected to each other and to their sectors.
+//
+//==========================================================================
+
+uint32_t MapLoader::TopologyChecksum()
+{
+	TArray<uint32_t> data;
+	data.Grow(Level->sides.Size() * 2 + Level->segs.Size() * 6 + Level->subsectors.Size() * 5);
+
+	auto add = [&](int value) { data.Push(LittleLong(uint32_t(value))); };
+	for (auto &side : Level->sides)
+	{
+		add(side.sector ? Index(side.sector) : -1);
+		add(side.linedef ? Index(side.linedef) : -1);
+	}
+	for (auto &seg : Level->segs)
+	{
+		add(Index(seg.v1));
+		add(Index(seg.v2));
+		add(seg.sidedef ? Index(seg.sidedef) : -1);
+		add(seg.linedef ? Index(seg.linedef) : -1);
+		add(seg.PartnerSeg ? Index(seg.PartnerSeg) : -1);
+		add(seg.Subsector ? Index(seg.Subsector) : -1);
+	}
+	for (auto &sub : Level->subsectors)
+	{
+		add(Index(sub.firstline));
+		add(sub.numlines);
+		add(sub.render_sector ? Index(sub.render_sector) : -1);
+		add(sub.sector ? Index(sub.sector) : -1);
+		add(sub.mapsection);
+	}
+	return (uint32_t)crc32(GeometryChecksum(), (const Bytef *)data.Data(), data.Size() * 4);
+}
+
+static bool UseLevelCache(FLevelLocals *Level)
+{
+	return gl_cachenodes && Level->maptype != MAPTYPE_BUILD && Level->lines.Size() >= LEVELCACHE_MINLINES;
+}
+
+//==========================================================================
+//
+// Returns the data of a block if the map's cache file has it and it was
+// built from the same data. The cache file is opened on the first call.
+//
+//==========================================================================
+
+const uint8_t *MapLoader::FindLevelCacheBlock(MapData *map, uint32_t id, uint32_t checksum, uint32_t &size)
+{
+	if (!LevelCacheChecked)
+	{
+		LevelCacheChecked = true;
+
+		uint8_t md5map[16];
+		map->GetChecksum(md5map);
+		if (LevelCache.OpenMappedFile(CreateCacheName(map, false, ".gzl")))
+		{
+			auto data = (const uint8_t *)LevelCache.GetBuffer();
+			uint32_t version;
+			if (LevelCache.GetLength() < LEVELCACHE_HEADER || memcmp(data, "ZLVC", 4) ||
+				(memcpy(&version, data + 4, 4), LittleLong(version) != LEVELCACHE_VERSION) ||
+				memcmp(data + 8, md5map, 16))
+			{
+				LevelCache.Close();
+			}
+		}
+	}
+	if (!LevelCache.isOpen()) return nullptr;
+
+	auto data = (const uint8_t *)LevelCache.GetBuffer();
+	size_t length = (size_t)LevelCache.GetLength();
+	size_t pos = LEVELCACHE_HEADER;
+	while (length - pos >= 12)
+	{
+		uint32_t header[3];
+		memcpy(header, data + pos, 12);
+		pos += 12;
+		uint32_t blocksize = LittleLong(header[2]);
+		if (blocksize > length - pos) break;
+		if (LittleLong(header[0]) == id)
+		{
+			if (LittleLong(header[1]) != checksum) break;
+			size = blocksize;
+			return data + pos;
+		}
+		pos += blocksize;
+	}
+	return nullptr;
+}
+
+//==========================================================================
+//
+// Writes all cacheable data of the map as it is right after its creation,
+// which is why this must run before anything gets spawned.
+//
+//==========================================================================
+
+void MapLoader::CreateLevelCache(MapData *map)
+{
+	if (!UseLevelCache(Level)) return;
+
+	MemFile data;
+	data.Resize(LEVELCACHE_HEADER);
+	memcpy(&data[0], "ZLVC", 4);
+	uint32_t version = LittleLong(uint32_t(LEVELCACHE_VERSION));
+	memcpy(&data[4], &version, 4);
+	map->GetChecksum(&data[8]);
+
+	auto writeDouble = [&](double value)
+	{
+		unsigned pos = data.Reserve(8);
+		memcpy(&data[pos], &value, 8);
+	};
+	auto beginBlock = [&](uint32_t id, uint32_t checksum)
+	{
+		WriteLong(data, id);
+		WriteLong(data, checksum);
+		WriteLong(data, 0);
+		return data.Size();
+	};
+	auto endBlock = [&](unsigned start)
+	{
+		uint32_t size = LittleLong(uint32_t(data.Size() - start));
+		memcpy(&data[start - 4], &size, 4);
+	};
+
+	if (BlockmapCacheCount > 0)
+	{
+		unsigned block = beginBlock(MAKE_ID('B','M','A','P'), BlockmapChecksum);
+		for (unsigned i = 0; i < BlockmapCacheCount; i++)
+		{
+			WriteLong(data, Level->blockmap.blockmaplump[i]);
+		}
+		endBlock(block);
+	}
+
+	auto &sections = Level->sections;
+	unsigned block = beginBlock(MAKE_ID('S','E','C','T'), SectionsChecksum);
+	WriteLong(data, sections.allSections.Size());
+	WriteLong(data, sections.allLines.Size());
+	WriteLong(data, sections.allSides.Size());
+	WriteLong(data, sections.allSubsectors.Size());
+	for (auto &line : sections.allLines)
+	{
+		WriteLong(data, Index(line.start));
+		WriteLong(data, Index(line.end));
+		WriteLong(data, line.partner ? int(line.partner - sections.allLines.Data()) : -1);
+		WriteLong(data, sections.SectionIndex(line.section));
+		WriteLong(data, line.sidedef ? Index(line.sidedef) : -1);
+	}
+	for (auto &section : sections.allSections)
+	{
+		WriteLong(data, int(section.segments.Data() - sections.allLines.Data()));
+		WriteLong(data, section.segments.Size());
+		WriteLong(data, int(section.sides.Data() - sections.allSides.Data()));
+		WriteLong(data, section.sides.Size());
+		WriteLong(data, int(section.subsectors.Data() - sections.allSubsectors.Data()));
+		WriteLong(data, section.subsectors.Size());
+		WriteLong(data, Index(section.sector));
+		WriteLong(data, section.mapsection);
+		writeDouble(section.bounds.left);
+		writeDouble(section.bounds.top);
+		writeDouble(section.bounds.right);
+		writeDouble(section.bounds.bottom);
+	}
+	for (auto side : sections.allSides)
+	{
+		WriteLong(data, Index(side));
+	}
+	for (auto sub : sections.allSubsectors)
+	{
+		WriteLong(data, Index(sub));
+	}
+	for (unsigned i = 0; i < Level->sectors.Size(); i++)
+	{
+		WriteLong(data, sections.firstSectionForSectorPtr[i]);
+		WriteLong(data, sections.numberOfSectionForSectorPtr[i]);
+	}
+	for (auto &sub : Level->subsectors)
+	{
+		WriteLong(data, sections.SectionIndex(sub.section));
+		WriteLong(data, Index(sub.sector));
+	}
+	endBlock(block);
+
+	// The old file may still be mapped.
+	LevelCache.Close();
+
+	FString path = CreateCacheName(map, true, ".gzl");
+	FileWriter *fw = FileWriter::Open(path);
+
+	if (fw != nullptr)
+	{
+		if (fw->Write(data.Data(), data.Size()) != data.Size())
+		{
+			Printf("Error saving level data to file %s\n", path.GetChars());
+		}
+		delete fw;
+	}
+	else
+	{
+		Printf("Cannot open level data file %s for writing\n", path.GetChars());
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool MapLoader::LoadCachedBlockMap(MapData *map)
+{
+	if (!UseLevelCache(Level)) return false;
+
+	BlockmapChecksum = GeometryChecksum();
+
+	uint32_t size;
+	auto data = FindLevelCacheBlock(map, MAKE_ID('B','M','A','P'), BlockmapChecksum, size);
+	if (data == nullptr) return false;
+
+	unsigned count = size / 4;
+	if (count < 4) return false;
+
+	int *blockmap = new int[count];
+	memcpy(blockmap, data, count * 4);
+	for (unsigned i = 0; i < count; i++)
+	{
+		blockmap[i] = LittleLong(blockmap[i]);
+	}
+
+	Level->blockmap.blockmaplump = blockmap;
+	if (blockmap[2] <= 0 || blockmap[3] <= 0 || !Level->blockmap.VerifyBlockMap(count, Level->lines.Size()))
+	{
+		Level->blockmap.blockmaplump = nullptr;
+		delete[] blockmap;
+		return false;
+	}
+	BlockmapCacheCount = count;
+	DPrintf(DMSG_NOTIFY, "Loaded cached BLOCKMAP\n");
+	return true;
+}
+
+//==========================================================================
+//
+// Replaces CreateSections if the cache has sections for the map's current
+// nodes. Every index gets range checked, so a damaged file can only cause
+// the sections to be built from scratch.
+//
+//==========================================================================
+
+bool MapLoader::LoadCachedSections(MapData *map)
+{
+	if (!UseLevelCache(Level)) return false;
+
+	SectionsChecksum = TopologyChecksum();
+
+	uint32_t size;
+	auto data = FindLevelCacheBlock(map, MAKE_ID('S','E','C','T'), SectionsChecksum, size);
+	if (data == nullptr) return false;
+
+	const uint8_t *end = data + size;
+	bool valid = true;
+	auto readInt = [&]() -> int
+	{
+		if (end - data < 4) { valid = false; return 0; }
+		int32_t value;
+		memcpy(&value, data, 4);
+		data += 4;
+		return LittleLong(value);
+	};
+	auto readDouble = [&]() -> double
+	{
+		if (end - data < 8) { valid = false; return 0; }
+		double value;
+		memcpy(&value, data, 8);
+		data += 8;
+		return value;
+	};
+	// Returns nullptr for -1 and anything out of range, the latter also invalidates the data.
+	auto readPointer = [&](auto &array) -> decltype(array.Data())
+	{
+		int index = readInt();
+		if (index < -1 || index >= (int)array.Size()) valid = false;
+		return valid && index >= 0 ? &array[index] : nullptr;
+	};
+	auto readView = [&](auto &view, auto &array)
+	{
+		unsigned first = readInt();
+		unsigned count = readInt();
+		if (first > array.Size() || count > array.Size() - first) valid = false;
+		else view.Set(array.Data() + first, count);
+	};
+
+	auto &sections = Level->sections;
+	sections.Clear();
+
+	unsigned numSections = readInt();
+	unsigned numLines = readInt();
+	unsigned numSides = readInt();
+	unsigned numSubsectors = readInt();
+	unsigned numSectors = Level->sectors.Size();
+
+	// Reject counts the block is too small for before allocating anything.
+	if (!valid || numSections == 0 || numSections > size / 64 || numLines > size / 20 || numSides > size / 4 || numSubsectors > size / 4)
+	{
+		return false;
+	}
+
+	sections.allSections.Resize(numSections);
+	sections.allLines.Resize(numLines);
+	sections.allSides.Resize(numSides);
+	sections.allSubsectors.Resize(numSubsectors);
+	sections.allIndices.Resize(2 * numSectors);
+	sections.firstSectionForSectorPtr = &sections.allIndices[0];
+	sections.numberOfSectionForSectorPtr = &sections.allIndices[numSectors];
+
+	for (unsigned i = 0; i < numLines && valid; i++)
+	{
+		auto &line = sections.allLines[i];
+		line.start = readPointer(Level->vertexes);
+		line.end = readPointer(Level->vertexes);
+		line.partner = readPointer(sections.allLines);
+		line.section = readPointer(sections.allSections);
+		line.sidedef = readPointer(Level->sides);
+		if (line.start == nullptr || line.end == nullptr || line.section == nullptr) valid = false;
+	}
+	for (unsigned i = 0; i < numSections && valid; i++)
+	{
+		auto &section = sections.allSections[i];
+		readView(section.segments, sections.allLines);
+		readView(section.sides, sections.allSides);
+		readView(section.subsectors, sections.allSubsectors);
+		section.sector = readPointer(Level->sectors);
+		section.mapsection = (short)readInt();
+		section.bounds.left = readDouble();
+		section.bounds.top = readDouble();
+		section.bounds.right = readDouble();
+		section.bounds.bottom = readDouble();
+		section.lighthead = nullptr;
+		section.vertexindex = -1;
+		section.vertexcount = 0;
+		section.validcount = 0;
+		section.hacked = 0;
+		section.flags = 0;
+		if (section.sector == nullptr) valid = false;
+	}
+	for (unsigned i = 0; i < numSides && valid; i++)
+	{
+		if ((sections.allSides[i] = readPointer(Level->sides)) == nullptr) valid = false;
+	}
+	for (unsigned i = 0; i < numSubsectors && valid; i++)
+	{
+		if ((sections.allSubsectors[i] = readPointer(Level->subsectors)) == nullptr) valid = false;
+	}
+	for (unsigned i = 0; i < numSectors && valid; i++)
+	{
+		int first = readInt();
+		int count = readInt();
+		if (first < -1 || first >= (int)numSections || count < 0 || count > (int)numSections - MAX(first, 0) || (first < 0 && count > 0)) valid = false;
+		sections.firstSectionForSectorPtr[i] = first;
+		sections.numberOfSectionForSectorPtr[i] = count;
+	}
+
+	// Only touch the subsectors once everything else has been found to be valid.
+	TArray<FSection *> subsectorSections(Level->subsectors.Size(), true);
+	TArray<sector_t *> subsectorSectors(Level->subsectors.Size(), true);
+	for (unsigned i = 0; i < Level->subsectors.Size() && valid; i++)
+	{
+		subsectorSections[i] = readPointer(sections.allSections);
+		subsectorSectors[i] = readPointer(Level->sectors);
+		if (subsectorSections[i] == nullptr || subsectorSectors[i] == nullptr) valid = false;
+	}
+	if (!valid || data != end)
+	{
+		sections.Clear();
+		return false;
+	}
+	for (unsigned i = 0; i < Level->subsectors.Size(); i++)
+	{
+		Level->subsectors[i].section = subsectorSections[i];
+		Level->subsectors[i].sector = subsectorSectors[i];
+	}
+	DPrintf(DMSG_NOTIFY, "Loaded cached sections\n");
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 UNSAFE_CCMD(clearnodecache)
 {
 	TArray<FFileList> list;
@@ -87,6 +87,7 @@ enum
 
 CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
+CVAR (Bool, packedblockmap, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);	// takes effect when the next map is loaded
 
 inline bool P_LoadBuildMap(uint8_t *mapdata, size_t len, FMapThing **things, int *numthings)
 {
@@ -2325,7 +2326,7 @@ static void CreatePackedBlockmap (TArray<int> &BlockMap, TArray<int> *blocks, in
 }
 
 
-void MapLoader::CreateBlockMap ()
+unsigned MapLoader::CreateBlockMap ()
 {
 	enum
 	{
@@ -2342,7 +2343,7 @@ void MapLoader::CreateBlockMap ()
 	int line;
 
 	if (Level->vertexes.Size() == 0)
-		return;
+		return 0;
 
 	// Find map extents for the blockmap
 	dminx = dmaxx = Level->vertexes[0].fX();
@@ -2497,6 +2498,7 @@ void MapLoader::CreateBlockMap ()
 	{
 		Level->blockmap.blockmaplump[ii] = BlockMap[ii];
 	}
+	return BlockMap.Size();
 }
 
 
@@ -2604,8 +2606,12 @@ void MapLoader::LoadBlockMap (MapData * map)
 		Args->CheckParm("-blockmap")
 		)
 	{
-		DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
-		CreateBlockMap ();
+		if (!LoadCachedBlockMap(map))
+		{
+			DPrintf (DMSG_SPAMMY, "Generating BLOCKMAP\n");
+			BlockmapCacheCount = CreateBlockMap();
+			LevelCacheChanged = true;
+		}
 	}
 	else
 	{
@@ -2649,6 +2655,11 @@ void MapLoader::LoadBlockMap (MapData * map)
 	count = Level->blockmap.bmapwidth*Level->blockmap.bmapheight;
 	Level->blockmap.blocklinks = new FBlockNode *[count];
 	memset (Level->blockmap.blocklinks, 0, count*sizeof(*Level->blockmap.blocklinks));
+	if (packedblockmap)
+	{
+		Level->blockmap.blockthings = new FBlockThings[count];
+	}
+	PackedBlockThings = packedblockmap;
 	Level->blockmap.blockmap = Level->blockmap.blockmaplump+4;
 }
 
@@ -3204,7 +3215,13 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	for (auto & p : Level->bodyque)
 		p = nullptr;
 
-	CreateSections(Level);
+	if (!LoadCachedSections(map))
+	{
+		CreateSections(Level);
+		LevelCacheChanged = true;
+	}
+	if (LevelCacheChanged) CreateLevelCache(map);
+	LevelCache.Close();
 
 	// [RH] Spawn slope creating things first.
 	SpawnSlopeMakers(&MapThingsConverted[0], &MapThingsConverted[MapThingsConverted.Size()], oldvertextable);
@@ -2,8 +2,8 @@
 
 #include "nodebuild.h"
 #include "g_levellocals.h"
+#include "files.h"
 
-class FileReader;
 struct FStrifeDialogueNode;
 struct FStrifeDialogueReply;
 struct Response;
@@ -117,6 +117,14 @@ private:
 	int sidecount = 0;
 	TArray<int>		linemap;
 	TArray<sidei_t> sidetemp;
+
+	// Level data cache, see glnodes.cpp
+	FileReader LevelCache;
+	bool LevelCacheChecked = false;
+	bool LevelCacheChanged = false;
+	unsigned BlockmapCacheCount = 0;
+	uint32_t BlockmapChecksum = 0;
+	uint32_t SectionsChecksum = 0;
 public:	// for the scripted compatibility system these two members need to be public.
 	TArray<FMapThing> MapThingsConverted;
 	bool ForceNodeBuild = false;
@@ -166,6 +174,12 @@ private:
 	bool LoadNodes(FileReader &lump);
 	bool DoLoadGLNodes(FileReader * lumps);
 	void CreateCachedNodes(MapData *map);
+	uint32_t GeometryChecksum();
+	uint32_t TopologyChecksum();
+	const uint8_t *FindLevelCacheBlock(MapData *map, uint32_t id, uint32_t checksum, uint32_t &size);
+	bool LoadCachedBlockMap(MapData *map);
+	bool LoadCachedSections(MapData *map);
+	void CreateLevelCache(MapData *map);
 
 	// Render info
 	void PrepareSectorData();
@@ -229,7 +243,7 @@ private:
 	void AllocateSideDefs(MapData *map, int count);
 	void ProcessSideTextures(bool checktranmap, side_t *sd, sector_t *sec, intmapsidedef_t *msd, int special, int tag, short *alpha, FMissingTextureTracker &missingtex);
 	void SetMapThingUserData(AActor *actor, unsigned udi);
-	void CreateBlockMap();
+	unsigned CreateBlockMap();
 	void PO_Init(void);
 
 	// During map init the items' own Index functions should not be used.
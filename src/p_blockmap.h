@@ -2,6 +2,7 @@
 #define __P_BLOCKMAP_H
 
 #include "doomtype.h"
+#include "tarray.h"
 
 class AActor;
 
@@ -15,6 +16,8 @@ struct FBlockNode
 	FBlockNode *NextActor;			// next actor in this block
 	FBlockNode **PrevBlock;			// previous block this actor is in
 	FBlockNode *NextBlock;			// next block this actor is in
+	unsigned Slot;					// index into the block's FBlockThings entry, if the packed blockmap is used
+	float OffsetX, OffsetY;			// portal offset of the position stored there
 
 	static FBlockNode *Create (AActor *who, int x, int y, int group = -1);
 	void Release ();
@@ -22,6 +25,28 @@ struct FBlockNode
 	static FBlockNode *FreeBlocks;
 };
 
+// Packed copy of one block's thing links, for rejecting things by
+// bounding box without touching the nodes or the actors themselves.
+// Entries get appended when linked and are only marked as free when
+// unlinked, so walking them backwards yields the same order as the
+// block's linked list.
+struct FBlockThings
+{
+	TArray<FBlockNode *> Nodes;		// nullptr for free entries
+	TArray<AActor *> Actors;
+	TArray<float> X, Y, Radius;
+	TArray<uint8_t> Shared;			// actor is linked into more than one block
+	unsigned NumFree = 0;
+
+	void Add(FBlockNode *node, float x, float y, float radius);
+	void Remove(FBlockNode *node);
+	void Restore(FBlockNode *node, float x, float y, float radius, bool shared);
+	void Compact();
+
+	// Free entries may only be reclaimed while nothing is iterating over them.
+	static int Locks;
+};
+
 // BLOCKMAP
 // Created from axis aligned bounding box
 // of the map, a rectangular array of
@@ -40,6 +65,7 @@ struct FBlockmap
 	double				bmaporgx;
 	double				bmaporgy;		// origin of block map
 	FBlockNode**		blocklinks; 	// for thing chains
+	FBlockThings*		blockthings = nullptr;	// packed thing links, only allocated if packedblockmap is set
 
 	// mapblocks are used to check movement
 	// against lines and things
@@ -87,6 +113,11 @@ struct FBlockmap
 			delete[] blocklinks;
 			blocklinks = nullptr;
 		}
+		if (blockthings != nullptr)
+		{
+			delete[] blockthings;
+			blockthings = nullptr;
+		}
 	}
 
 	~FBlockmap()
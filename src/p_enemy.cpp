@@ -2747,6 +2747,7 @@ bool P_CheckForResurrection(AActor *self, bool usevilestates)
 				{
 					corpsehit->Height = info->Height;	// [RH] Use real mobj height
 					corpsehit->radius = info->radius;	// [RH] Use real radius
+					corpsehit->UpdateBlockRadius();
 				}
 
 				corpsehit->Revive();
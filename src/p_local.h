@@ -273,6 +273,7 @@ enum ESightFlags
 };
 
 void	P_ResetSightCounters (bool full);
+void	P_ClearSightCache ();
 bool	P_TalkFacing (AActor *player);
 void	P_UseLines (player_t* player);
 int	P_UsePuzzleItem (AActor *actor, int itemType);
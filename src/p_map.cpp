@@ -66,6 +66,7 @@
 #include "m_bbox.h"
 #include "m_random.h"
 #include "c_dispatch.h"
+#include "stats.h"
 
 #include "doomdef.h"
 #include "p_local.h"
@@ -92,6 +93,7 @@
 #include "r_sky.h"
 #include "g_levellocals.h"
 #include "actorinlines.h"
+#include "g_benchmark.h"
 
 CVAR(Bool, cl_bloodsplats, true, CVAR_ARCHIVE)
 CVAR(Int, sv_smartaim, 0, CVAR_ARCHIVE | CVAR_SERVERINFO)
@@ -106,6 +108,8 @@ static FRandom pr_checkthing("CheckThing");
 static FRandom pr_lineattack("LineAttack");
 static FRandom pr_crunch("DoCrunch");
 
+cycle_t CheckPositionCycles;
+
 // keep track of special lines as they are hit,
 // but don't process them until the move is proven valid
 TArray<spechit_t> spechit;
@@ -1662,7 +1666,7 @@ MOVEMENT CLIPPING
 //
 //==========================================================================
 
-bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, bool actorsonly)
+static bool P_DoCheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, bool actorsonly)
 {
 	sector_t *newsec;
 	AActor *thingblocker;
@@ -1760,6 +1764,7 @@ bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, boo
 	FPortalGroupArray pcheck;
 	FMultiBlockThingsIterator it2(pcheck, thing->Level, pos.X, pos.Y, thing->Z(), thing->Height, thing->radius, false, newsec);
 	FMultiBlockThingsIterator::CheckResult tcres;
+	it2.FilterOverlapping();	// PIT_CheckThing ignores everything else.
 
 	while ((it2.Next(&tcres)))
 	{
@@ -1878,6 +1883,23 @@ bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, boo
 	return (thing->BlockingMobj = thingblocker) == NULL;
 }
 
+bool P_CheckPosition(AActor *thing, const DVector2 &pos, FCheckPosition &tm, bool actorsonly)
+{
+	if (!benchmarking)
+	{
+		return P_DoCheckPosition(thing, pos, tm, actorsonly);
+	}
+
+	// Position checks nest through specials and scripts. Only the outermost one is timed so nothing gets counted twice.
+	static int depth;
+	struct DepthGuard
+	{
+		DepthGuard() { if (depth++ == 0) CheckPositionCycles.Clock(); }
+		~DepthGuard() { if (--depth == 0) CheckPositionCycles.Unclock(); }
+	} guard;
+	return P_DoCheckPosition(thing, pos, tm, actorsonly);
+}
+
 bool P_CheckPosition(AActor *thing, const DVector2 &pos, bool actorsonly)
 {
 	FCheckPosition tm;
@@ -1952,6 +1974,7 @@ int P_TestMobjZ(AActor *actor, bool quick, AActor **pOnmobj)
 	FPortalGroupArray check;
 	FMultiBlockThingsIterator it(check, actor, -1, true);
 	FMultiBlockThingsIterator::CheckResult cres;
+	it.FilterOverlapping();
 
 	while (it.Next(&cres))
 	{
@@ -6074,6 +6097,7 @@ void P_FindAboveIntersectors(AActor *actor)
 	FPortalGroupArray check;
 	FMultiBlockThingsIterator it(check, actor);
 	FMultiBlockThingsIterator::CheckResult cres;
+	it.FilterOverlapping();
 	while (it.Next(&cres))
 	{
 		AActor *thing = cres.thing;
@@ -6130,6 +6154,7 @@ void P_FindBelowIntersectors(AActor *actor)
 	FPortalGroupArray check;
 	FMultiBlockThingsIterator it(check, actor);
 	FMultiBlockThingsIterator::CheckResult cres;
+	it.FilterOverlapping();
 	while (it.Next(&cres))
 	{
 		AActor *thing = cres.thing;
@@ -72,6 +72,9 @@
 #include "p_maputl.h"
 #include "p_3dmidtex.h"
 #include "p_blockmap.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 #include "r_utility.h"
 #include "actor.h"
 #include "actorinlines.h"
@@ -332,6 +335,7 @@ void AActor::UnlinkFromWorld (FLinkContext *ctx)
 	{
 		// [RH] Unlink from all blocks this actor uses
 		FBlockNode *block = this->BlockNode;
+		FBlockThings *blockthings = Level->blockmap.blockthings;
 
 		while (block != NULL)
 		{
@@ -340,6 +344,10 @@ void AActor::UnlinkFromWorld (FLinkContext *ctx)
 				block->NextActor->PrevActor = block->PrevActor;
 			}
 			*(block->PrevActor) = block->NextActor;
+			if (blockthings != nullptr)
+			{
+				blockthings[block->BlockIndex].Remove(block);
+			}
 			FBlockNode *next = block->NextBlock;
 			block->Release ();
 			block = next;
@@ -513,6 +521,7 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 
 		BlockNode = NULL;
 		FBlockNode **alink = &this->BlockNode;
+		FBlockThings *blockthings = Level->blockmap.blockthings;
 		for (int i = -1; i < (int)check.Size(); i++)
 		{
 			DVector3 pos = i==-1? Pos() : PosRelative(check[i] & ~FPortalGroupArray::FLAT);
@@ -551,15 +560,53 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 						node->NextBlock = NULL;
 						(*alink) = node;
 						alink = &node->NextBlock;
+
+						if (blockthings != nullptr)
+						{
+							node->OffsetX = float(pos.X - X());
+							node->OffsetY = float(pos.Y - Y());
+							blockthings[node->BlockIndex].Add(node, float(pos.X), float(pos.Y), float(radius));
+						}
 					}
 				}
 			}
 		}
+		if (blockthings != nullptr && BlockNode != nullptr && BlockNode->NextBlock != nullptr)
+		{
+			for (auto node = BlockNode; node != nullptr; node = node->NextBlock)
+			{
+				blockthings[node->BlockIndex].Shared[node->Slot] = true;
+			}
+		}
 	}
 	// Portal links cannot be done unless the level is fully initialized.
 	if (!spawningmapthing) UpdateRenderSectorList();
 }
 
+bool PackedBlockThings;
+
+//==========================================================================
+//
+// Keeps the packed blockmap in sync when an actor is moved or resized without
+// getting relinked.
+//
+//==========================================================================
+
+void AActor::UpdateBlockThings()
+{
+	FBlockThings *blockthings = Level->blockmap.blockthings;
+	if (blockthings != nullptr)
+	{
+		for (auto node = BlockNode; node != nullptr; node = node->NextBlock)
+		{
+			auto &things = blockthings[node->BlockIndex];
+			things.X[node->Slot] = float(X() + node->OffsetX);
+			things.Y[node->Slot] = float(Y() + node->OffsetY);
+			things.Radius[node->Slot] = float(radius);
+		}
+	}
+}
+
 void AActor::SetOrigin(double x, double y, double z, bool moving)
 {
 	FLinkContext ctx;
@@ -920,6 +967,41 @@ void FBlockThingsIterator::init(const FBoundingBox &box)
 	Reset();
 }
 
+FBlockThingsIterator::~FBlockThingsIterator()
+{
+	if (filterthings != nullptr)
+	{
+		FBlockThings::Locks--;
+	}
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: SetFilter
+//
+// Only return things whose bounding box, grown by radius, contains the
+// given point. This is only a conservative prefilter for callers that do
+// the exact check themselves, so it is only used with the packed blockmap
+// where it can be done without touching the actors.
+//
+//===========================================================================
+
+void FBlockThingsIterator::SetFilter(double x, double y, double radius)
+{
+	if (Level->blockmap.blockthings == nullptr)
+	{
+		return;
+	}
+	if (filterthings == nullptr)
+	{
+		FBlockThings::Locks++;
+		filterthings = Level->blockmap.blockthings;
+	}
+	filterx = float(x);
+	filtery = float(y);
+	filterradius = float(radius) + 1.f;	// margin for the reduced precision
+}
+
 //===========================================================================
 //
 // FBlockThingsIterator :: ClearHash
@@ -946,11 +1028,18 @@ void FBlockThingsIterator::StartBlock(int x, int y)
 	if (Level->blockmap.isValidBlock(x, y))
 	{
 		block = Level->blockmap.blocklinks[y*Level->blockmap.bmapwidth + x];
+		if (filterthings != nullptr)
+		{
+			curthings = &filterthings[y*Level->blockmap.bmapwidth + x];
+			slot = curthings->Nodes.Size();
+		}
 	}
 	else
 	{
 		// invalid block
 		block = NULL;
+		curthings = nullptr;
+		slot = 0;
 	}
 }
 
@@ -973,16 +1062,160 @@ void FBlockThingsIterator::SwitchBlock(int x, int y)
 //
 //===========================================================================
 
+//===========================================================================
+//
+// FBlockThingsIterator :: AddToHash
+//
+// Returns false if the actor was already returned from another block.
+//
+//===========================================================================
+
+bool FBlockThingsIterator::AddToHash(AActor *me)
+{
+	HashEntry *entry;
+	int i;
+	size_t hash = ((size_t)me >> 3) % countof(Buckets);
+	for (i = Buckets[hash]; i >= 0; )
+	{
+		entry = GetHashEntry(i);
+		if (entry->Actor == me)
+		{ // I've already been checked. Skip to the next actor.
+			return false;
+		}
+		i = entry->Next;
+	}
+	// Add me to the hash table.
+	if (NumFixedHash < (int)countof(FixedHash))
+	{
+		entry = &FixedHash[NumFixedHash];
+		entry->Next = Buckets[hash];
+		Buckets[hash] = NumFixedHash++;
+	}
+	else
+	{
+		if (DynHash.Size() == 0)
+		{
+			DynHash.Grow(50);
+		}
+		i = DynHash.Reserve(1);
+		entry = &DynHash[i];
+		entry->Next = Buckets[hash];
+		Buckets[hash] = i + countof(FixedHash);
+	}
+	entry->Actor = me;
+	return true;
+}
+
+//===========================================================================
+//
+// ScanBlockThings
+//
+// Returns the highest index below 'end' whose entry either passes the
+// filter or is linked into several blocks and needs to go through the
+// hash, or -1 if there is none.
+//
+//===========================================================================
+
+static inline bool BlockThingOverlaps(const FBlockThings &things, int i, float x, float y, float radius)
+{
+	float dist = things.Radius[i] + radius;
+	return fabsf(things.X[i] - x) < dist && fabsf(things.Y[i] - y) < dist;
+}
+
+static int ScanBlockThings(const FBlockThings &things, int end, float x, float y, float radius)
+{
+	int i = end - 1;
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128 mx = _mm_set1_ps(x);
+	const __m128 my = _mm_set1_ps(y);
+	const __m128 mradius = _mm_set1_ps(radius);
+	const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	for (; i >= 3; i -= 4)
+	{
+		int first = i - 3;
+		__m128 dist = _mm_add_ps(_mm_loadu_ps(&things.Radius[first]), mradius);
+		__m128 dx = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&things.X[first]), mx), absmask);
+		__m128 dy = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&things.Y[first]), my), absmask);
+		int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(dx, dist), _mm_cmplt_ps(dy, dist)));
+		uint32_t shared;
+		memcpy(&shared, &things.Shared[first], sizeof(shared));
+		if (mask != 0 || shared != 0)
+		{
+			break;
+		}
+	}
+#endif
+	for (; i >= 0; i--)
+	{
+		if (things.Shared[i] || BlockThingOverlaps(things, i, x, y, radius))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: NextFiltered
+//
+// Walks the packed blockmap instead of the thing chains. This returns the
+// same things in the same order as Next() minus the ones rejected by the
+// filter.
+//
+//===========================================================================
+
+AActor *FBlockThingsIterator::NextFiltered()
+{
+	for (;;)
+	{
+		if (curthings != nullptr)
+		{
+			int i;
+			while ((i = ScanBlockThings(*curthings, slot, filterx, filtery, filterradius)) >= 0)
+			{
+				slot = i;
+				AActor *me = curthings->Actors[i];
+				if (!curthings->Shared[i])
+				{ // This actor doesn't span blocks, so we know it can only ever be checked once.
+					return me;
+				}
+				// Things that span blocks must always enter the hash, even if they get filtered out here.
+				if (AddToHash(me) && BlockThingOverlaps(*curthings, i, filterx, filtery, filterradius))
+				{
+					return me;
+				}
+			}
+			slot = 0;
+		}
+
+		if (++curx > maxx)
+		{
+			curx = minx;
+			if (++cury > maxy) return NULL;
+		}
+		StartBlock(curx, cury);
+	}
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: Next
+//
+//===========================================================================
+
 AActor *FBlockThingsIterator::Next(bool centeronly)
 {
+	if (filterthings != nullptr && !centeronly)
+	{
+		return NextFiltered();
+	}
 	for (;;)
 	{
 		while (block != NULL)
 		{
 			AActor *me = block->Me;
 			FBlockNode *mynode = block;
-			HashEntry *entry;
-			int i;
 
 			block = block->NextActor;
 			// Don't recheck things that were already checked
@@ -1005,40 +1238,9 @@ AActor *FBlockThingsIterator::Next(bool centeronly)
 					return me;
 				}
 			}
-			else
+			else if (AddToHash(me))
 			{
-				size_t hash = ((size_t)me >> 3) % countof(Buckets);
-				for (i = Buckets[hash]; i >= 0; )
-				{
-					entry = GetHashEntry(i);
-					if (entry->Actor == me)
-					{ // I've already been checked. Skip to the next actor.
-						break;
-					}
-					i = entry->Next;
-				}
-				if (i < 0)
-				{ // Add me to the hash table and return me.
-					if (NumFixedHash < (int)countof(FixedHash))
-					{
-						entry = &FixedHash[NumFixedHash];
-						entry->Next = Buckets[hash];
-						Buckets[hash] = NumFixedHash++;
-					}
-					else
-					{
-						if (DynHash.Size() == 0)
-						{
-							DynHash.Grow(50);
-						}
-						i = DynHash.Reserve(1);
-						entry = &DynHash[i];
-						entry->Next = Buckets[hash];
-						Buckets[hash] = i + countof(FixedHash);
-					}
-					entry->Actor = me;
-					return me;
-				}
+				return me;
 			}
 		}
 
@@ -1139,6 +1341,10 @@ void FMultiBlockThingsIterator::startIteratorForGroup(int group)
 	offset.X += checkpoint.X;
 	offset.Y += checkpoint.Y;
 	bbox.setBox(offset.X, offset.Y, checkpoint.Z);
+	if (filteroverlap)
+	{
+		blockIterator.SetFilter(offset.X, offset.Y, checkpoint.Z);
+	}
 	blockIterator.init(bbox);
 }
 
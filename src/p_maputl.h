@@ -9,6 +9,7 @@
 
 extern int validcount;
 struct FBlockNode;
+struct FBlockThings;
 
 struct divline_t
 {
@@ -300,9 +301,17 @@ class FBlockThingsIterator
 
 	HashEntry *GetHashEntry(int i) { return i < (int)countof(FixedHash) ? &FixedHash[i] : &DynHash[i - countof(FixedHash)]; }
 
+	// Only used with the packed blockmap
+	FBlockThings *filterthings = nullptr;
+	FBlockThings *curthings = nullptr;
+	int slot = 0;
+	float filterx, filtery, filterradius;
+
 	void StartBlock(int x, int y);
 	void SwitchBlock(int x, int y);
 	void ClearHash();
+	bool AddToHash(AActor *me);
+	AActor *NextFiltered();
 
 	// The following is only for use in the path traverser 
 	// and therefore declared private.
@@ -318,7 +327,9 @@ public:
 		Level = l;
 		init(box);
 	}
+	~FBlockThingsIterator();
 	void init(const FBoundingBox &box);
+	void SetFilter(double x, double y, double radius);
 	AActor *Next(bool centeronly = false);
 	void Reset() { StartBlock(minx, miny); }
 };
@@ -330,6 +341,7 @@ class FMultiBlockThingsIterator
 	short basegroup;
 	short portalflags;
 	short index;
+	bool filteroverlap = false;
 	FBlockThingsIterator blockIterator;
 	FBoundingBox bbox;
 
@@ -350,6 +362,14 @@ public:
 	FMultiBlockThingsIterator(FPortalGroupArray &check, FLevelLocals *Level, double checkx, double checky, double checkz, double checkh, double checkradius, bool ignorerestricted, sector_t *newsec);
 	bool Next(CheckResult *item);
 	void Reset();
+	// Skip things that are too far away to overlap the check radius, i.e. those the
+	// usual (thing->radius + checkradius) distance test would reject anyway.
+	// Only has an effect with the packed blockmap.
+	void FilterOverlapping()
+	{
+		filteroverlap = true;
+		Reset();
+	}
 	const FBoundingBox &Box() const
 	{
 		return bbox;
@@ -1162,6 +1162,7 @@ bool AActor::Grind(bool items)
 			flags3 |= MF3_DONTGIB;
 			Height = 0;
 			radius = 0;
+			UpdateBlockRadius();
 			return false;
 		}
 
@@ -1189,6 +1190,7 @@ bool AActor::Grind(bool items)
 			flags3 |= MF3_DONTGIB;
 			Height = 0;
 			radius = 0;
+			UpdateBlockRadius();
 			SetState (state);
 			if (isgeneric)	// Not a custom crush state, so colorize it appropriately.
 			{
@@ -1224,6 +1226,7 @@ bool AActor::Grind(bool items)
 				flags3 |= MF3_DONTGIB;
 				Height = 0;
 				radius = 0;
+				UpdateBlockRadius();
 				return false;
 			}
 
@@ -1234,6 +1237,7 @@ bool AActor::Grind(bool items)
 				gib->Alpha = Alpha;
 				gib->Height = 0;
 				gib->radius = 0;
+				gib->UpdateBlockRadius();
 				gib->Translation = BloodTranslation;
 			}
 			S_Sound (this, CHAN_BODY, "misc/fallingsplat", 1, ATTN_IDLE);
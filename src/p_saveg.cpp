@@ -60,8 +60,12 @@
 #include "r_sky.h"
 #include "version.h"
 #include "fragglescript/t_script.h"
+#include "g_game.h"
+#include "c_dispatch.h"
+#include "i_time.h"
 
 EXTERN_CVAR(Bool, save_formatted)
+EXTERN_CVAR(Bool, save_binary)
 
 //==========================================================================
 //
@@ -1033,11 +1037,12 @@ void FLevelLocals::Serialize(FSerializer &arc, bool hubload)
 
 //==========================================================================
 //
-// Archives the current level
+// Archives the current level. An uncompressed snapshot is only wanted by
+// the background saver which deflates it itself.
 //
 //==========================================================================
 
-void FLevelLocals::SnapshotLevel()
+void FLevelLocals::SnapshotLevel(bool compress)
 {
 	info->Snapshot.Clean();
 
@@ -1045,11 +1050,11 @@ void FLevelLocals::SnapshotLevel()
 	{
 		FSerializer arc(this);
 
-		if (arc.OpenWriter(save_formatted))
+		if (save_binary ? arc.OpenBinaryWriter() : arc.OpenWriter(save_formatted))
 		{
 			SaveVersion = SAVEVER;
 			Serialize(arc, false);
-			info->Snapshot = arc.GetCompressedOutput();
+			info->Snapshot = compress ? arc.GetCompressedOutput() : arc.GetStoredOutput();
 		}
 	}
 }
@@ -1114,3 +1119,54 @@ void FLevelLocals::UnSnapshotLevel(bool hubLoad)
 	}
 }
 
+//==========================================================================
+//
+// CCMD benchmarksave
+//
+// Writes the current level in both save formats and reports how long
+// saving and parsing took and how large the result is.
+//
+//==========================================================================
+
+CCMD(benchmarksave)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to benchmark saving.\n");
+		return;
+	}
+
+	int count = argv.argc() > 1 ? MAX(1, atoi(argv[1])) : 10;
+
+	for (int binary = 0; binary < 2; binary++)
+	{
+		uint64_t savetime = 0, parsetime = 0;
+		unsigned size = 0, compressedsize = 0;
+
+		for (int i = 0; i < count; i++)
+		{
+			uint64_t start = I_nsTime();
+			FSerializer arc(primaryLevel);
+			if (binary) arc.OpenBinaryWriter();
+			else arc.OpenWriter(save_formatted);
+			SaveVersion = SAVEVER;
+			primaryLevel->Serialize(arc, false);
+			FCompressedBuffer buffer = arc.GetCompressedOutput();
+			arc.Close();
+			uint64_t saved = I_nsTime();
+
+			FSerializer reader(primaryLevel);
+			reader.OpenReader(&buffer);
+			reader.Close();
+			uint64_t parsed = I_nsTime();
+
+			savetime += saved - start;
+			parsetime += parsed - saved;
+			size = buffer.mSize;
+			compressedsize = buffer.mCompressedSize;
+			buffer.Clean();
+		}
+		Printf("%-6s: %8u bytes, %8u compressed, save %.2f ms, parse %.2f ms\n", binary ? "binary" : "JSON",
+			size, compressedsize, savetime / (count * 1e6), parsetime / (count * 1e6));
+	}
+}
@@ -196,6 +196,17 @@ static void PrecacheLevel(FLevelLocals *Level)
 		if (tex.Exists()) AddToList(hitlist.Data(), tex, FTextureManager::HIT_Wall);
 	}
 
+	TArray<int> lumps;
+	for (i = 0; i < cnt; i++)
+	{
+		auto tex = TexMan.ByIndex(i);
+		if (hitlist[i] != 0 && tex != nullptr && tex->GetSourceLump() >= 0)
+		{
+			lumps.Push(tex->GetSourceLump());
+		}
+	}
+	Wads.PrefetchLumps(lumps);
+
 	// This is just a temporary solution, until the hardware renderer's texture manager is in a better state.
 	if (!V_IsHardwareRenderer())
 		SWRenderer->Precache(hitlist.Data(), actorhitlist);
@@ -315,6 +326,7 @@ void FLevelLocals::ClearLevelData()
 	subsectors.Clear();
 	gamesubsectors.Reset();
 	rejectmatrix.Clear();
+	P_ClearSightCache();
 	Zones.Clear();
 	blockmap.Clear();
 	Polyobjects.Clear();
@@ -461,10 +461,12 @@ bool P_Thing_Raise(AActor *thing, AActor *raiser, int flags)
 	thing->flags |= MF_SOLID;
 	thing->Height = info->Height;	// [RH] Use real height
 	thing->radius = info->radius;	// [RH] Use real radius
+	thing->UpdateBlockRadius();
 	if (!(flags & RF_NOCHECKPOSITION) && !P_CheckPosition (thing, thing->Pos()))
 	{
 		thing->flags = oldflags;
 		thing->radius = oldradius;
+		thing->UpdateBlockRadius();
 		thing->Height = oldheight;
 		return false;
 	}
@@ -504,12 +506,14 @@ bool P_Thing_CanRaise(AActor *thing)
 	thing->flags |= MF_SOLID;
 	thing->Height = info->Height;
 	thing->radius = info->radius;
+	thing->UpdateBlockRadius();
 
 	bool check = P_CheckPosition (thing, thing->Pos());
 
 	// Restore checked properties
 	thing->flags = oldflags;
 	thing->radius = oldradius;
+	thing->UpdateBlockRadius();
 	thing->Height = oldheight;
 
 	if (!check)
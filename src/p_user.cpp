@@ -655,6 +655,7 @@ bool player_t::Resurrect()
 	mo->renderflags &= ~RF_INVISIBLE;
 	mo->Height = mo->GetDefault()->Height;
 	mo->radius = mo->GetDefault()->radius;
+	mo->UpdateBlockRadius();
 	mo->special1 = 0;	// required for the Hexen fighter's fist attack. 
 								// This gets set by AActor::Die as flag for the wimpy death and must be reset here.
 	mo->SetState(mo->SpawnState);
@@ -1402,7 +1403,9 @@ void P_PredictPlayer (player_t *player)
 
 	// Blockmap ordering also needs to stay the same, so unlink the block nodes
 	// without releasing them. (They will be used again in P_UnpredictPlayer).
+	// The packed blockmap must not be compacted until then so that they can go back into their old slots.
 	FBlockNode *block = act->BlockNode;
+	FBlockThings *blockthings = act->Level->blockmap.blockthings;
 
 	while (block != NULL)
 	{
@@ -1411,9 +1414,14 @@ void P_PredictPlayer (player_t *player)
 			block->NextActor->PrevActor = block->PrevActor;
 		}
 		*(block->PrevActor) = block->NextActor;
+		if (blockthings != nullptr)
+		{
+			blockthings[block->BlockIndex].Remove(block);
+		}
 		block = block->NextBlock;
 	}
 	act->BlockNode = NULL;
+	FBlockThings::Locks++;
 
 	// Values too small to be usable for lerping can be considered "off".
 	bool CanLerp = (!(cl_predict_lerpscale < 0.01f) && (ticdup == 1)), DoLerp = false, NoInterpolateOld = R_GetViewInterpolationStatus();
@@ -1546,6 +1554,8 @@ void P_UnPredictPlayer ()
 
 		// Now fix the pointers in the blocknode chain
 		FBlockNode *block = act->BlockNode;
+		FBlockThings *blockthings = act->Level->blockmap.blockthings;
+		bool shared = block != nullptr && block->NextBlock != nullptr;
 
 		while (block != NULL)
 		{
@@ -1554,8 +1564,13 @@ void P_UnPredictPlayer ()
 			{
 				block->NextActor->PrevActor = &block->NextActor;
 			}
+			if (blockthings != nullptr)
+			{
+				blockthings[block->BlockIndex].Restore(block, float(act->X() + block->OffsetX), float(act->Y() + block->OffsetY), float(act->radius), shared);
+			}
 			block = block->NextBlock;
 		}
+		FBlockThings::Locks--;
 
 		actInvSel = InvSel;
 		player->inventorytics = inventorytics;
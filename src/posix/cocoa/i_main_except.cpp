@@ -48,6 +48,10 @@ void OriginalMainExcept(int argc, char** argv)
 	{
 		OriginalMainTry(argc, argv);
 	}
+	catch(const CExitEvent& exit)	// This is a regular exit initiated from deeper in the code.
+	{
+		::exit(exit.Reason());
+	}
 	catch(const std::exception& error)
 	{
 		const char* const message = error.what();
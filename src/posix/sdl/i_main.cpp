@@ -262,6 +262,11 @@ int main (int argc, char **argv)
 		C_InitConsole (80*8, 25*8, false);
 		D_DoomMain ();
     }
+    catch (const CExitEvent &exit)	// This is a regular exit initiated from deeper in the code.
+    {
+		I_ShutdownJoysticks();
+		::exit(exit.Reason());
+    }
     catch (std::exception &error)
     {
 		I_ShutdownJoysticks();
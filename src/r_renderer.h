@@ -29,6 +29,9 @@ struct FRenderer
 	// renders view to a savegame picture
 	virtual void WriteSavePic(player_t *player, FileWriter *file, int width, int height) = 0;
 
+	// renders a view into an offscreen canvas (used by the render benchmark)
+	virtual void RenderViewToCanvas(AActor *actor, DCanvas *canvas) = 0;
+
 	// draws player sprites with hardware acceleration (only useful for software rendering)
 	virtual void DrawRemainingPlayerSprites() = 0;
 
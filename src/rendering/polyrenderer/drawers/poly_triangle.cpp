@@ -158,7 +158,7 @@ void PolyTriangleThreadData::SetTransform(const Mat4f *newObjectToClip, const Ma
 	objectToWorld = newObjectToWorld;
 }
 
-void PolyTriangleThreadData::DrawElements(const PolyDrawArgs &drawargs, const void *vertices, const unsigned int *elements, int vcount, PolyDrawMode drawmode)
+void PolyTriangleThreadData::BinElements(const PolyDrawArgs &drawargs, const void *vertices, const unsigned int *elements, int vcount, PolyDrawMode drawmode, ScreenTriangleBins *bins)
 {
 	if (vcount < 3)
 		return;
@@ -173,7 +173,7 @@ void PolyTriangleThreadData::DrawElements(const PolyDrawArgs &drawargs, const vo
 		{
 			for (int j = 0; j < 3; j++)
 				vert[j] = ShadeVertex(drawargs, vertices, *(elements++));
-			DrawShadedTriangle(vert, ccw, &args);
+			BinShadedTriangle(vert, ccw, &args, bins);
 		}
 	}
 	else if (drawmode == PolyDrawMode::TriangleFan)
@@ -183,7 +183,7 @@ void PolyTriangleThreadData::DrawElements(const PolyDrawArgs &drawargs, const vo
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = ShadeVertex(drawargs, vertices, *(elements++));
-			DrawShadedTriangle(vert, ccw, &args);
+			BinShadedTriangle(vert, ccw, &args, bins);
 			vert[1] = vert[2];
 		}
 	}
@@ -195,7 +195,7 @@ void PolyTriangleThreadData::DrawElements(const PolyDrawArgs &drawargs, const vo
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = ShadeVertex(drawargs, vertices, *(elements++));
-			DrawShadedTriangle(vert, toggleccw, &args);
+			BinShadedTriangle(vert, toggleccw, &args, bins);
 			vert[0] = vert[1];
 			vert[1] = vert[2];
 			toggleccw = !toggleccw;
@@ -203,7 +203,7 @@ void PolyTriangleThreadData::DrawElements(const PolyDrawArgs &drawargs, const vo
 	}
 }
 
-void PolyTriangleThreadData::DrawArray(const PolyDrawArgs &drawargs, const void *vertices, int vcount, PolyDrawMode drawmode)
+void PolyTriangleThreadData::BinArray(const PolyDrawArgs &drawargs, const void *vertices, int vcount, PolyDrawMode drawmode, ScreenTriangleBins *bins)
 {
 	if (vcount < 3)
 		return;
@@ -220,7 +220,7 @@ void PolyTriangleThreadData::DrawArray(const PolyDrawArgs &drawargs, const void
 		{
 			for (int j = 0; j < 3; j++)
 				vert[j] = ShadeVertex(drawargs, vertices, vinput++);
-			DrawShadedTriangle(vert, ccw, &args);
+			BinShadedTriangle(vert, ccw, &args, bins);
 		}
 	}
 	else if (drawmode == PolyDrawMode::TriangleFan)
@@ -230,7 +230,7 @@ void PolyTriangleThreadData::DrawArray(const PolyDrawArgs &drawargs, const void
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = ShadeVertex(drawargs, vertices, vinput++);
-			DrawShadedTriangle(vert, ccw, &args);
+			BinShadedTriangle(vert, ccw, &args, bins);
 			vert[1] = vert[2];
 		}
 	}
@@ -242,7 +242,7 @@ void PolyTriangleThreadData::DrawArray(const PolyDrawArgs &drawargs, const void
 		for (int i = 2; i < vcount; i++)
 		{
 			vert[2] = ShadeVertex(drawargs, vertices, vinput++);
-			DrawShadedTriangle(vert, toggleccw, &args);
+			BinShadedTriangle(vert, toggleccw, &args, bins);
 			vert[0] = vert[1];
 			vert[1] = vert[2];
 			toggleccw = !toggleccw;
@@ -339,7 +339,7 @@ bool PolyTriangleThreadData::IsFrontfacing(TriDrawTriangleArgs *args)
 	return a <= 0.0f;
 }
 
-void PolyTriangleThreadData::DrawShadedTriangle(const ShadedTriVertex *vert, bool ccw, TriDrawTriangleArgs *args)
+void PolyTriangleThreadData::BinShadedTriangle(const ShadedTriVertex *vert, bool ccw, TriDrawTriangleArgs *args, ScreenTriangleBins *bins)
 {
 	// Reject triangle if degenerate
 	if (IsDegenerate(vert))
@@ -430,7 +430,7 @@ void PolyTriangleThreadData::DrawShadedTriangle(const ShadedTriVertex *vert, boo
 			args->v3 = &clippedvert[i - 2];
 			if (IsFrontfacing(args) == ccw && args->CalculateGradients())
 			{
-				ScreenTriangle::Draw(args, this);
+				bins->AddTriangle(args, viewport_y, dest_height);
 			}
 		}
 	}
@@ -443,7 +443,7 @@ void PolyTriangleThreadData::DrawShadedTriangle(const ShadedTriVertex *vert, boo
 			args->v3 = &clippedvert[i];
 			if (IsFrontfacing(args) != ccw && args->CalculateGradients())
 			{
-				ScreenTriangle::Draw(args, this);
+				bins->AddTriangle(args, viewport_y, dest_height);
 			}
 		}
 	}
@@ -716,10 +716,23 @@ DrawPolyTrianglesCommand::DrawPolyTrianglesCommand(const PolyDrawArgs &args, con
 
 void DrawPolyTrianglesCommand::Execute(DrawerThread *thread)
 {
-	if (!elements)
-		PolyTriangleThreadData::Get(thread)->DrawArray(args, vertices, count, mode);
-	else
-		PolyTriangleThreadData::Get(thread)->DrawElements(args, vertices, elements, count, mode);
+	PolyTriangleThreadData *poly = PolyTriangleThreadData::Get(thread);
+
+	// All threads have the same transform and viewport state at this point,
+	// so whichever gets here first sets up the triangles for everyone.
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!binned)
+	{
+		if (!elements)
+			poly->BinArray(args, vertices, count, mode, &bins);
+		else
+			poly->BinElements(args, vertices, elements, count, mode, &bins);
+		bins.Finish();
+		binned = true;
+	}
+	lock.unlock();
+
+	bins.Draw(&args, poly);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -60,8 +60,8 @@ public:
 	void SetWeaponScene(bool value) { weaponScene = value; }
 	void SetModelVertexShader(int frame1, int frame2, float interpolationFactor) { modelFrame1 = frame1; modelFrame2 = frame2; modelInterpolationFactor = interpolationFactor; }
 
-	void DrawElements(const PolyDrawArgs &args, const void *vertices, const unsigned int *elements, int count, PolyDrawMode mode);
-	void DrawArray(const PolyDrawArgs &args, const void *vertices, int vcount, PolyDrawMode mode);
+	void BinElements(const PolyDrawArgs &args, const void *vertices, const unsigned int *elements, int count, PolyDrawMode mode, ScreenTriangleBins *bins);
+	void BinArray(const PolyDrawArgs &args, const void *vertices, int vcount, PolyDrawMode mode, ScreenTriangleBins *bins);
 
 	int32_t core;
 	int32_t num_cores;
@@ -108,11 +108,15 @@ public:
 	uint8_t *dest = nullptr;
 	bool weaponScene = false;
 
+	// Widest span loop the true color span drawers may use. Only bench_polyspans lowers it, on its own thread data.
+	enum { SpanScalar, SpanSSE2, SpanAVX2 };
+	int spanSIMD = SpanAVX2;
+
 	int viewport_y = 0;
 
 private:
 	ShadedTriVertex ShadeVertex(const PolyDrawArgs &drawargs, const void *vertices, int index);
-	void DrawShadedTriangle(const ShadedTriVertex *vertices, bool ccw, TriDrawTriangleArgs *args);
+	void BinShadedTriangle(const ShadedTriVertex *vertices, bool ccw, TriDrawTriangleArgs *args, ScreenTriangleBins *bins);
 	static bool IsDegenerate(const ShadedTriVertex *vertices);
 	static bool IsFrontfacing(TriDrawTriangleArgs *args);
 	static int ClipEdge(const ShadedTriVertex *verts, ShadedTriVertex *clippedvert);
@@ -237,6 +241,10 @@ private:
 	const unsigned int *elements;
 	int count;
 	PolyDrawMode mode;
+
+	std::mutex mutex;
+	bool binned = false;
+	ScreenTriangleBins bins;
 };
 
 class DrawRectCommand : public PolyDrawerCommand
@@ -36,7 +36,14 @@
 #include "poly_triangle.h"
 #include "swrenderer/drawers/r_draw_rgba.h"
 #include "screen_triangle.h"
+#include "screen_triangle_simd.h"
 #include "x86.h"
+#include "i_time.h"
+#include "c_dispatch.h"
+#include "swrenderer/r_swcolormaps.h"
+#include <memory>
+
+EXTERN_CVAR(Bool, r_avx2drawers)
 
 static void SortVertices(const TriDrawTriangleArgs *args, ShadedTriVertex **sortedVertices)
 {
@@ -52,7 +59,7 @@ static void SortVertices(const TriDrawTriangleArgs *args, ShadedTriVertex **sort
 		std::swap(sortedVertices[1], sortedVertices[2]);
 }
 
-void ScreenTriangle::Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread)
+void ScreenTriangle::Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread, int cliptop, int clipbottom)
 {
 	using namespace TriScreenDrawerModes;
 
@@ -61,9 +68,9 @@ void ScreenTriangle::Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadDat
 	SortVertices(args, sortedVertices);
 
 	int clipleft = 0;
-	int cliptop = MAX(thread->viewport_y, thread->numa_start_y);
 	int clipright = thread->dest_width;
-	int clipbottom = MIN(thread->dest_height, thread->numa_end_y);
+	cliptop = MAX(cliptop, MAX(thread->viewport_y, thread->numa_start_y));
+	clipbottom = MIN(clipbottom, MIN(thread->dest_height, thread->numa_end_y));
 
 	int topY = (int)(sortedVertices[0]->y + 0.5f);
 	int midY = (int)(sortedVertices[1]->y + 0.5f);
@@ -151,6 +158,86 @@ void ScreenTriangle::Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadDat
 	TriangleDrawers[opt](args, thread, edges, topY, bottomY);
 }
 
+void ScreenTriangleBins::AddTriangle(const TriDrawTriangleArgs *args, int cliptop, int clipbottom)
+{
+	float minY = MIN(MIN(args->v1->y, args->v2->y), args->v3->y);
+	float maxY = MAX(MAX(args->v1->y, args->v2->y), args->v3->y);
+	int topY = MAX((int)(minY + 0.5f), cliptop);
+	int bottomY = MIN((int)(maxY + 0.5f), clipbottom);
+	if (topY >= bottomY)
+		return;
+
+	Triangle tri;
+	tri.v[0] = *args->v1;
+	tri.v[1] = *args->v2;
+	tri.v[2] = *args->v3;
+	tri.gradientX = args->gradientX;
+	tri.gradientY = args->gradientY;
+	tri.topY = topY;
+	tri.bottomY = bottomY;
+	triangles.push_back(tri);
+}
+
+void ScreenTriangleBins::Finish()
+{
+	if (triangles.empty())
+		return;
+
+	firstBin = triangles[0].topY / BinHeight;
+	int lastBin = (triangles[0].bottomY - 1) / BinHeight;
+	for (const Triangle &tri : triangles)
+	{
+		firstBin = MIN(firstBin, tri.topY / BinHeight);
+		lastBin = MAX(lastBin, (tri.bottomY - 1) / BinHeight);
+	}
+	int numBins = lastBin - firstBin + 1;
+
+	// Count the triangles in each bin and turn the counts into end positions
+	binStart.assign(numBins + 1, 0);
+	for (const Triangle &tri : triangles)
+	{
+		for (int bin = tri.topY / BinHeight; bin <= (tri.bottomY - 1) / BinHeight; bin++)
+			binStart[bin - firstBin]++;
+	}
+	for (int i = 1; i <= numBins; i++)
+		binStart[i] += binStart[i - 1];
+
+	// Filling backwards leaves binStart pointing at the start of each bin and keeps the triangles in submission order
+	binTriangles.resize(binStart[numBins]);
+	for (int i = (int)triangles.size() - 1; i >= 0; i--)
+	{
+		const Triangle &tri = triangles[i];
+		for (int bin = tri.topY / BinHeight; bin <= (tri.bottomY - 1) / BinHeight; bin++)
+			binTriangles[--binStart[bin - firstBin]] = i;
+	}
+}
+
+void ScreenTriangleBins::Draw(const PolyDrawArgs *uniforms, PolyTriangleThreadData *thread)
+{
+	int numBins = (int)binStart.size() - 1;
+	for (int i = 0; i < numBins; i++)
+	{
+		int binTop = (firstBin + i) * BinHeight;
+		int binBottom = binTop + BinHeight;
+		if (binBottom <= thread->numa_start_y || binTop >= thread->numa_end_y)
+			continue;
+
+		for (int j = binStart[i]; j < binStart[i + 1]; j++)
+		{
+			Triangle &tri = triangles[binTriangles[j]];
+
+			TriDrawTriangleArgs args;
+			args.v1 = &tri.v[0];
+			args.v2 = &tri.v[1];
+			args.v3 = &tri.v[2];
+			args.uniforms = uniforms;
+			args.gradientX = tri.gradientX;
+			args.gradientY = tri.gradientY;
+			ScreenTriangle::Draw(&args, thread, binTop, binBottom);
+		}
+	}
+}
+
 template<typename OptT>
 void DrawTriangle(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread, int16_t *edges, int topY, int bottomY)
 {
@@ -606,7 +693,48 @@ void StepSpan(int y, int x0, int x1, const TriDrawTriangleArgs *args, PolyTriang
 
 	#undef SETUP_STEP_SSE
 
-	for (int x = x0; x < x1; x += 4)
+	int x = x0;
+	if (BitsPerPixel == 32 && thread->spanSIMD == PolyTriangleThreadData::SpanAVX2 && r_avx2drawers && CPU.bAVX2)
+	{
+		ScreenSpanStep step;
+		step.posW = mposW;
+		step.stepW = mstepW;
+		if (OptT::Flags & SWOPT_DynLights)
+		{
+			step.posWorldX = mposWorldX;
+			step.posWorldY = mposWorldY;
+			step.posWorldZ = mposWorldZ;
+			step.stepWorldX = mstepWorldX;
+			step.stepWorldY = mstepWorldY;
+			step.stepWorldZ = mstepWorldZ;
+		}
+		if (!(ModeT::SWFlags & SWSTYLEF_Fill) && !(ModeT::SWFlags & SWSTYLEF_FogBoundary))
+		{
+			step.posU = mposU;
+			step.posV = mposV;
+			step.stepU = mstepU;
+			step.stepV = mstepV;
+			step.texMul1 = mtexMul1;
+			step.texMul2 = mtexMul2;
+		}
+
+		x = StepSpanAVX2<ModeT, OptT>(x0, x1, step, worldposX, worldposY, worldposZ, texel, texelV);
+
+		mposW = step.posW;
+		if (OptT::Flags & SWOPT_DynLights)
+		{
+			mposWorldX = step.posWorldX;
+			mposWorldY = step.posWorldY;
+			mposWorldZ = step.posWorldZ;
+		}
+		if (!(ModeT::SWFlags & SWSTYLEF_Fill) && !(ModeT::SWFlags & SWSTYLEF_FogBoundary))
+		{
+			mposU = step.posU;
+			mposV = step.posV;
+		}
+	}
+
+	for (; x < x1; x += 4)
 	{
 		__m128 rcp_posW = _mm_div_ps(_mm_set1_ps(1.0f), mposW); // precision of _mm_rcp_ps(mposW) is terrible!
 
@@ -831,13 +959,13 @@ void DrawSpanOpt32(int y, int x0, int x1, const TriDrawTriangleArgs *args, PolyT
 
 	StepSpan<ModeT, OptT, 32>(y, x0, x1, args, thread);
 
-	uint32_t fixedlight;
+	uint32_t fixedlight = 0;
 	uint32_t shade_fade_r, shade_fade_g, shade_fade_b, shade_light_r, shade_light_g, shade_light_b, desaturate, inv_desaturate;
 	fixed_t fuzzscale;
 	int _fuzzpos;
-	const uint32_t *texPixels, *translation;
-	uint32_t fillcolor;
-	int actoralpha;
+	const uint32_t *texPixels = nullptr, *translation = nullptr;
+	uint32_t fillcolor = 0;
+	int actoralpha = 256;
 
 	uint32_t *texel = thread->texel;
 	int32_t *texelV = thread->texelV;
@@ -893,43 +1021,12 @@ void DrawSpanOpt32(int y, int x0, int x1, const TriDrawTriangleArgs *args, PolyT
 
 	int sseend = x0;
 #ifndef NO_SSE
-	if (ModeT::BlendOp == STYLEOP_Add &&
-		ModeT::BlendSrc == STYLEALPHA_One &&
-		ModeT::BlendDest == STYLEALPHA_Zero &&
-		(ModeT::Flags & STYLEF_Alpha1) &&
-		!(OptT::Flags & SWOPT_ColoredFog) &&
-		!(ModeT::Flags & STYLEF_RedIsAlpha) &&
-		!(ModeT::SWFlags & SWSTYLEF_Skycap) &&
-		!(ModeT::SWFlags & SWSTYLEF_FogBoundary) &&
-		!(ModeT::SWFlags & SWSTYLEF_Fill))
+	if (ScreenSpanSIMD<ModeT, OptT>::Supported && thread->spanSIMD != PolyTriangleThreadData::SpanScalar)
 	{
-		sseend += (x1 - x0) / 2 * 2;
-
-		__m128i mlightshade;
-		if (OptT::Flags & SWOPT_FixedLight)
-			mlightshade = _mm_set1_epi16(fixedlight);
-
-		__m128i alphamask = _mm_set1_epi32(0xff000000);
-
-		for (int x = x0; x < sseend; x += 2)
-		{
-			__m128i mfg = _mm_unpacklo_epi8(_mm_setr_epi32(texPixels[texel[x]], texPixels[texel[x + 1]], 0, 0), _mm_setzero_si128());
-
-			if (!(OptT::Flags & SWOPT_FixedLight))
-				mlightshade = _mm_shuffle_epi32(_mm_shufflelo_epi16(_mm_cvtsi32_si128(*(int*)&lightarray[x]), _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(1, 1, 0, 0));
-
-			if (OptT::Flags & SWOPT_DynLights)
-			{
-				__m128i mdynlight = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&dynlights[x]), _mm_setzero_si128());
-				mfg = _mm_srli_epi16(_mm_mullo_epi16(_mm_min_epi16(_mm_add_epi16(mdynlight, mlightshade), _mm_set1_epi16(256)), mfg), 8);
-			}
-			else
-			{
-				mfg = _mm_srli_epi16(_mm_mullo_epi16(mlightshade, mfg), 8);
-			}
-
-			_mm_storel_epi64((__m128i*)&destLine[x], _mm_or_si128(_mm_packus_epi16(mfg, _mm_setzero_si128()), alphamask));
-		}
+		ScreenSpan32 span = { destLine, texel, lightarray, dynlights, texPixels, translation, fillcolor, (uint32_t)actoralpha, fixedlight };
+		if (thread->spanSIMD == PolyTriangleThreadData::SpanAVX2 && r_avx2drawers && CPU.bAVX2)
+			sseend = DrawSpan32AVX2<ModeT, OptT>(sseend, x1, span);
+		sseend = DrawSpan32SSE2<ModeT, OptT>(sseend, x1, span);
 	}
 #endif
 
@@ -2281,3 +2378,90 @@ void(*ScreenTriangle::TriangleDrawers[])(const TriDrawTriangleArgs *args, PolyTr
 };
 
 int ScreenTriangle::FuzzStart = 0;
+
+#ifndef NO_SSE
+CCMD(bench_polyspans)
+{
+	struct Entry
+	{
+		const char *Name;
+		TriBlendMode BlendMode;
+		double Alpha;
+		bool FixedLight;
+		uint32_t DynLightColor;
+	};
+
+	static const Entry entries[] =
+	{
+		{ "opaque", TriBlendMode::Opaque, 1.0, false, 0 },
+		{ "opaque fixed", TriBlendMode::Opaque, 1.0, true, 0 },
+		{ "opaque dynlight", TriBlendMode::Opaque, 1.0, false, 0xff403020 },
+		{ "normal", TriBlendMode::Normal, 1.0, false, 0 },
+		{ "translucent", TriBlendMode::Translucent, 0.5, false, 0 },
+		{ "add", TriBlendMode::Add, 0.5, false, 0 },
+		{ "add dynlight", TriBlendMode::Add, 0.5, false, 0xff403020 },
+	};
+	static const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+	int iterations = argv.argc() > 1 ? atoi(argv[1]) : 10;
+	if (iterations <= 0) iterations = 10;
+
+	// Mix of solid, transparent and partially transparent texels so the blended styles take all their branches
+	TArray<uint32_t> texture(128 * 128, true);
+	uint32_t seed = 1;
+	for (auto &texel : texture)
+	{
+		seed = seed * 1103515245 + 12345;
+		uint32_t alpha = (seed >> 8) % 7 == 0 ? 0 : (seed >> 8) % 7 == 1 ? (seed >> 16) & 0xff : 0xff;
+		texel = ((seed >> 8) & 0xffffff) | (alpha << 24);
+	}
+
+	ShadedTriVertex vertex = {};
+	vertex.w = 1.0f;
+
+	auto thread = std::make_unique<PolyTriangleThreadData>(0, 1, 0, 1, 0, MAXHEIGHT);
+
+	Printf("Poly span timings, %d iteration(s), single thread%s\n", iterations, CPU.bAVX2 ? "" : " (no AVX2 on this CPU)");
+	for (auto &size : sizes)
+	{
+		int width = size[0], height = size[1];
+		DCanvas canvas(width, height, true);
+		thread->SetViewport(0, 0, width, height, canvas.GetPixels(), width, height, canvas.GetPitch(), true);
+
+		for (auto &entry : entries)
+		{
+			PolyDrawArgs drawargs;
+			drawargs.SetTexture((const uint8_t*)texture.Data(), 128, 128);
+			drawargs.SetLight(&NormalLight, 192, 1.0, entry.FixedLight);
+			drawargs.SetDynLightColor(entry.DynLightColor);
+			drawargs.SetStyle(entry.BlendMode, entry.Alpha);
+
+			TriDrawTriangleArgs args = {};
+			args.v1 = args.v2 = args.v3 = &vertex;
+			args.uniforms = &drawargs;
+			args.gradientX.U = 3.0f / width;
+			args.gradientY.V = 2.0f / height;
+
+			auto drawer = ScreenTriangle::SpanDrawers32[(int)entry.BlendMode];
+
+			double ms[3];
+			for (int simd = PolyTriangleThreadData::SpanScalar; simd <= PolyTriangleThreadData::SpanAVX2; simd++)
+			{
+				thread->spanSIMD = simd;
+				uint64_t start = I_nsTime();
+				for (int i = 0; i < iterations; i++)
+				{
+					for (int y = 0; y < height; y++)
+						drawer(y, 0, width, &args, thread.get());
+				}
+				ms[simd] = (I_nsTime() - start) / 1e6 / iterations;
+			}
+
+			if (CPU.bAVX2 && r_avx2drawers)
+				Printf("%4dx%-4d %-16s scalar %7.2f ms  SSE2 %7.2f ms (%.2fx)  AVX2 %7.2f ms (%.2fx)\n", width, height, entry.Name, ms[0], ms[1], ms[0] / ms[1], ms[2], ms[0] / ms[2]);
+			else
+				Printf("%4dx%-4d %-16s scalar %7.2f ms  SSE2 %7.2f ms (%.2fx)\n", width, height, entry.Name, ms[0], ms[1], ms[0] / ms[1]);
+		}
+	}
+}
+#endif
@@ -131,7 +131,7 @@ enum class TriBlendMode
 class ScreenTriangle
 {
 public:
-	static void Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread);
+	static void Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread, int cliptop, int clipbottom);
 
 	static void(*TriangleDrawers[])(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread, int16_t *edges, int topY, int bottomY);
 
@@ -143,6 +143,34 @@ public:
 	static int FuzzStart;
 };
 
+// Screen triangles of a draw command. They are set up once by the first thread reaching
+// the command and sorted into horizontal bins. Each thread then rasterizes its own lines
+// bin by bin, so the color, depth and stencil lines of a bin stay in the cache while all
+// triangles covering it are drawn.
+class ScreenTriangleBins
+{
+public:
+	void AddTriangle(const TriDrawTriangleArgs *args, int cliptop, int clipbottom);
+	void Finish();
+	void Draw(const PolyDrawArgs *uniforms, PolyTriangleThreadData *thread);
+
+	enum { BinHeight = 64 };
+
+private:
+	struct Triangle
+	{
+		ShadedTriVertex v[3];
+		ScreenTriangleStepVariables gradientX;
+		ScreenTriangleStepVariables gradientY;
+		int topY, bottomY;
+	};
+
+	std::vector<Triangle> triangles;
+	std::vector<int> binStart;
+	std::vector<int> binTriangles;
+	int firstBin = 0;
+};
+
 namespace TriScreenDrawerModes
 {
 	enum SWStyleFlags
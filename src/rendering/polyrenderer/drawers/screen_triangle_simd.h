@@ -0,0 +1,371 @@
+/*
+**  SIMD span drawers for the poly renderer
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#ifndef NO_SSE
+
+#include "swrenderer/drawers/r_draw_rgba.h"
+#include "polyrenderer/drawers/screen_triangle.h"
+
+// Everything the vectorized part of DrawSpanOpt32 needs. StepSpan has already filled the texel, light and dynamic light arrays.
+struct ScreenSpan32
+{
+	uint32_t *destLine;
+	const uint32_t *texel;
+	const uint16_t *lightarray;
+	const uint32_t *dynlights;
+	const uint32_t *texPixels;
+	const uint32_t *translation;
+	uint32_t fillcolor;
+	uint32_t actoralpha;
+	uint32_t fixedlight;
+};
+
+// Styles covered by the SIMD loops: opaque, alpha blended and additive, with or without translation and a fixed color.
+// Colored fog, the sky cap, fog boundaries, fills, fuzz and the subtractive styles are left to the scalar loop.
+template<typename ModeT, typename OptT>
+struct ScreenSpanSIMD
+{
+	enum
+	{
+		Opaque = ModeT::BlendSrc == STYLEALPHA_One && ModeT::BlendDest == STYLEALPHA_Zero,
+		AlphaBlend = ModeT::BlendSrc == STYLEALPHA_Src && ModeT::BlendDest == STYLEALPHA_InvSrc,
+		AddBlend = ModeT::BlendSrc == STYLEALPHA_Src && ModeT::BlendDest == STYLEALPHA_One,
+
+		Supported = ModeT::BlendOp == STYLEOP_Add && (Opaque || AlphaBlend || AddBlend) &&
+			!(OptT::Flags & TriScreenDrawerModes::SWOPT_ColoredFog) &&
+			!(ModeT::Flags & STYLEF_RedIsAlpha) &&
+			!(ModeT::SWFlags & (TriScreenDrawerModes::SWSTYLEF_Skycap | TriScreenDrawerModes::SWSTYLEF_FogBoundary | TriScreenDrawerModes::SWSTYLEF_Fill | TriScreenDrawerModes::SWSTYLEF_SrcColorOneMinusSrcColor))
+	};
+};
+
+template<typename ModeT>
+FORCEINLINE uint32_t SampleSpan32(const ScreenSpan32 &span, int x)
+{
+	using namespace TriScreenDrawerModes;
+
+	uint32_t fg;
+	if (ModeT::SWFlags & SWSTYLEF_Translated)
+		fg = span.translation[((const uint8_t*)span.texPixels)[span.texel[x]]];
+	else
+		fg = span.texPixels[span.texel[x]];
+
+	if (ModeT::Flags & STYLEF_ColorIsFixed)
+		fg = (fg & 0xff000000) | (span.fillcolor & 0x00ffffff);
+	return fg;
+}
+
+// Four pixels per iteration, as two pixel pairs with 16 bits per channel. Returns where the scalar loop has to continue.
+template<typename ModeT, typename OptT>
+int DrawSpan32SSE2(int x0, int x1, const ScreenSpan32 &span)
+{
+	using namespace TriScreenDrawerModes;
+	typedef ScreenSpanSIMD<ModeT, OptT> SIMD;
+
+	uint32_t *destLine = span.destLine;
+	int sseend = x0 + (x1 - x0) / 4 * 4;
+
+	__m128i mfixedlight = _mm_set1_epi16(span.fixedlight);
+	__m128i mactoralpha = _mm_set1_epi32(span.actoralpha);
+	__m128i alphamask = _mm_set1_epi32(0xff000000);
+
+	for (int x = x0; x < sseend; x += 4)
+	{
+		__m128i fg = _mm_setr_epi32(SampleSpan32<ModeT>(span, x), SampleSpan32<ModeT>(span, x + 1), SampleSpan32<ModeT>(span, x + 2), SampleSpan32<ModeT>(span, x + 3));
+		__m128i fglo = _mm_unpacklo_epi8(fg, _mm_setzero_si128());
+		__m128i fghi = _mm_unpackhi_epi8(fg, _mm_setzero_si128());
+
+		__m128i lightlo, lighthi;
+		if (OptT::Flags & SWOPT_FixedLight)
+		{
+			lightlo = mfixedlight;
+			lighthi = mfixedlight;
+		}
+		else
+		{
+			__m128i light = _mm_loadl_epi64((const __m128i*)&span.lightarray[x]);
+			light = _mm_unpacklo_epi16(light, light);
+			lightlo = _mm_unpacklo_epi32(light, light);
+			lighthi = _mm_unpackhi_epi32(light, light);
+		}
+
+		if (OptT::Flags & SWOPT_DynLights)
+		{
+			__m128i dynlight = _mm_loadu_si128((const __m128i*)&span.dynlights[x]);
+			lightlo = _mm_min_epi16(_mm_add_epi16(_mm_unpacklo_epi8(dynlight, _mm_setzero_si128()), lightlo), _mm_set1_epi16(256));
+			lighthi = _mm_min_epi16(_mm_add_epi16(_mm_unpackhi_epi8(dynlight, _mm_setzero_si128()), lighthi), _mm_set1_epi16(256));
+		}
+
+		__m128i shadedlo = _mm_srli_epi16(_mm_mullo_epi16(fglo, lightlo), 8);
+		__m128i shadedhi = _mm_srli_epi16(_mm_mullo_epi16(fghi, lighthi), 8);
+
+		if (SIMD::Opaque)
+		{
+			_mm_storeu_si128((__m128i*)&destLine[x], _mm_or_si128(_mm_packus_epi16(shadedlo, shadedhi), alphamask));
+			continue;
+		}
+
+		__m128i fgalpha = _mm_srli_epi32(fg, 24);
+		if (!(ModeT::Flags & STYLEF_Alpha1))
+			fgalpha = _mm_srli_epi32(_mm_mullo_epi16(fgalpha, mactoralpha), 8);
+
+		__m128i sfactor = _mm_add_epi32(fgalpha, _mm_srli_epi32(fgalpha, 7)); // 255 -> 256
+		sfactor = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sfactor, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+		__m128i sfactorlo = _mm_unpacklo_epi32(sfactor, sfactor);
+		__m128i sfactorhi = _mm_unpackhi_epi32(sfactor, sfactor);
+
+		__m128i dest = _mm_loadu_si128((const __m128i*)&destLine[x]);
+		__m128i destlo = _mm_unpacklo_epi8(dest, _mm_setzero_si128());
+		__m128i desthi = _mm_unpackhi_epi8(dest, _mm_setzero_si128());
+
+		__m128i outlo, outhi;
+		if (SIMD::AddBlend)
+		{
+			// (dest * 256 + src * sfactor + 128) >> 8 is dest + ((src * sfactor + 128) >> 8). packus does the clamping.
+			outlo = _mm_add_epi16(destlo, _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(shadedlo, sfactorlo), _mm_set1_epi16(128)), 8));
+			outhi = _mm_add_epi16(desthi, _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(shadedhi, sfactorhi), _mm_set1_epi16(128)), 8));
+		}
+		else
+		{
+			__m128i dfactorlo = _mm_sub_epi16(_mm_set1_epi16(256), sfactorlo);
+			__m128i dfactorhi = _mm_sub_epi16(_mm_set1_epi16(256), sfactorhi);
+			outlo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(destlo, dfactorlo), _mm_mullo_epi16(shadedlo, sfactorlo)), _mm_set1_epi16(128)), 8);
+			outhi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(desthi, dfactorhi), _mm_mullo_epi16(shadedhi, sfactorhi)), _mm_set1_epi16(128)), 8);
+		}
+
+		__m128i out = _mm_or_si128(_mm_packus_epi16(outlo, outhi), alphamask);
+		if (SIMD::AlphaBlend)
+		{
+			// The scalar loop does not touch fully transparent pixels at all, not even their alpha
+			__m128i transparent = _mm_cmpeq_epi32(fgalpha, _mm_setzero_si128());
+			out = _mm_or_si128(_mm_and_si128(transparent, dest), _mm_andnot_si128(transparent, out));
+		}
+		_mm_storeu_si128((__m128i*)&destLine[x], out);
+	}
+
+	return sseend;
+}
+
+// Copies the value in the low 16 bits of each 64-bit lane to all four channels of that pixel
+AVX2_TARGET FORCEINLINE __m256i VECTORCALL SpreadSpanChannels(__m256i values)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(values, _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(0, 0, 0, 0));
+}
+
+// Eight pixels per iteration, as two groups of four with 16 bits per channel
+template<typename ModeT, typename OptT>
+AVX2_TARGET int DrawSpan32AVX2(int x0, int x1, const ScreenSpan32 &span)
+{
+	using namespace TriScreenDrawerModes;
+	typedef ScreenSpanSIMD<ModeT, OptT> SIMD;
+
+	uint32_t *destLine = span.destLine;
+	int avxend = x0 + (x1 - x0) / 8 * 8;
+
+	__m256i mfixedlight = _mm256_set1_epi16(span.fixedlight);
+	__m256i mactoralpha = _mm256_set1_epi32(span.actoralpha);
+	__m256i alphamask = _mm256_set1_epi32(0xff000000);
+
+	for (int x = x0; x < avxend; x += 8)
+	{
+		__m256i fg = _mm256_setr_epi32(
+			SampleSpan32<ModeT>(span, x), SampleSpan32<ModeT>(span, x + 1), SampleSpan32<ModeT>(span, x + 2), SampleSpan32<ModeT>(span, x + 3),
+			SampleSpan32<ModeT>(span, x + 4), SampleSpan32<ModeT>(span, x + 5), SampleSpan32<ModeT>(span, x + 6), SampleSpan32<ModeT>(span, x + 7));
+		__m256i fglo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(fg));
+		__m256i fghi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(fg, 1));
+
+		__m256i lightlo, lighthi;
+		if (OptT::Flags & SWOPT_FixedLight)
+		{
+			lightlo = mfixedlight;
+			lighthi = mfixedlight;
+		}
+		else
+		{
+			lightlo = SpreadSpanChannels(_mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i*)&span.lightarray[x])));
+			lighthi = SpreadSpanChannels(_mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i*)&span.lightarray[x + 4])));
+		}
+
+		if (OptT::Flags & SWOPT_DynLights)
+		{
+			__m256i dynlight = _mm256_loadu_si256((const __m256i*)&span.dynlights[x]);
+			lightlo = _mm256_min_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(dynlight)), lightlo), _mm256_set1_epi16(256));
+			lighthi = _mm256_min_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(dynlight, 1)), lighthi), _mm256_set1_epi16(256));
+		}
+
+		__m256i shadedlo = _mm256_srli_epi16(_mm256_mullo_epi16(fglo, lightlo), 8);
+		__m256i shadedhi = _mm256_srli_epi16(_mm256_mullo_epi16(fghi, lighthi), 8);
+
+		if (SIMD::Opaque)
+		{
+			__m256i out = _mm256_permute4x64_epi64(_mm256_packus_epi16(shadedlo, shadedhi), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i*)&destLine[x], _mm256_or_si256(out, alphamask));
+			continue;
+		}
+
+		__m256i fgalpha = _mm256_srli_epi32(fg, 24);
+		if (!(ModeT::Flags & STYLEF_Alpha1))
+			fgalpha = _mm256_srli_epi32(_mm256_mullo_epi16(fgalpha, mactoralpha), 8);
+
+		__m256i sfactor = _mm256_add_epi32(fgalpha, _mm256_srli_epi32(fgalpha, 7)); // 255 -> 256
+		__m256i sfactorlo = SpreadSpanChannels(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(sfactor)));
+		__m256i sfactorhi = SpreadSpanChannels(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(sfactor, 1)));
+
+		__m256i dest = _mm256_loadu_si256((const __m256i*)&destLine[x]);
+		__m256i destlo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(dest));
+		__m256i desthi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(dest, 1));
+
+		__m256i outlo, outhi;
+		if (SIMD::AddBlend)
+		{
+			outlo = _mm256_add_epi16(destlo, _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(shadedlo, sfactorlo), _mm256_set1_epi16(128)), 8));
+			outhi = _mm256_add_epi16(desthi, _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(shadedhi, sfactorhi), _mm256_set1_epi16(128)), 8));
+		}
+		else
+		{
+			__m256i dfactorlo = _mm256_sub_epi16(_mm256_set1_epi16(256), sfactorlo);
+			__m256i dfactorhi = _mm256_sub_epi16(_mm256_set1_epi16(256), sfactorhi);
+			outlo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(destlo, dfactorlo), _mm256_mullo_epi16(shadedlo, sfactorlo)), _mm256_set1_epi16(128)), 8);
+			outhi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(desthi, dfactorhi), _mm256_mullo_epi16(shadedhi, sfactorhi)), _mm256_set1_epi16(128)), 8);
+		}
+
+		__m256i out = _mm256_permute4x64_epi64(_mm256_packus_epi16(outlo, outhi), _MM_SHUFFLE(3, 1, 2, 0));
+		out = _mm256_or_si256(out, alphamask);
+		if (SIMD::AlphaBlend)
+			out = _mm256_blendv_epi8(out, dest, _mm256_cmpeq_epi32(fgalpha, _mm256_setzero_si256()));
+		_mm256_storeu_si256((__m256i*)&destLine[x], out);
+	}
+
+	return avxend;
+}
+
+// StepSpan's SSE2 stepping state: the positions of the next four pixels and the distance to the four after them
+struct ScreenSpanStep
+{
+	__m128 posW, posU, posV, posWorldX, posWorldY, posWorldZ;
+	__m128 stepW, stepU, stepV, stepWorldX, stepWorldY, stepWorldZ;
+	__m128i texMul1, texMul2;
+};
+
+// The second half holds the four pixels after the first
+AVX2_TARGET FORCEINLINE __m256 VECTORCALL SpanStepPositions(__m128 pos, __m128 step)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(pos), _mm_add_ps(pos, step), 1);
+}
+
+// Stepped by four pixels twice per iteration, so every lane rounds exactly like the SSE2 loop in StepSpan
+AVX2_TARGET FORCEINLINE __m256 VECTORCALL SpanStepNext(__m256 pos, __m256 step)
+{
+	return _mm256_add_ps(_mm256_add_ps(pos, step), step);
+}
+
+// Perspective divide and texel addressing for eight pixels per iteration. Leaves the SSE2 state at the returned position,
+// from where the SSE2 loop has to continue.
+template<typename ModeT, typename OptT>
+AVX2_TARGET int StepSpanAVX2(int x0, int x1, ScreenSpanStep &step, float *worldposX, float *worldposY, float *worldposZ, uint32_t *texel, int32_t *texelV)
+{
+	using namespace TriScreenDrawerModes;
+
+	enum { Textured = !(ModeT::SWFlags & SWSTYLEF_Fill) && !(ModeT::SWFlags & SWSTYLEF_FogBoundary) };
+
+	int avxend = x0 + (x1 - x0) / 8 * 8;
+
+	__m256 posW = SpanStepPositions(step.posW, step.stepW);
+	__m256 stepW = _mm256_set_m128(step.stepW, step.stepW);
+
+	__m256 posWorldX, posWorldY, posWorldZ, stepWorldX, stepWorldY, stepWorldZ;
+	if (OptT::Flags & SWOPT_DynLights)
+	{
+		posWorldX = SpanStepPositions(step.posWorldX, step.stepWorldX);
+		posWorldY = SpanStepPositions(step.posWorldY, step.stepWorldY);
+		posWorldZ = SpanStepPositions(step.posWorldZ, step.stepWorldZ);
+		stepWorldX = _mm256_set_m128(step.stepWorldX, step.stepWorldX);
+		stepWorldY = _mm256_set_m128(step.stepWorldY, step.stepWorldY);
+		stepWorldZ = _mm256_set_m128(step.stepWorldZ, step.stepWorldZ);
+	}
+
+	__m256 posU, posV, stepU, stepV;
+	__m256i texMul1, texMul2;
+	if (Textured)
+	{
+		posU = SpanStepPositions(step.posU, step.stepU);
+		posV = SpanStepPositions(step.posV, step.stepV);
+		stepU = _mm256_set_m128(step.stepU, step.stepU);
+		stepV = _mm256_set_m128(step.stepV, step.stepV);
+		texMul1 = _mm256_broadcastsi128_si256(step.texMul1);
+		texMul2 = _mm256_broadcastsi128_si256(step.texMul2);
+	}
+
+	for (int x = x0; x < avxend; x += 8)
+	{
+		__m256 rcp_posW = _mm256_div_ps(_mm256_set1_ps(1.0f), posW);
+
+		if (OptT::Flags & SWOPT_DynLights)
+		{
+			_mm256_storeu_ps(&worldposX[x], _mm256_mul_ps(posWorldX, rcp_posW));
+			_mm256_storeu_ps(&worldposY[x], _mm256_mul_ps(posWorldY, rcp_posW));
+			_mm256_storeu_ps(&worldposZ[x], _mm256_mul_ps(posWorldZ, rcp_posW));
+			posWorldX = SpanStepNext(posWorldX, stepWorldX);
+			posWorldY = SpanStepNext(posWorldY, stepWorldY);
+			posWorldZ = SpanStepNext(posWorldZ, stepWorldZ);
+		}
+		if (Textured)
+		{
+			// Same 16-bit multiplies as the SSE2 loop, on each 128-bit half
+			__m256 rcpW = _mm256_mul_ps(_mm256_set1_ps(0x01000000), rcp_posW);
+			__m256i u = _mm256_cvtps_epi32(_mm256_mul_ps(posU, rcpW));
+			__m256i v = _mm256_cvtps_epi32(_mm256_mul_ps(posV, rcpW));
+			_mm256_storeu_si256((__m256i*)&texelV[x], v);
+
+			__m256i texelX = _mm256_srli_epi32(_mm256_slli_epi32(u, 8), 17);
+			__m256i texelY = _mm256_srli_epi32(_mm256_slli_epi32(v, 8), 17);
+			__m256i texelXY = _mm256_mulhi_epu16(_mm256_slli_epi16(_mm256_packs_epi32(texelX, texelY), 1), texMul1);
+			__m256i texlo = _mm256_mullo_epi16(texelXY, texMul2);
+			__m256i texhi = _mm256_mulhi_epi16(texelXY, texMul2);
+			texelX = _mm256_unpacklo_epi16(texlo, texhi);
+			texelY = _mm256_unpackhi_epi16(texlo, texhi);
+			_mm256_storeu_si256((__m256i*)&texel[x], _mm256_add_epi32(texelX, texelY));
+
+			posU = SpanStepNext(posU, stepU);
+			posV = SpanStepNext(posV, stepV);
+		}
+
+		posW = SpanStepNext(posW, stepW);
+	}
+
+	step.posW = _mm256_castps256_ps128(posW);
+	if (OptT::Flags & SWOPT_DynLights)
+	{
+		step.posWorldX = _mm256_castps256_ps128(posWorldX);
+		step.posWorldY = _mm256_castps256_ps128(posWorldY);
+		step.posWorldZ = _mm256_castps256_ps128(posWorldZ);
+	}
+	if (Textured)
+	{
+		step.posU = _mm256_castps256_ps128(posU);
+		step.posV = _mm256_castps256_ps128(posV);
+	}
+	return avxend;
+}
+
+#endif
@@ -59,12 +59,19 @@
 #include "r_draw_sprite32_sse2.h"
 #include "r_draw_span32_sse2.h"
 #include "r_draw_sky32_sse2.h"
+#include "r_draw_wall32_avx2.h"
+#include "r_draw_span32_avx2.h"
+#include "r_draw_sprite32_avx2.h"
 #endif
 
 #include "gi.h"
 #include "stats.h"
 #include "x86.h"
+#include "i_time.h"
+#include "c_dispatch.h"
+#include "swrenderer/r_swcolormaps.h"
 #include <vector>
+#include <memory>
 
 // Use linear filtering when scaling up
 CVAR(Bool, r_magfilter, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
@@ -78,66 +85,75 @@ CVAR(Bool, r_mipmap, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 // Level of detail texture bias
 CVAR(Float, r_lod_bias, -1.5, 0); // To do: add CVAR_ARCHIVE | CVAR_GLOBALCONFIG when a good default has been decided
 
+// Use the AVX2 true color drawers when the CPU supports them
+CVAR(Bool, r_avx2drawers, true, 0);
+
+#ifndef NO_SSE
+#define PUSH_DRAWER(name, args) if (r_avx2drawers && CPU.bAVX2) Queue->Push<name##AVX2Command>(args); else Queue->Push<name##Command>(args)
+#else
+#define PUSH_DRAWER(name, args) Queue->Push<name##Command>(args)
+#endif
+
 namespace swrenderer
 {
 	void SWTruecolorDrawers::DrawWallColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWall32Command>(args);
+		PUSH_DRAWER(DrawWall32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallMaskedColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallMasked32Command>(args);
+		PUSH_DRAWER(DrawWallMasked32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallAddColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallAddClamp32Command>(args);
+		PUSH_DRAWER(DrawWallAddClamp32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallAddClampColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallAddClamp32Command>(args);
+		PUSH_DRAWER(DrawWallAddClamp32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallSubClampColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallSubClamp32Command>(args);
+		PUSH_DRAWER(DrawWallSubClamp32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawWallRevSubClampColumn(const WallDrawerArgs &args)
 	{
-		Queue->Push<DrawWallRevSubClamp32Command>(args);
+		PUSH_DRAWER(DrawWallRevSubClamp32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSprite32Command>(args);
+		PUSH_DRAWER(DrawSprite32, args);
 	}
 
 	void SWTruecolorDrawers::FillColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSprite32Command>(args);
+		PUSH_DRAWER(FillSprite32, args);
 	}
 
 	void SWTruecolorDrawers::FillAddColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteAddClamp32Command>(args);
+		PUSH_DRAWER(FillSpriteAddClamp32, args);
 	}
 
 	void SWTruecolorDrawers::FillAddClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteAddClamp32Command>(args);
+		PUSH_DRAWER(FillSpriteAddClamp32, args);
 	}
 
 	void SWTruecolorDrawers::FillSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteSubClamp32Command>(args);
+		PUSH_DRAWER(FillSpriteSubClamp32, args);
 	}
 
 	void SWTruecolorDrawers::FillRevSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<FillSpriteRevSubClamp32Command>(args);
+		PUSH_DRAWER(FillSpriteRevSubClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawFuzzColumn(const SpriteDrawerArgs &args)
@@ -151,57 +167,57 @@ namespace swrenderer
 
 	void SWTruecolorDrawers::DrawAddColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteAddClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteAddClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslated32Command>(args);
+		PUSH_DRAWER(DrawSpriteTranslated32, args);
 	}
 
 	void SWTruecolorDrawers::DrawTranslatedAddColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedAddClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteTranslatedAddClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawShadedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteShaded32Command>(args);
+		PUSH_DRAWER(DrawSpriteShaded32, args);
 	}
 
 	void SWTruecolorDrawers::DrawAddClampShadedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteAddClampShaded32Command>(args);
+		PUSH_DRAWER(DrawSpriteAddClampShaded32, args);
 	}
 
 	void SWTruecolorDrawers::DrawAddClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteAddClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteAddClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawAddClampTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedAddClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteTranslatedAddClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteSubClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteSubClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawSubClampTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedSubClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteTranslatedSubClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawRevSubClampColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteRevSubClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteRevSubClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawRevSubClampTranslatedColumn(const SpriteDrawerArgs &args)
 	{
-		Queue->Push<DrawSpriteTranslatedRevSubClamp32Command>(args);
+		PUSH_DRAWER(DrawSpriteTranslatedRevSubClamp32, args);
 	}
 
 	void SWTruecolorDrawers::DrawVoxelBlocks(const SpriteDrawerArgs &args, const VoxelBlock *blocks, int blockcount)
@@ -211,32 +227,32 @@ namespace swrenderer
 
 	void SWTruecolorDrawers::DrawSpan(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpan32Command>(args);
+		PUSH_DRAWER(DrawSpan32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMasked(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanMasked32Command>(args);
+		PUSH_DRAWER(DrawSpanMasked32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanTranslucent(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanTranslucent32Command>(args);
+		PUSH_DRAWER(DrawSpanTranslucent32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMaskedTranslucent(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanAddClamp32Command>(args);
+		PUSH_DRAWER(DrawSpanAddClamp32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanAddClamp(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanTranslucent32Command>(args);
+		PUSH_DRAWER(DrawSpanTranslucent32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMaskedAddClamp(const SpanDrawerArgs &args)
 	{
-		Queue->Push<DrawSpanAddClamp32Command>(args);
+		PUSH_DRAWER(DrawSpanAddClamp32, args);
 	}
 	
 	void SWTruecolorDrawers::DrawSingleSkyColumn(const SkyDrawerArgs &args)
@@ -932,3 +948,203 @@ namespace swrenderer
 		}
 	}
 }
+
+//==========================================================================
+//
+// Times the wall, sprite and span drawers in isolation, on a single
+// thread and straight into an offscreen canvas, at 1080p and 4K. Each
+// drawer fills the whole canvas once per iteration.
+//
+//==========================================================================
+
+#ifndef NO_SSE
+namespace swrenderer
+{
+	struct DrawerBench
+	{
+		RenderViewport *Viewport;
+		DrawerThread *Thread;
+		const uint32_t *Texture;
+		bool Masked;
+		bool Additive;
+		bool Linear;
+		int Iterations;
+	};
+
+	template<typename CommandT>
+	static double BenchWallDrawer(const DrawerBench &bench)
+	{
+		int width = bench.Viewport->RenderTarget->GetWidth();
+		int height = bench.Viewport->RenderTarget->GetHeight();
+
+		WallDrawerArgs args;
+		args.SetStyle(bench.Masked, bench.Additive, bench.Additive ? FRACUNIT / 2 : OPAQUE, &NormalLight);
+		args.SetCount(height);
+		args.SetTextureVPos(0);
+		args.SetTextureVStep(1 << 25);
+
+		uint64_t start = I_nsTime();
+		for (int i = 0; i < bench.Iterations; i++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const uint32_t *column = bench.Texture + (x & 127) * 128;
+				const uint32_t *column2 = bench.Texture + ((x + 1) & 127) * 128;
+				args.SetDest(bench.Viewport, x, 0);
+				args.SetTexture((const uint8_t*)column, bench.Linear ? (const uint8_t*)column2 : nullptr, 128);
+				args.SetTextureUPos((x * 5) & 15);
+				CommandT command(args);
+				command.Execute(bench.Thread);
+			}
+		}
+		return (I_nsTime() - start) / 1e6 / bench.Iterations;
+	}
+
+	template<typename CommandT>
+	static double BenchSpanDrawer(const DrawerBench &bench)
+	{
+		int width = bench.Viewport->RenderTarget->GetWidth();
+		int height = bench.Viewport->RenderTarget->GetHeight();
+
+		SpanDrawerArgs args;
+		args.SetStyle(bench.Masked, bench.Additive, bench.Additive ? FRACUNIT / 2 : OPAQUE, &NormalLight);
+		args.SetTexture((const uint8_t*)bench.Texture, 128, 128);
+		args.SetTextureLOD(0.0);
+		args.SetTextureUStep(1.0 / 128.0);
+		args.SetTextureVStep(0.5 / 128.0);
+		args.SetDestX1(0);
+		args.SetDestX2(width - 1);
+
+		bool magfilter = r_magfilter, minfilter = r_minfilter;
+		r_magfilter = r_minfilter = bench.Linear;
+
+		uint64_t start = I_nsTime();
+		for (int i = 0; i < bench.Iterations; i++)
+		{
+			for (int y = 0; y < height; y++)
+			{
+				args.SetDestY(bench.Viewport, y);
+				args.SetTextureUPos(y / 256.0);
+				args.SetTextureVPos(y / 128.0);
+				CommandT command(args);
+				command.Execute(bench.Thread);
+			}
+		}
+		double ms = (I_nsTime() - start) / 1e6 / bench.Iterations;
+
+		r_magfilter = magfilter;
+		r_minfilter = minfilter;
+		return ms;
+	}
+
+	template<typename CommandT>
+	static double BenchSpriteDrawer(const DrawerBench &bench)
+	{
+		int width = bench.Viewport->RenderTarget->GetWidth();
+		int height = bench.Viewport->RenderTarget->GetHeight();
+
+		ColormapLight light;
+		light.BaseColormap = &NormalLight;
+
+		SpriteDrawerArgs args;
+		args.SetStyle(bench.Viewport, LegacyRenderStyles[bench.Additive ? STYLE_Add : STYLE_Normal], bench.Additive ? FRACUNIT / 2 : OPAQUE, 0, 0, light);
+		args.SetCount(height);
+		args.SetTextureVPos(0);
+		args.SetTextureVStep(1 << 23);
+
+		uint64_t start = I_nsTime();
+		for (int i = 0; i < bench.Iterations; i++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const uint32_t *column = bench.Texture + (x & 127) * 128;
+				const uint32_t *column2 = bench.Texture + ((x + 1) & 127) * 128;
+				args.SetDest(bench.Viewport, x, 0);
+				args.SetTexture((const uint8_t*)column, bench.Linear ? (const uint8_t*)column2 : nullptr, 128);
+				args.SetTextureUPos((x * 5) & 15);
+				CommandT command(args);
+				command.Execute(bench.Thread);
+			}
+		}
+		return (I_nsTime() - start) / 1e6 / bench.Iterations;
+	}
+}
+
+CCMD(bench_drawers)
+{
+	using namespace swrenderer;
+
+	struct Entry
+	{
+		const char *Name;
+		bool Masked, Additive, Linear;
+		double (*SSE2)(const DrawerBench &);
+		double (*AVX2)(const DrawerBench &);
+	};
+
+	static const Entry entries[] =
+	{
+		{ "wall", false, false, false, BenchWallDrawer<DrawWall32Command>, BenchWallDrawer<DrawWall32AVX2Command> },
+		{ "wall linear", false, false, true, BenchWallDrawer<DrawWall32Command>, BenchWallDrawer<DrawWall32AVX2Command> },
+		{ "wall masked", true, false, false, BenchWallDrawer<DrawWallMasked32Command>, BenchWallDrawer<DrawWallMasked32AVX2Command> },
+		{ "wall addclamp", false, true, false, BenchWallDrawer<DrawWallAddClamp32Command>, BenchWallDrawer<DrawWallAddClamp32AVX2Command> },
+		{ "sprite", false, false, false, BenchSpriteDrawer<DrawSprite32Command>, BenchSpriteDrawer<DrawSprite32AVX2Command> },
+		{ "sprite linear", false, false, true, BenchSpriteDrawer<DrawSprite32Command>, BenchSpriteDrawer<DrawSprite32AVX2Command> },
+		{ "sprite addclamp", false, true, false, BenchSpriteDrawer<DrawSpriteAddClamp32Command>, BenchSpriteDrawer<DrawSpriteAddClamp32AVX2Command> },
+		{ "span", false, false, false, BenchSpanDrawer<DrawSpan32Command>, BenchSpanDrawer<DrawSpan32AVX2Command> },
+		{ "span linear", false, false, true, BenchSpanDrawer<DrawSpan32Command>, BenchSpanDrawer<DrawSpan32AVX2Command> },
+		{ "span masked", true, false, false, BenchSpanDrawer<DrawSpanMasked32Command>, BenchSpanDrawer<DrawSpanMasked32AVX2Command> },
+		{ "span addclamp", false, true, false, BenchSpanDrawer<DrawSpanAddClamp32Command>, BenchSpanDrawer<DrawSpanAddClamp32AVX2Command> },
+	};
+	static const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+	int iterations = argv.argc() > 1 ? atoi(argv[1]) : 10;
+	if (iterations <= 0) iterations = 10;
+
+	// Texture with a hole every few texels so the masked drawers have something to skip
+	TArray<uint32_t> texture(128 * 128, true);
+	uint32_t seed = 1;
+	for (auto &texel : texture)
+	{
+		seed = seed * 1103515245 + 12345;
+		texel = (seed >> 8) % 7 == 0 ? 0 : ((seed >> 8) | 0xff000000);
+	}
+
+	// RenderViewport::GetDest adds the view window offset of the current screen layout
+	int savedwindowx = viewwindowx, savedwindowy = viewwindowy;
+	viewwindowx = viewwindowy = 0;
+
+	auto viewport = std::make_unique<RenderViewport>();
+	auto thread = std::make_unique<DrawerThread>();
+
+	Printf("Drawer timings, %d iteration(s), single thread%s\n", iterations, CPU.bAVX2 ? "" : " (no AVX2 on this CPU)");
+	for (auto &size : sizes)
+	{
+		DCanvas canvas(size[0], size[1], true);
+		viewport->RenderTarget = &canvas;
+
+		DrawerBench bench = { viewport.get(), thread.get(), texture.Data(), false, false, false, iterations };
+		for (auto &entry : entries)
+		{
+			bench.Masked = entry.Masked;
+			bench.Additive = entry.Additive;
+			bench.Linear = entry.Linear;
+
+			double sse2 = entry.SSE2(bench);
+			if (CPU.bAVX2)
+			{
+				double avx2 = entry.AVX2(bench);
+				Printf("%4dx%-4d %-16s SSE2 %7.2f ms  AVX2 %7.2f ms  (%.2fx)\n", size[0], size[1], entry.Name, sse2, avx2, sse2 / avx2);
+			}
+			else
+			{
+				Printf("%4dx%-4d %-16s SSE2 %7.2f ms\n", size[0], size[1], entry.Name, sse2);
+			}
+		}
+		viewport->RenderTarget = nullptr;
+	}
+
+	viewwindowx = savedwindowx;
+	viewwindowy = savedwindowy;
+}
+#endif
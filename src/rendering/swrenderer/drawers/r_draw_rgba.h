@@ -70,6 +70,14 @@ namespace swrenderer
 	#define VECTORCALL
 	#endif
 
+	// Compile a function for AVX2 without enabling it for the whole file.
+	// MSVC allows AVX2 intrinsics anywhere.
+	#if defined(__GNUC__)
+	#define AVX2_TARGET __attribute__((target("avx2")))
+	#else
+	#define AVX2_TARGET
+	#endif
+
 	class DrawFuzzColumnRGBACommand : public DrawerCommand
 	{
 		int _x;
@@ -0,0 +1,534 @@
+/*
+**  Drawer commands for spans, AVX2 version
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/drawers/r_draw_span32_sse2.h"
+#include "swrenderer/viewport/r_spandrawer.h"
+
+namespace swrenderer
+{
+	// Same as DrawSpan32T, but shades and blends four pixels per iteration.
+	template<typename BlendT>
+	class DrawSpan32AVX2T : public DrawerCommand
+	{
+	protected:
+		SpanDrawerArgs args;
+
+	public:
+		DrawSpan32AVX2T(const SpanDrawerArgs &drawerargs) : args(drawerargs) { }
+
+		struct TextureData
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t xone;
+			uint32_t yone;
+			uint32_t xstep;
+			uint32_t ystep;
+			uint32_t xfrac;
+			uint32_t yfrac;
+			const uint32_t *source;
+		};
+
+		AVX2_TARGET void Execute(DrawerThread *thread) override
+		{
+			using namespace DrawSpan32TModes;
+
+			if (thread->line_skipped_by_thread(args.DestY())) return;
+
+			TextureData texdata;
+			texdata.width = args.TextureWidth();
+			texdata.height = args.TextureHeight();
+			texdata.xstep = args.TextureUStep();
+			texdata.ystep = args.TextureVStep();
+			texdata.xfrac = args.TextureUPos();
+			texdata.yfrac = args.TextureVPos();
+
+			texdata.source = (const uint32_t*)args.TexturePixels();
+
+			double lod = args.TextureLOD();
+			bool mipmapped = args.MipmappedTexture();
+
+			bool magnifying = lod < 0.0;
+			if (r_mipmap && mipmapped)
+			{
+				int level = (int)lod;
+				while (level > 0)
+				{
+					if (texdata.width <= 2 || texdata.height <= 2)
+						break;
+
+					texdata.source += texdata.width * texdata.height;
+					texdata.width = MAX<uint32_t>(texdata.width / 2, 1);
+					texdata.height = MAX<uint32_t>(texdata.height / 2, 1);
+					level--;
+				}
+			}
+
+			texdata.xone = (0x80000000u / texdata.width) << 1;
+			texdata.yone = (0x80000000u / texdata.height) << 1;
+
+			bool is_nearest_filter = (magnifying && !r_magfilter) || (!magnifying && !r_minfilter);
+			bool is_64x64 = texdata.width == 64 && texdata.height == 64;
+
+			auto shade_constants = args.ColormapConstants();
+			if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<SimpleShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<SimpleShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<SimpleShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+			}
+			else
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT, typename TextureSizeT>
+		AVX2_TARGET FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, TextureData texdata, ShadeConstants shade_constants)
+		{
+			using namespace DrawSpan32TModes;
+
+			// Shade constants
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			__m256i mlight = _mm256_broadcastsi128_si256(_mm_set_epi16(256, light, light, light, 256, light, light, light));
+			__m256i inv_light = _mm256_broadcastsi128_si256(_mm_set_epi16(0, 256 - light, 256 - light, 256 - light, 0, 256 - light, 256 - light, 256 - light));
+
+			__m256i inv_desaturate, shade_fade, shade_light;
+			int desaturate;
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				inv_desaturate = _mm256_broadcastsi128_si256(_mm_setr_epi16(256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate, 256 - shade_constants.desaturate));
+				shade_fade = _mm256_broadcastsi128_si256(_mm_set_epi16(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue, shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue));
+				shade_fade = _mm256_mullo_epi16(shade_fade, inv_light);
+				shade_light = _mm256_broadcastsi128_si256(_mm_set_epi16(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue, shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue));
+				desaturate = shade_constants.desaturate;
+			}
+			else
+			{
+				inv_desaturate = _mm256_setzero_si256();
+				shade_fade = _mm256_setzero_si256();
+				shade_light = _mm256_setzero_si256();
+				desaturate = 0;
+			}
+
+			auto lights = args.dc_lights;
+			auto num_lights = args.dc_num_lights;
+			float vpx = args.dc_viewpos.X;
+			float stepvpx = args.dc_viewpos_step.X;
+			// Stepped one pixel pair at a time like the SSE2 drawer does, so the float rounding matches it
+			__m128 viewpos_x = _mm_setr_ps(vpx, vpx + stepvpx, 0.0f, 0.0f);
+			__m128 step_viewpos_x = _mm_set1_ps(stepvpx * 2.0f);
+
+			int count = args.DestX2() - args.DestX1() + 1;
+			uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				texdata.xfrac -= texdata.xone / 2;
+				texdata.yfrac -= texdata.yone / 2;
+			}
+
+			uint32_t srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			uint32_t destalpha = args.DestAlpha() >> (FRACBITS - 8);
+
+			// Texture coordinates of the next four pixels, for the gathering nearest filter
+			__m128i mxfrac = _mm_add_epi32(_mm_set1_epi32(texdata.xfrac), _mm_mullo_epi32(_mm_set1_epi32(texdata.xstep), _mm_setr_epi32(0, 1, 2, 3)));
+			__m128i myfrac = _mm_add_epi32(_mm_set1_epi32(texdata.yfrac), _mm_mullo_epi32(_mm_set1_epi32(texdata.ystep), _mm_setr_epi32(0, 1, 2, 3)));
+			__m128i mxstep = _mm_set1_epi32(texdata.xstep * 4);
+			__m128i mystep = _mm_set1_epi32(texdata.ystep * 4);
+
+			int avxcount = count / 4;
+			for (int index = 0; index < avxcount; index++)
+			{
+				int offset = index * 4;
+
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)SpanBlendModes::Opaque)
+				{
+					bgcolor = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(dest + offset)));
+				}
+				else
+				{
+					bgcolor = _mm256_setzero_si256();
+				}
+
+				__m128i mfgcolor;
+				if (FilterModeT::Mode == (int)FilterModes::Nearest)
+				{
+					mfgcolor = SampleNearest4<TextureSizeT>(texdata, mxfrac, myfrac);
+					mxfrac = _mm_add_epi32(mxfrac, mxstep);
+					myfrac = _mm_add_epi32(myfrac, mystep);
+				}
+				else
+				{
+					unsigned int ifgcolor[4];
+					for (int i = 0; i < 4; i++)
+					{
+						ifgcolor[i] = Sample<FilterModeT, TextureSizeT>(texdata.width, texdata.height, texdata.xone, texdata.yone, texdata.xfrac, texdata.yfrac, texdata.source);
+						texdata.xfrac += texdata.xstep;
+						texdata.yfrac += texdata.ystep;
+					}
+					mfgcolor = _mm_loadu_si128((const __m128i*)ifgcolor);
+				}
+				__m256i fgcolor = _mm256_cvtepu8_epi16(mfgcolor);
+
+				__m128 viewpos_x4 = _mm_movelh_ps(viewpos_x, _mm_add_ps(viewpos_x, step_viewpos_x));
+				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_x4);
+				__m128i outcolor = Blend(fgcolor, bgcolor, srcalpha, destalpha, mfgcolor);
+
+				_mm_storeu_si128((__m128i*)(dest + offset), outcolor);
+				viewpos_x = _mm_add_ps(_mm_add_ps(viewpos_x, step_viewpos_x), step_viewpos_x);
+			}
+
+			int remaining = count - avxcount * 4;
+			if (remaining > 0)
+			{
+				if (FilterModeT::Mode == (int)FilterModes::Nearest)
+				{
+					texdata.xfrac = _mm_cvtsi128_si32(mxfrac);
+					texdata.yfrac = _mm_cvtsi128_si32(myfrac);
+				}
+
+				int offset = avxcount * 4;
+				uint32_t desttmp[4] = { 0, 0, 0, 0 };
+
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)SpanBlendModes::Opaque)
+				{
+					for (int i = 0; i < remaining; i++)
+						desttmp[i] = dest[offset + i];
+					bgcolor = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)desttmp));
+				}
+				else
+				{
+					bgcolor = _mm256_setzero_si256();
+				}
+
+				unsigned int ifgcolor[4] = { 0, 0, 0, 0 };
+				for (int i = 0; i < remaining; i++)
+				{
+					ifgcolor[i] = Sample<FilterModeT, TextureSizeT>(texdata.width, texdata.height, texdata.xone, texdata.yone, texdata.xfrac, texdata.yfrac, texdata.source);
+					texdata.xfrac += texdata.xstep;
+					texdata.yfrac += texdata.ystep;
+				}
+
+				__m128i mfgcolor = _mm_loadu_si128((const __m128i*)ifgcolor);
+				__m256i fgcolor = _mm256_cvtepu8_epi16(mfgcolor);
+
+				__m128 viewpos_x4 = _mm_movelh_ps(viewpos_x, _mm_add_ps(viewpos_x, step_viewpos_x));
+				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_x4);
+				__m128i outcolor = Blend(fgcolor, bgcolor, srcalpha, destalpha, mfgcolor);
+
+				_mm_storeu_si128((__m128i*)desttmp, outcolor);
+				for (int i = 0; i < remaining; i++)
+					dest[offset + i] = desttmp[i];
+			}
+		}
+
+		template<typename FilterModeT, typename TextureSizeT>
+		AVX2_TARGET FORCEINLINE unsigned int VECTORCALL Sample(uint32_t width, uint32_t height, uint32_t xone, uint32_t yone, uint32_t xfrac, uint32_t yfrac, const uint32_t *source)
+		{
+			using namespace DrawSpan32TModes;
+
+			if (FilterModeT::Mode == (int)FilterModes::Nearest && TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+			{
+				int sample_index = ((xfrac >> (32 - 6 - 6)) & (63 * 64)) + (yfrac >> (32 - 6));
+				return source[sample_index];
+			}
+			else if (FilterModeT::Mode == (int)FilterModes::Nearest)
+			{
+				uint32_t x = ((xfrac >> 16) * width) >> 16;
+				uint32_t y = ((yfrac >> 16) * height) >> 16;
+				int sample_index = x * height + y;
+				return source[sample_index];
+			}
+			else
+			{
+				uint32_t p00, p01, p10, p11;
+				uint32_t frac_x, frac_y;
+				if (TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+				{
+					frac_x = xfrac >> 16 << 6;
+					frac_y = yfrac >> 16 << 6;
+					uint32_t x0 = frac_x >> 16;
+					uint32_t y0 = frac_y >> 16;
+					uint32_t x1 = (x0 + 1) & 0x3f;
+					uint32_t y1 = (y0 + 1) & 0x3f;
+					p00 = source[(y0 + (x0 << 6))];
+					p01 = source[(y1 + (x0 << 6))];
+					p10 = source[(y0 + (x1 << 6))];
+					p11 = source[(y1 + (x1 << 6))];
+				}
+				else
+				{
+					frac_x = (xfrac >> 16) * width;
+					frac_y = (yfrac >> 16) * height;
+					uint32_t x0 = frac_x >> 16;
+					uint32_t y0 = frac_y >> 16;
+					uint32_t x1 = (((xfrac + xone) >> 16) * width) >> 16;
+					uint32_t y1 = (((yfrac + yone) >> 16) * height) >> 16;
+					p00 = source[y0 + x0 * height];
+					p01 = source[y1 + x0 * height];
+					p10 = source[y0 + x1 * height];
+					p11 = source[y1 + x1 * height];
+				}
+
+				uint32_t inv_b = (frac_x >> 12) & 15;
+				uint32_t inv_a = (frac_y >> 12) & 15;
+				uint32_t a = 16 - inv_a;
+				uint32_t b = 16 - inv_b;
+
+				uint32_t sred = (RPART(p00) * (a * b) + RPART(p01) * (inv_a * b) + RPART(p10) * (a * inv_b) + RPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				uint32_t sgreen = (GPART(p00) * (a * b) + GPART(p01) * (inv_a * b) + GPART(p10) * (a * inv_b) + GPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				uint32_t sblue = (BPART(p00) * (a * b) + BPART(p01) * (inv_a * b) + BPART(p10) * (a * inv_b) + BPART(p11) * (inv_a * inv_b) + 127) >> 8;
+				uint32_t salpha = (APART(p00) * (a * b) + APART(p01) * (inv_a * b) + APART(p10) * (a * inv_b) + APART(p11) * (inv_a * inv_b) + 127) >> 8;
+
+				return (salpha << 24) | (sred << 16) | (sgreen << 8) | sblue;
+			}
+		}
+
+		// Nearest filtered samples for four pixels, fetched with a single gather
+		template<typename TextureSizeT>
+		AVX2_TARGET FORCEINLINE __m128i VECTORCALL SampleNearest4(const TextureData &texdata, __m128i xfrac, __m128i yfrac)
+		{
+			using namespace DrawSpan32TModes;
+
+			__m128i sample_index;
+			if (TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+			{
+				sample_index = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(xfrac, 32 - 6 - 6), _mm_set1_epi32(63 * 64)), _mm_srli_epi32(yfrac, 32 - 6));
+			}
+			else
+			{
+				__m128i x = _mm_srli_epi32(_mm_mullo_epi32(_mm_srli_epi32(xfrac, 16), _mm_set1_epi32(texdata.width)), 16);
+				__m128i y = _mm_srli_epi32(_mm_mullo_epi32(_mm_srli_epi32(yfrac, 16), _mm_set1_epi32(texdata.height)), 16);
+				sample_index = _mm_add_epi32(_mm_mullo_epi32(x, _mm_set1_epi32(texdata.height)), y);
+			}
+			return _mm_i32gather_epi32((const int *)texdata.source, sample_index, 4);
+		}
+
+		template<typename ShadeModeT>
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL Shade(__m256i fgcolor, __m256i mlight, int desaturate, __m256i inv_desaturate, __m256i shade_fade, __m256i shade_light, const DrawerLight *lights, int num_lights, __m128 viewpos_x)
+		{
+			using namespace DrawSpan32TModes;
+
+			__m256i material = fgcolor;
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, mlight), 8);
+			}
+			else
+			{
+				// ((red * 77 + green * 143 + blue * 37) >> 8) * desaturate, copied to the color channels of each pixel
+				__m256i intensity = _mm256_madd_epi16(fgcolor, _mm256_set1_epi64x(0x0000004d008f0025LL));
+				intensity = _mm256_srli_epi32(_mm256_hadd_epi32(intensity, intensity), 8);
+				intensity = _mm256_shuffle_epi8(intensity, _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 1, 0, 1, 0, 1, -1, -1, 4, 5, 4, 5, 4, 5, -1, -1)));
+				__m256i mintensity = _mm256_mullo_epi16(intensity, _mm256_set1_epi16(desaturate));
+
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, inv_desaturate), mintensity), 8);
+				fgcolor = _mm256_mullo_epi16(fgcolor, mlight);
+				fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade_fade, fgcolor), 8);
+				fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade_light), 8);
+			}
+
+			return AddLights(material, fgcolor, lights, num_lights, viewpos_x);
+		}
+
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL AddLights(__m256i material, __m256i fgcolor, const DrawerLight *lights, int num_lights, __m128 viewpos_x)
+		{
+			using namespace DrawSpan32TModes;
+
+			__m256i lit = _mm256_setzero_si256();
+
+			for (int i = 0; i != num_lights; i++)
+			{
+				__m128 light_x = _mm_set1_ps(lights[i].x);
+				__m128 light_y = _mm_set1_ps(lights[i].y);
+				__m128 light_z = _mm_set1_ps(lights[i].z);
+				__m128 light_radius = _mm_set1_ps(lights[i].radius);
+				__m128 m256 = _mm_set1_ps(256.0f);
+
+				// L = light-pos
+				// dist = sqrt(dot(L, L))
+				// distance_attenuation = 1 - MIN(dist * (1/radius), 1)
+				__m128 Lyz2 = light_y; // L.y*L.y + L.z*L.z
+				__m128 Lx = _mm_sub_ps(light_x, viewpos_x);
+				__m128 dist2 = _mm_add_ps(Lyz2, _mm_mul_ps(Lx, Lx));
+				__m128 rcp_dist = _mm_rsqrt_ps(dist2);
+				__m128 dist = _mm_mul_ps(dist2, rcp_dist);
+				__m128 distance_attenuation = _mm_sub_ps(m256, _mm_min_ps(_mm_mul_ps(dist, light_radius), m256));
+
+				// The simple light type
+				__m128 simple_attenuation = distance_attenuation;
+
+				// The point light type
+				// diffuse = dot(N,L) * attenuation
+				__m128 point_attenuation = _mm_mul_ps(_mm_mul_ps(light_z, rcp_dist), distance_attenuation);
+
+				__m128 is_attenuated = _mm_cmpeq_ps(light_z, _mm_setzero_ps());
+				__m128i attenuation = _mm_cvtps_epi32(_mm_blendv_ps(point_attenuation, simple_attenuation, is_attenuated));
+
+				// Spread the four attenuation values over the four channels of their pixel
+				attenuation = _mm_packs_epi32(attenuation, attenuation);
+				attenuation = _mm_unpacklo_epi16(attenuation, attenuation);
+				__m256i mattenuation = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi32(attenuation, attenuation)), _mm_unpackhi_epi32(attenuation, attenuation), 1);
+
+				__m128i light_color = _mm_cvtsi32_si128(lights[i].color);
+				light_color = _mm_unpacklo_epi8(light_color, _mm_setzero_si128());
+				__m256i mlight_color = _mm256_broadcastq_epi64(light_color);
+
+				lit = _mm256_add_epi16(lit, _mm256_srli_epi16(_mm256_mullo_epi16(mlight_color, mattenuation), 8));
+			}
+
+			lit = _mm256_min_epi16(lit, _mm256_set1_epi16(256));
+
+			fgcolor = _mm256_add_epi16(fgcolor, _mm256_srli_epi16(_mm256_mullo_epi16(material, lit), 8));
+			fgcolor = _mm256_min_epi16(fgcolor, _mm256_set1_epi16(255));
+			return fgcolor;
+		}
+
+		// Spreads one value per pixel (below 65536) over the four 16-bit channels of that pixel
+		AVX2_TARGET FORCEINLINE __m256i VECTORCALL SpreadPixels(__m128i values)
+		{
+			__m256i spread = _mm256_cvtepu32_epi64(values);
+			spread = _mm256_or_si256(spread, _mm256_slli_epi64(spread, 16));
+			return _mm256_or_si256(spread, _mm256_slli_epi64(spread, 32));
+		}
+
+		AVX2_TARGET FORCEINLINE __m128i VECTORCALL Pack(__m256i color)
+		{
+			__m256i packed = _mm256_packus_epi16(color, _mm256_setzero_si256());
+			packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+			return _mm256_castsi256_si128(packed);
+		}
+
+		AVX2_TARGET FORCEINLINE __m128i VECTORCALL Blend(__m256i fgcolor, __m256i bgcolor, uint32_t srcalpha, uint32_t destalpha, __m128i ifgcolor)
+		{
+			using namespace DrawSpan32TModes;
+
+			if (BlendT::Mode == (int)SpanBlendModes::Opaque)
+			{
+				__m128i outcolor = Pack(fgcolor);
+				outcolor = _mm_or_si128(outcolor, _mm_set1_epi32(0xff000000));
+				return outcolor;
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::Masked)
+			{
+				__m256i mask = _mm256_cvtepu8_epi16(_mm_cmpeq_epi32(Pack(fgcolor), _mm_setzero_si128()));
+				__m256i outcolor = _mm256_or_si256(_mm256_and_si256(mask, bgcolor), _mm256_andnot_si256(mask, fgcolor));
+				return _mm_or_si128(Pack(outcolor), _mm_set1_epi32(0xff000000));
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::Translucent)
+			{
+				__m256i fgalpha = _mm256_set1_epi16(srcalpha);
+				__m256i bgalpha = _mm256_set1_epi16(destalpha);
+
+				fgcolor = _mm256_mullo_epi16(fgcolor, fgalpha);
+				bgcolor = _mm256_mullo_epi16(bgcolor, bgalpha);
+
+				__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+				__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+				__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+				__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+				__m256i out_lo = _mm256_srai_epi32(_mm256_add_epi32(fg_lo, bg_lo), 8);
+				__m256i out_hi = _mm256_srai_epi32(_mm256_add_epi32(fg_hi, bg_hi), 8);
+				__m256i outcolor = _mm256_packs_epi32(out_lo, out_hi);
+				return _mm_or_si128(Pack(outcolor), _mm_set1_epi32(0xff000000));
+			}
+			else
+			{
+				__m128i alpha = _mm_srli_epi32(ifgcolor, 24);
+				alpha = _mm_add_epi32(alpha, _mm_srli_epi32(alpha, 7)); // 255->256
+				__m128i inv_alpha = _mm_sub_epi32(_mm_set1_epi32(256), alpha);
+				__m128i bgalpha = _mm_add_epi32(_mm_mullo_epi32(_mm_set1_epi32(destalpha), alpha), _mm_slli_epi32(inv_alpha, 8));
+				bgalpha = _mm_srli_epi32(_mm_add_epi32(bgalpha, _mm_set1_epi32(128)), 8);
+				__m128i fgalpha = _mm_mullo_epi32(_mm_set1_epi32(srcalpha), alpha);
+				fgalpha = _mm_srli_epi32(_mm_add_epi32(fgalpha, _mm_set1_epi32(128)), 8);
+
+				fgcolor = _mm256_mullo_epi16(fgcolor, SpreadPixels(fgalpha));
+				bgcolor = _mm256_mullo_epi16(bgcolor, SpreadPixels(bgalpha));
+
+				__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+				__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+				__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+				__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+				__m256i out_lo, out_hi;
+				if (BlendT::Mode == (int)SpanBlendModes::AddClamp)
+				{
+					out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+					out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+				}
+				else if (BlendT::Mode == (int)SpanBlendModes::SubClamp)
+				{
+					out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+					out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+				}
+				else if (BlendT::Mode == (int)SpanBlendModes::RevSubClamp)
+				{
+					out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+					out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+				}
+
+				out_lo = _mm256_srai_epi32(out_lo, 8);
+				out_hi = _mm256_srai_epi32(out_hi, 8);
+				__m256i outcolor = _mm256_packs_epi32(out_lo, out_hi);
+				return _mm_or_si128(Pack(outcolor), _mm_set1_epi32(0xff000000));
+			}
+		}
+	};
+
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::OpaqueSpan> DrawSpan32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::MaskedSpan> DrawSpanMasked32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::TranslucentSpan> DrawSpanTranslucent32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::AddClampSpan> DrawSpanAddClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::SubClampSpan> DrawSpanSubClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::RevSubClampSpan> DrawSpanRevSubClamp32AVX2Command;
+}
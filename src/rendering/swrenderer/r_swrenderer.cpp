@@ -234,6 +234,26 @@ void FSoftwareRenderer::WriteSavePic (player_t *player, FileWriter *file, int wi
 	DoWriteSavePic(file, SS_PAL, pic.GetPixels(), width, height, r_viewpoint.sector, false);
 }
 
+void FSoftwareRenderer::RenderViewToCanvas(AActor *actor, DCanvas *canvas)
+{
+	if (V_IsPolyRenderer())
+	{
+		PolyRenderer::Instance()->Viewpoint = r_viewpoint;
+		PolyRenderer::Instance()->Viewwindow = r_viewwindow;
+		PolyRenderer::Instance()->RenderViewToCanvas(actor, canvas, 0, 0, canvas->GetWidth(), canvas->GetHeight(), true);
+		r_viewpoint = PolyRenderer::Instance()->Viewpoint;
+		r_viewwindow = PolyRenderer::Instance()->Viewwindow;
+	}
+	else
+	{
+		mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
+		mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
+		mScene.RenderViewToCanvas(actor, canvas, 0, 0, canvas->GetWidth(), canvas->GetHeight(), true);
+		r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
+		r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
+	}
+}
+
 void FSoftwareRenderer::DrawRemainingPlayerSprites()
 {
 	if (!V_IsPolyRenderer())
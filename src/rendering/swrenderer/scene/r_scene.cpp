@@ -66,7 +66,8 @@ void PeekThreadedErrorPane();
 EXTERN_CVAR(Int, r_clearbuffer)
 EXTERN_CVAR(Int, r_debug_draw)
 
-CVAR(Int, r_scene_multithreaded, 0, 0);
+CVAR(Int, r_scene_multithreaded, 1, 0);
+CVAR(Int, r_scene_slices, 4, 0);	// column ranges per thread
 CVAR(Bool, r_models, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 
 bool r_modelscene = false;
@@ -78,6 +79,8 @@ namespace swrenderer
 	RenderScene::RenderScene()
 	{
 		Threads.push_back(std::unique_ptr<RenderThread>(new RenderThread(this)));
+		SliceViewport.reset(new RenderViewport());
+		SliceLight.reset(new LightVisibility());
 	}
 
 	RenderScene::~RenderScene()
@@ -217,13 +220,10 @@ namespace swrenderer
 
 		// Setup threads:
 		std::unique_lock<std::mutex> start_lock(start_mutex);
-		for (int i = 0; i < numThreads; i++)
-		{
-			*Threads[i]->Viewport = *MainThread()->Viewport;
-			*Threads[i]->Light = *MainThread()->Light;
-			Threads[i]->X1 = viewwidth * i / numThreads;
-			Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
-		}
+		*SliceViewport = *MainThread()->Viewport;
+		*SliceLight = *MainThread()->Light;
+		UpdateSlices(numThreads > 1 ? numThreads * MAX<int>(*r_scene_slices, 1) : 1);
+		NextSlice = 0;
 		run_id++;
 		start_lock.unlock();
 
@@ -234,7 +234,7 @@ namespace swrenderer
 		}
 
 		// Do the main thread ourselves:
-		RenderThreadSlice(MainThread());
+		RenderSlices(MainThread());
 
 		// Wait for everyone to finish:
 		if (Threads.size() > 1)
@@ -259,10 +259,85 @@ namespace swrenderer
 		MainThread()->X2 = viewwidth;
 	}
 
-	void RenderScene::RenderThreadSlice(RenderThread *thread)
+	// Places the slice boundaries so that each slice should take about the same time,
+	// assuming the cost of a column is what its slice took last frame divided by its width.
+	void RenderScene::UpdateSlices(int numSlices)
+	{
+		double total = 0.0;
+		for (double t : SliceTime)
+			total += t;
+
+		if ((int)SliceTime.size() != numSlices || SliceX.back() != viewwidth || total <= 0.0 || numSlices > viewwidth)
+		{
+			SliceX.resize(numSlices + 1);
+			for (int i = 0; i <= numSlices; i++)
+				SliceX[i] = viewwidth * i / numSlices;
+			SliceTime.assign(numSlices, 0.0);
+			return;
+		}
+
+		// Every column gets a bit of the average on top, so that empty parts of the view still get split
+		// and a slice that got cheap in one frame does not become the whole screen in the next.
+		double floor = total / viewwidth * 0.1;
+		total += floor * viewwidth;
+
+		std::vector<int> x(numSlices + 1);
+		x[0] = 0;
+		x[numSlices] = viewwidth;
+		double cost = 0.0;
+		int slice = 1;
+		int old = 0;
+		for (int col = 0; col < viewwidth && slice < numSlices; col++)
+		{
+			while (col >= SliceX[old + 1])
+				old++;
+			cost += SliceTime[old] / (SliceX[old + 1] - SliceX[old]) + floor;
+			if (cost >= total * slice / numSlices)
+			{
+				// Every slice needs at least one column
+				x[slice] = clamp(col + 1, x[slice - 1] + 1, viewwidth - (numSlices - slice));
+				slice++;
+			}
+		}
+		for (; slice < numSlices; slice++)
+			x[slice] = viewwidth - (numSlices - slice);
+
+		SliceX = x;
+		SliceTime.assign(numSlices, 0.0);
+	}
+
+	void RenderScene::RenderSlices(RenderThread *thread)
 	{
+		// All slices done by a thread go into its one draw queue and are run together afterwards,
+		// because the drawers keep hold of the queue and the frame memory is in use until then.
 		thread->DrawQueue->Clear();
 		thread->FrameMemory->Clear();
+
+		if (r_modelscene && thread->MainThread)
+			PolyTriangleDrawer::ClearStencil(MainThread()->DrawQueue, 0);
+
+		int numSlices = (int)SliceTime.size();
+		while (true)
+		{
+			int slice = NextSlice++;
+			if (slice >= numSlices)
+				break;
+
+			auto start = std::chrono::steady_clock::now();
+			RenderThreadSlice(thread, slice);
+			SliceTime[slice] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		DrawerThreads::Execute(thread->DrawQueue);
+	}
+
+	void RenderScene::RenderThreadSlice(RenderThread *thread, int slice)
+	{
+		*thread->Viewport = *SliceViewport;
+		*thread->Light = *SliceLight;
+		thread->X1 = SliceX[slice];
+		thread->X2 = SliceX[slice + 1];
+
 		thread->Clip3D->Cleanup();
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
 		thread->Portal->CopyStackedViewParameters();
@@ -274,9 +349,6 @@ namespace swrenderer
 		thread->OpaquePass->ResetFakingUnderwater(); // [RH] Hack to make windows into underwater areas possible
 		thread->Portal->SetMainPortal();
 
-		if (r_modelscene && thread->MainThread)
-			PolyTriangleDrawer::ClearStencil(MainThread()->DrawQueue, 0);
-
 		PolyTriangleDrawer::SetViewport(thread->DrawQueue, viewwindowx, viewwindowy, viewwidth, viewheight, thread->Viewport->RenderTarget);
 
 		// Cull things outside the range seen by this thread
@@ -307,8 +379,6 @@ namespace swrenderer
 			if (thread->MainThread)
 				NetUpdate();
 		}
-
-		DrawerThreads::Execute(thread->DrawQueue);
 	}
 
 	void RenderScene::StartThreads(size_t numThreads)
@@ -331,7 +401,7 @@ namespace swrenderer
 					last_run_id = run_id;
 					start_lock.unlock();
 
-					RenderThreadSlice(renderthread);
+					RenderSlices(renderthread);
 
 					// Notify main thread that we finished:
 					std::unique_lock<std::mutex> end_lock(end_mutex);
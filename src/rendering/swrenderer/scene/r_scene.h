@@ -27,6 +27,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include "r_defs.h"
 #include "d_player.h"
 
@@ -37,6 +38,8 @@ namespace swrenderer
 	extern cycle_t WallCycles, PlaneCycles, MaskedCycles, DrawerWaitCycles;
 
 	class RenderThread;
+	class RenderViewport;
+	class LightVisibility;
 	
 	class RenderScene
 	{
@@ -58,7 +61,9 @@ namespace swrenderer
 	private:
 		void RenderActorView(AActor *actor,bool renderplayersprite, bool dontmaplines);
 		void RenderThreadSlices();
-		void RenderThreadSlice(RenderThread *thread);
+		void UpdateSlices(int numSlices);
+		void RenderSlices(RenderThread *thread);
+		void RenderThreadSlice(RenderThread *thread, int slice);
 		void RenderPSprites();
 
 		void StartThreads(size_t numThreads);
@@ -75,5 +80,14 @@ namespace swrenderer
 		std::mutex end_mutex;
 		std::condition_variable end_condition;
 		size_t finished_threads = 0;
+
+		// The view is cut into more column ranges than there are threads, and each
+		// thread takes the next one when it is done with its last. The ranges are
+		// sized from how long each one took in the previous frame.
+		std::vector<int> SliceX;
+		std::vector<double> SliceTime;
+		std::atomic<int> NextSlice;
+		std::unique_ptr<RenderViewport> SliceViewport;
+		std::unique_ptr<LightVisibility> SliceLight;
 	};
 }
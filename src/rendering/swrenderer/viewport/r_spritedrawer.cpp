@@ -539,4 +539,12 @@ namespace swrenderer
 		dc_dest_y = y;
 		dc_viewport = viewport;
 	}
+
+	// Raw column pixels, used by the drawer benchmark
+	void SpriteDrawerArgs::SetTexture(const uint8_t *pixels, const uint8_t *pixels2, int height)
+	{
+		dc_source = pixels;
+		dc_source2 = pixels2;
+		dc_textureheight = height;
+	}
 }
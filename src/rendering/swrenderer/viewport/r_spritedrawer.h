@@ -32,6 +32,10 @@ namespace swrenderer
 		void SetCount(int count) { dc_count = count; }
 		void SetSolidColor(int color) { dc_color = color; dc_color_bgra = GPalette.BaseColors[color]; }
 		void SetDynamicLight(uint32_t color) { dynlightcolor = color; }
+		void SetTexture(const uint8_t *pixels, const uint8_t *pixels2, int height);
+		void SetTextureUPos(uint32_t texturefracx) { dc_texturefracx = texturefracx; }
+		void SetTextureVPos(fixed_t texturefrac) { dc_texturefrac = texturefrac; }
+		void SetTextureVStep(fixed_t iscale) { dc_iscale = iscale; }
 
 		void DrawMaskedColumn(RenderThread *thread, int x, fixed_t iscale, FSoftwareTexture *texture, fixed_t column, double spryscale, double sprtopscreen, bool sprflipvert, const short *mfloorclip, const short *mceilingclip, FRenderStyle style, bool unmasked = false);
 		void FillColumn(RenderThread *thread);
@@ -200,6 +200,13 @@ struct ExpVal
 		return Type == TypeString ? *(FString *)&pointer : Type == TypeName ? FString(FName(ENamedName(Int)).GetChars()) : "";
 	}
 
+	// Unlike GetString this never shares the string's buffer, so the
+	// result may be used on another thread than the one owning this value.
+	FString GetStringCopy() const
+	{
+		return Type == TypeString ? FString(((FString *)&pointer)->GetChars(), ((FString *)&pointer)->Len()) : GetString();
+	}
+
 	bool GetBool() const
 	{
 		int regtype = Type->GetRegType();
@@ -547,7 +554,7 @@ public:
 		return true;
 	}
 
-	ExpVal GetValue() const
+	const ExpVal &GetValue() const
 	{
 		return value;
 	}
@@ -1382,6 +1389,7 @@ public:
 	FxCVar(FBaseCVar*, const FScriptPosition&);
 	FxExpression *Resolve(FCompileContext&);
 	ExpEmit Emit(VMFunctionBuilder *build);
+	static void *ValueAddress(FBaseCVar *cvar);
 };
 
 
@@ -1517,6 +1525,7 @@ public:
 	FxExpression *Array;
 	FxExpression *index;
 	size_t SizeAddr;
+	PField *SizeField = nullptr;	// reads the size at SizeAddr. Created here because Emit may run on a worker thread.
 	bool AddressRequested;
 	bool AddressWritable;
 	bool arrayispointer = false;
@@ -0,0 +1,601 @@
+//-----------------------------------------------------------------------------
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// Cache for the code generated from scripts
+//
+// The compiler still parses and resolves everything, because that is what
+// creates the classes, types and symbols, but functions found in the cache
+// skip code generation. The cache is only used if it was written by the
+// same engine build from the same lump directory, the same contents of all
+// lumps that were parsed as scripts, and the same name table. The contents
+// are compared by the CRCs FScanner takes when it opens them, so checking
+// the cache reads nothing but the cache file itself. Otherwise,
+// or if an entry does not belong to the function at its index, the
+// function gets compiled as usual.
+//
+// Address constants are stored as references to the objects they point to
+// and looked up again on load. Functions with an address constant that is
+// not one of the kinds below are not cached.
+//
+// File layout:
+//   "ZSCC", version, key, number of functions
+//   for each function: offset, size and CRC of its entry (size 0: none)
+//   the entries
+//
+//-----------------------------------------------------------------------------
+
+#include <zlib.h>
+#include <algorithm>
+#include "scriptcache.h"
+#include "vmbuilder.h"
+#include "codegen.h"
+#include "info.h"
+#include "autosegs.h"
+#include "w_wad.h"
+#include "sc_man.h"
+#include "md5.h"
+#include "m_misc.h"
+#include "m_random.h"
+#include "c_cvars.h"
+#include "version.h"
+
+CVAR(Bool, vm_cachescripts, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+EXTERN_CVAR(Bool, vm_jit)
+
+enum
+{
+	SCRIPTCACHE_VERSION = 1,
+	SCRIPTCACHE_HEADER = 28,
+	SMALLEST_ADDRESS = 0x10000,	// Anything below is an offset the code generator stored as a pointer.
+};
+
+enum
+{
+	AK_Value,		// value
+	AK_Class,		// index in PClass::AllClasses, name
+	AK_State,		// index in PClassActor::AllActorClasses, state index, class name
+	AK_Function,	// index in VMFunction::AllFunctions, name
+	AK_RNG,			// name CRC
+	AK_CVar,		// name
+	AK_Global,		// offset, name of native global
+	AK_Blob,		// size, data
+};
+
+static FString ScriptCachePath(bool create)
+{
+	FString path = M_GetCachePath(create);
+	path << "/scripts.zsc";
+	return path;
+}
+
+//==========================================================================
+//
+// Reads from an entry. Every read is checked against the end, so a
+// damaged entry only makes the reads fail.
+//
+//==========================================================================
+
+struct FCacheReader
+{
+	const uint8_t *Pos;
+	const uint8_t *End;
+	bool Ok = true;
+
+	const uint8_t *Read(size_t size)
+	{
+		if ((size_t)(End - Pos) < size)
+		{
+			Ok = false;
+			return nullptr;
+		}
+		auto data = Pos;
+		Pos += size;
+		return data;
+	}
+
+	uint32_t ReadInt()
+	{
+		uint32_t value = 0;
+		auto data = Read(4);
+		if (data != nullptr) memcpy(&value, data, 4);
+		return value;
+	}
+
+	bool ReadString(const char *compare)
+	{
+		uint32_t len = ReadInt();
+		auto data = Read(len);
+		return data != nullptr && strlen(compare) == len && memcmp(data, compare, len) == 0;
+	}
+
+	FString ReadString()
+	{
+		uint32_t len = ReadInt();
+		auto data = Read(len);
+		return data != nullptr ? FString((const char *)data, len) : FString();
+	}
+};
+
+//==========================================================================
+//
+// Computes the key and opens the cache file if it has the same.
+//
+//==========================================================================
+
+FScriptCache::FScriptCache(unsigned numfunctions)
+{
+	NumFunctions = numfunctions;
+	Entries.Resize(numfunctions);
+	EntrySizes.Resize(numfunctions);
+	EntryCRCs.Resize(numfunctions);
+	NewEntries.Resize(numfunctions);
+	for (auto &entry : Entries) entry = nullptr;
+
+	MD5Context md5;
+	auto addString = [&](const char *string) { md5.Update((const uint8_t *)string, (unsigned)strlen(string) + 1); };
+	auto addInt = [&](uint32_t value) { md5.Update((const uint8_t *)&value, 4); };
+
+	addString(GetVersionString());
+	addString(GetGitHash());
+	addString(GetGitTime());
+	addInt(sizeof(void *));
+	addInt(vm_jit);		// changes the code generated for calls.
+	addInt(numfunctions);
+
+	for (int i = 0; i < Wads.GetNumWads(); i++)
+	{
+		addString(Wads.GetWadFullName(i));
+	}
+	for (int i = 0; i < Wads.GetNumLumps(); i++)
+	{
+		addString(Wads.GetLumpFullName(i));
+		addInt(Wads.LumpLength(i));
+		addInt(Wads.GetLumpNamespace(i));
+		addInt(Wads.GetLumpFile(i));
+	}
+
+	// The sort keeps the key independent of the order the parsers open their lumps in.
+	TArray<FScanner::FOpenedLump> lumps = FScanner::OpenedLumps;
+	std::sort(lumps.begin(), lumps.end(), [](const FScanner::FOpenedLump &a, const FScanner::FOpenedLump &b) { return a.Lump < b.Lump; });
+	for (unsigned i = 0; i < lumps.Size(); i++)
+	{
+		if (i > 0 && lumps[i].Lump == lumps[i - 1].Lump) continue;
+		addInt(lumps[i].Lump);
+		addInt(lumps[i].Length);
+		addInt(lumps[i].CRC);
+	}
+
+	// Name constants are stored as indices, so the indices of all names that exist already must be the same.
+	for (int i = 0; FName(ENamedName(i)).IsValidName(); i++)
+	{
+		addString(FName(ENamedName(i)).GetChars());
+	}
+	md5.Final(Key);
+
+	if (File.OpenMappedFile(ScriptCachePath(false)))
+	{
+		auto data = (const uint8_t *)File.GetBuffer();
+		size_t length = (size_t)File.GetLength();
+		uint32_t header[2];
+		if (length >= SCRIPTCACHE_HEADER)
+		{
+			memcpy(header, data + 4, 4);
+			memcpy(header + 1, data + 24, 4);
+		}
+		if (length < SCRIPTCACHE_HEADER || memcmp(data, "ZSCC", 4) || header[0] != SCRIPTCACHE_VERSION || memcmp(data + 8, Key, 16) ||
+			header[1] != numfunctions || (length - SCRIPTCACHE_HEADER) / 12 < numfunctions)
+		{
+			File.Close();
+		}
+		else
+		{
+			const uint8_t *table = data + SCRIPTCACHE_HEADER;
+			for (unsigned i = 0; i < numfunctions; i++)
+			{
+				uint32_t entry[3];
+				memcpy(entry, table + i * 12, 12);
+				if (entry[1] > 0 && entry[0] <= length && entry[1] <= length - entry[0])
+				{
+					Entries[i] = data + entry[0];
+					EntrySizes[i] = entry[1];
+					EntryCRCs[i] = entry[2];
+				}
+			}
+			Valid = true;
+		}
+	}
+
+	// Everything the code generator may store in an address constant that can be found again by some name or index.
+	for (unsigned i = 0; i < PClass::AllClasses.Size(); i++)
+	{
+		Addresses.Insert(PClass::AllClasses[i], { AK_Class, i, 0, PClass::AllClasses[i]->TypeName.GetChars() });
+	}
+	for (unsigned i = 0; i < PClassActor::AllActorClasses.Size(); i++)
+	{
+		auto cls = PClassActor::AllActorClasses[i];
+		for (unsigned j = 0; j < cls->GetStateCount(); j++)
+		{
+			Addresses.Insert(cls->GetStates() + j, { AK_State, i, j, cls->TypeName.GetChars() });
+		}
+	}
+	for (unsigned i = 0; i < VMFunction::AllFunctions.Size(); i++)
+	{
+		Addresses.Insert(VMFunction::AllFunctions[i], { AK_Function, i, 0, VMFunction::AllFunctions[i]->PrintableName.GetChars() });
+	}
+	for (FBaseCVar *cvar = CVars; cvar != nullptr; cvar = cvar->GetNext())
+	{
+		void *addr = FxCVar::ValueAddress(cvar);
+		if (addr != nullptr && Addresses.CheckKey(addr) == nullptr)
+		{
+			Addresses.Insert(addr, { AK_CVar, 0, 0, cvar->GetName() });
+		}
+	}
+
+	FAutoSegIterator probe(FRegHead, FRegTail);
+	while (*++probe != nullptr)
+	{
+		auto field = (const FieldDesc *)*probe;
+		if (field->ClassName[0] == 0) Globals.Push(field);
+	}
+	std::sort(Globals.begin(), Globals.end(), [](const FieldDesc *a, const FieldDesc *b) { return a->FieldOffset < b->FieldOffset; });
+}
+
+//==========================================================================
+//
+// Fills in the function from its cache entry. Returns false if there is
+// none or it does not fit the function anymore.
+//
+//==========================================================================
+
+bool FScriptCache::Load(unsigned index, const char *name, VMScriptFunction *func)
+{
+	if (!Valid || Entries[index] == nullptr) return false;
+
+	// Unless the entry can be used it is dropped from the cache.
+	auto entry = Entries[index];
+	Entries[index] = nullptr;
+
+	FCacheReader rd = { entry, entry + EntrySizes[index] };
+	if (crc32(0, entry, EntrySizes[index]) != EntryCRCs[index]) return false;
+
+	if (!rd.ReadString(name) || rd.ReadInt() != (uint32_t)func->ExtraSpace || rd.ReadInt() != func->SpecialInits.Size()) return false;
+
+	unsigned codesize = rd.ReadInt();
+	unsigned linecount = rd.ReadInt();
+	unsigned numkonstd = rd.ReadInt();
+	unsigned numkonstf = rd.ReadInt();
+	unsigned numkonsts = rd.ReadInt();
+	unsigned numkonsta = rd.ReadInt();
+	auto regs = rd.Read(4);
+	unsigned maxparam = rd.ReadInt();
+	if (!rd.Ok || codesize == 0 || codesize > 0x1000000 || linecount > 65535 || numkonstd > 65535 ||
+		numkonstf > 65535 || numkonsts > 65535 || numkonsta > 65535 || maxparam > 65535)
+	{
+		return false;
+	}
+
+	auto code = rd.Read(codesize * sizeof(VMOP));
+	auto lines = rd.Read(linecount * sizeof(FStatementInfo));
+	auto konstd = rd.Read(numkonstd * sizeof(int));
+	auto konstf = rd.Read(numkonstf * sizeof(double));
+
+	TArray<FString> konsts(numkonsts, true);
+	for (auto &str : konsts)
+	{
+		str = rd.ReadString();
+	}
+
+	TArray<void *> konsta(numkonsta, true);
+	TArray<std::pair<const uint8_t *, unsigned>> blobs(numkonsta, true);
+	for (unsigned i = 0; i < numkonsta && rd.Ok; i++)
+	{
+		auto kind = rd.Read(1);
+		if (kind == nullptr) break;
+
+		void *ptr = nullptr;
+		blobs[i] = { nullptr, 0 };
+		switch (*kind)
+		{
+		case AK_Value:
+			ptr = (void *)(uintptr_t)rd.ReadInt();
+			break;
+
+		case AK_Class:
+		{
+			unsigned cls = rd.ReadInt();
+			if (cls >= PClass::AllClasses.Size() || !rd.ReadString(PClass::AllClasses[cls]->TypeName.GetChars())) return false;
+			ptr = PClass::AllClasses[cls];
+			break;
+		}
+
+		case AK_State:
+		{
+			unsigned cls = rd.ReadInt();
+			unsigned state = rd.ReadInt();
+			if (cls >= PClassActor::AllActorClasses.Size()) return false;
+			auto actor = PClassActor::AllActorClasses[cls];
+			if (!rd.ReadString(actor->TypeName.GetChars()) || state >= actor->GetStateCount()) return false;
+			ptr = actor->GetStates() + state;
+			break;
+		}
+
+		case AK_Function:
+		{
+			unsigned vmfunc = rd.ReadInt();
+			if (vmfunc >= VMFunction::AllFunctions.Size() || !rd.ReadString(VMFunction::AllFunctions[vmfunc]->PrintableName.GetChars())) return false;
+			ptr = VMFunction::AllFunctions[vmfunc];
+			break;
+		}
+
+		case AK_RNG:
+			ptr = FRandom::StaticFindRNGByCRC(rd.ReadInt());
+			if (ptr == nullptr) return false;
+			break;
+
+		case AK_CVar:
+		{
+			FBaseCVar *cvar = FindCVar(rd.ReadString(), nullptr);
+			if (cvar == nullptr || (ptr = FxCVar::ValueAddress(cvar)) == nullptr) return false;
+			break;
+		}
+
+		case AK_Global:
+		{
+			unsigned offset = rd.ReadInt();
+			FString global = rd.ReadString();
+			auto field = std::find_if(Globals.begin(), Globals.end(), [&](const FieldDesc *f) { return global.Compare(f->FieldName) == 0; });
+			if (field == Globals.end() || offset >= (*field)->FieldSize) return false;
+			ptr = (uint8_t *)(*field)->FieldOffset + offset;
+			break;
+		}
+
+		case AK_Blob:
+		{
+			unsigned size = rd.ReadInt();
+			blobs[i] = { rd.Read(size), size };
+			if (blobs[i].first == nullptr) return false;
+			break;
+		}
+
+		default:
+			return false;
+		}
+		konsta[i] = ptr;
+	}
+	if (!rd.Ok || rd.Pos != rd.End) return false;
+
+	{
+		std::lock_guard<std::mutex> lock(ClassDataMutex);
+		func->Alloc(codesize, numkonstd, numkonstf, numkonsts, numkonsta, linecount);
+		for (unsigned i = 0; i < numkonsta; i++)
+		{
+			if (blobs[i].first != nullptr) konsta[i] = ClassDataAllocator.Alloc(blobs[i].second);
+		}
+	}
+
+	memcpy(func->Code, code, codesize * sizeof(VMOP));
+	if (linecount > 0) memcpy(func->LineInfo, lines, linecount * sizeof(FStatementInfo));
+	if (numkonstd > 0) memcpy(func->KonstD, konstd, numkonstd * sizeof(int));
+	if (numkonstf > 0) memcpy(func->KonstF, konstf, numkonstf * sizeof(double));
+	for (unsigned i = 0; i < numkonsts; i++)
+	{
+		func->KonstS[i] = konsts[i];
+	}
+	for (unsigned i = 0; i < numkonsta; i++)
+	{
+		if (blobs[i].first != nullptr) memcpy(konsta[i], blobs[i].first, blobs[i].second);
+		func->KonstA[i].v = konsta[i];
+	}
+
+	func->NumRegD = regs[0];
+	func->NumRegF = regs[1];
+	func->NumRegS = regs[2];
+	func->NumRegA = regs[3];
+	func->MaxParam = maxparam;
+	func->StackSize = VMFrame::FrameSize(func->NumRegD, func->NumRegF, func->NumRegS, func->NumRegA, func->MaxParam, func->ExtraSpace);
+	Entries[index] = entry;
+	LoadCount++;
+	return true;
+}
+
+//==========================================================================
+//
+// Writes a reference to what an address constant points to, or returns
+// false if it cannot be identified.
+//
+//==========================================================================
+
+bool FScriptCache::WriteAddress(TArray<uint8_t> &out, void *ptr, VMFunctionBuilder *build)
+{
+	auto put = [&](const void *data, unsigned size)
+	{
+		if (size == 0) return;
+		unsigned pos = out.Reserve(size);
+		memcpy(&out[pos], data, size);
+	};
+	auto putInt = [&](uint32_t value) { put(&value, 4); };
+	auto putString = [&](const char *string)
+	{
+		unsigned len = (unsigned)strlen(string);
+		putInt(len);
+		put(string, len);
+	};
+
+	if ((uintptr_t)ptr < SMALLEST_ADDRESS)
+	{
+		out.Push(AK_Value);
+		putInt((uint32_t)(uintptr_t)ptr);
+		return true;
+	}
+	if (unsigned size = build->GetBlobSize(ptr))
+	{
+		out.Push(AK_Blob);
+		putInt(size);
+		put(ptr, size);
+		return true;
+	}
+	if (auto ref = Addresses.CheckKey(ptr))
+	{
+		out.Push(ref->Kind);
+		if (ref->Kind != AK_CVar)
+		{
+			putInt(ref->Index);
+			if (ref->Kind == AK_State) putInt(ref->SubIndex);
+		}
+		putString(ref->Name);
+		return true;
+	}
+	if (uint32_t crc = FRandom::StaticGetRNGCRC(static_cast<FRandom *>(ptr)))
+	{
+		out.Push(AK_RNG);
+		putInt(crc);
+		return true;
+	}
+
+	// Native globals, and their members if the code generator folded the member's offset into the address.
+	auto next = std::upper_bound(Globals.begin(), Globals.end(), (size_t)ptr, [](size_t addr, const FieldDesc *f) { return addr < f->FieldOffset; });
+	if (next != Globals.begin())
+	{
+		auto field = *(next - 1);
+		size_t offset = (size_t)ptr - field->FieldOffset;
+		if (offset < field->FieldSize)
+		{
+			out.Push(AK_Global);
+			putInt((uint32_t)offset);
+			putString(field->FieldName);
+			return true;
+		}
+	}
+	return false;
+}
+
+//==========================================================================
+//
+// Adds a freshly generated function to the cache, unless it references
+// something that cannot be stored.
+//
+//==========================================================================
+
+void FScriptCache::Store(unsigned index, const char *name, VMScriptFunction *func, VMFunctionBuilder *build)
+{
+	TArray<uint8_t> out;
+	auto put = [&](const void *data, unsigned size)
+	{
+		if (size == 0) return;
+		unsigned pos = out.Reserve(size);
+		memcpy(&out[pos], data, size);
+	};
+	auto putInt = [&](uint32_t value) { put(&value, 4); };
+
+	unsigned len = (unsigned)strlen(name);
+	putInt(len);
+	put(name, len);
+	putInt(func->ExtraSpace);
+	putInt(func->SpecialInits.Size());
+	putInt(func->CodeSize);
+	putInt(func->LineInfoCount);
+	putInt(func->NumKonstD);
+	putInt(func->NumKonstF);
+	putInt(func->NumKonstS);
+	putInt(func->NumKonstA);
+	uint8_t regs[4] = { func->NumRegD, func->NumRegF, func->NumRegS, func->NumRegA };
+	put(regs, 4);
+	putInt(func->MaxParam);
+
+	put(func->Code, func->CodeSize * sizeof(VMOP));
+	put(func->LineInfo, func->LineInfoCount * sizeof(FStatementInfo));
+	put(func->KonstD, func->NumKonstD * sizeof(int));
+	put(func->KonstF, func->NumKonstF * sizeof(double));
+	for (unsigned i = 0; i < func->NumKonstS; i++)
+	{
+		putInt(func->KonstS[i].Len());
+		put(func->KonstS[i].GetChars(), (unsigned)func->KonstS[i].Len());
+	}
+	for (unsigned i = 0; i < func->NumKonstA; i++)
+	{
+		if (!WriteAddress(out, func->KonstA[i].v, build)) return;
+	}
+	NewEntries[index] = std::move(out);
+}
+
+//==========================================================================
+//
+// Writes the cache file if any function had to be compiled.
+//
+//==========================================================================
+
+void FScriptCache::Write()
+{
+	unsigned loaded = LoadCount;
+	DPrintf(DMSG_NOTIFY, "%u of %u script functions loaded from the cache\n", loaded, NumFunctions);
+
+	bool changed = !Valid;
+	for (auto &entry : NewEntries)
+	{
+		if (entry.Size() > 0) changed = true;
+	}
+	if (!changed) return;
+
+	TArray<uint8_t> out(SCRIPTCACHE_HEADER + NumFunctions * 12, true);
+	memcpy(&out[0], "ZSCC", 4);
+	uint32_t header[2] = { SCRIPTCACHE_VERSION, NumFunctions };
+	memcpy(&out[4], &header[0], 4);
+	memcpy(&out[8], Key, 16);
+	memcpy(&out[24], &header[1], 4);
+
+	for (unsigned i = 0; i < NumFunctions; i++)
+	{
+		// Entries that were loaded are still good, so they are copied from the old file.
+		const uint8_t *data = nullptr;
+		uint32_t size = 0;
+		if (NewEntries[i].Size() > 0)
+		{
+			data = NewEntries[i].Data();
+			size = NewEntries[i].Size();
+		}
+		else if (Entries[i] != nullptr)
+		{
+			data = Entries[i];
+			size = EntrySizes[i];
+		}
+		uint32_t entry[3] = { size > 0 ? out.Size() : 0, size, size > 0 ? (uint32_t)crc32(0, data, size) : 0 };
+		memcpy(&out[SCRIPTCACHE_HEADER + i * 12], entry, 12);
+		if (size > 0)
+		{
+			unsigned pos = out.Reserve(size);
+			memcpy(&out[pos], data, size);
+		}
+	}
+
+	// The old file may still be mapped.
+	File.Close();
+
+	FString path = ScriptCachePath(true);
+	FileWriter *fw = FileWriter::Open(path);
+	if (fw != nullptr)
+	{
+		if (fw->Write(out.Data(), out.Size()) != out.Size())
+		{
+			Printf("Error saving script cache to file %s\n", path.GetChars());
+		}
+		delete fw;
+	}
+	else
+	{
+		Printf("Cannot open script cache file %s for writing\n", path.GetChars());
+	}
+}
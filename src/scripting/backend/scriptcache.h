@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include "tarray.h"
+#include "files.h"
+
+class VMScriptFunction;
+class VMFunctionBuilder;
+struct FieldDesc;
+
+//==========================================================================
+//
+// Keeps the code generated for script functions between runs, see
+// scriptcache.cpp. Load and Store may be called from the code generation
+// threads, but for different functions only.
+//
+//==========================================================================
+
+class FScriptCache
+{
+public:
+	FScriptCache(unsigned numfunctions);
+	bool Load(unsigned index, const char *name, VMScriptFunction *func);
+	void Store(unsigned index, const char *name, VMScriptFunction *func, VMFunctionBuilder *build);
+	void Write();
+
+private:
+	struct FAddressRef
+	{
+		uint8_t Kind;
+		uint32_t Index;
+		uint32_t SubIndex;
+		const char *Name;
+	};
+
+	bool WriteAddress(TArray<uint8_t> &out, void *ptr, VMFunctionBuilder *build);
+
+	uint8_t Key[16];
+	FileReader File;
+	bool Valid = false;
+	TArray<const uint8_t *> Entries;
+	TArray<uint32_t> EntrySizes;
+	TArray<uint32_t> EntryCRCs;
+	TArray<TArray<uint8_t>> NewEntries;
+	TMap<void *, FAddressRef> Addresses;
+	TArray<const FieldDesc *> Globals;
+	std::atomic<unsigned> LoadCount = { 0 };
+	unsigned NumFunctions;
+};
@@ -32,10 +32,14 @@
 **
 */
 
+#include <mutex>
 #include "vmbuilder.h"
 #include "codegen.h"
 #include "m_argv.h"
 #include "c_cvars.h"
+#include "workerpool.h"
+#include "scriptcache.h"
+#include "i_time.h"
 #include "scripting/vm/jit.h"
 
 struct VMRemap
@@ -50,6 +54,10 @@ VMRemap opRemap[NUM_OPS] = {
 };
 #undef xx
 
+std::mutex ClassDataMutex;
+
+EXTERN_CVAR(Bool, vm_cachescripts)
+
 //==========================================================================
 //
 // VMFunctionBuilder - Constructor
@@ -109,7 +117,10 @@ void VMFunctionBuilder::EndStatement()
 
 void VMFunctionBuilder::MakeFunction(VMScriptFunction *func)
 {
-	func->Alloc(Code.Size(), IntConstantList.Size(), FloatConstantList.Size(), StringConstantList.Size(), AddressConstantList.Size(), LineNumbers.Size());
+	{
+		std::lock_guard<std::mutex> lock(ClassDataMutex);
+		func->Alloc(Code.Size(), IntConstantList.Size(), FloatConstantList.Size(), StringConstantList.Size(), AddressConstantList.Size(), LineNumbers.Size());
+	}
 
 	// Copy code block.
 	memcpy(func->Code, &Code[0], Code.Size() * sizeof(VMOP));
@@ -245,10 +256,12 @@ unsigned VMFunctionBuilder::GetConstantFloat(double val)
 // VMFunctionBuilder :: GetConstantString
 //
 // Returns a constant register initialized with the given value.
+// The string is copied instead of shared, because the source may be
+// accessed by other threads while functions are being emitted.
 //
 //==========================================================================
 
-unsigned VMFunctionBuilder::GetConstantString(FString val)
+unsigned VMFunctionBuilder::GetConstantString(const FString &val)
 {
 	unsigned *locp = StringConstantMap.CheckKey(val);
 	if (locp != NULL)
@@ -257,8 +270,9 @@ unsigned VMFunctionBuilder::GetConstantString(FString val)
 	}
 	else
 	{
-		unsigned loc = StringConstantList.Push(val);
-		StringConstantMap.Insert(val, loc);
+		FString copy(val.GetChars(), val.Len());
+		unsigned loc = StringConstantList.Push(copy);
+		StringConstantMap.Insert(copy, loc);
 		return loc;
 	}
 }
@@ -287,6 +301,42 @@ unsigned VMFunctionBuilder::GetConstantAddress(void *ptr)
 	}
 }
 
+//==========================================================================
+//
+// VMFunctionBuilder :: GetConstantBlob
+//
+// Returns a constant register pointing to a copy of the given data. The
+// copy lives as long as the function.
+//
+//==========================================================================
+
+unsigned VMFunctionBuilder::GetConstantBlob(const void *data, unsigned size)
+{
+	void *blob;
+	{
+		std::lock_guard<std::mutex> lock(ClassDataMutex);
+		blob = ClassDataAllocator.Alloc(size);
+	}
+	memcpy(blob, data, size);
+	BlobSizes.Insert(blob, size);
+	return GetConstantAddress(blob);
+}
+
+//==========================================================================
+//
+// VMFunctionBuilder :: GetBlobSize
+//
+// Returns the size of a constant created by GetConstantBlob, or 0 if the
+// pointer is something else.
+//
+//==========================================================================
+
+unsigned VMFunctionBuilder::GetBlobSize(void *ptr)
+{
+	unsigned *size = BlobSizes.CheckKey(ptr);
+	return size != nullptr ? *size : 0;
+}
+
 //==========================================================================
 //
 // VMFunctionBuilder :: AllocConstants*
@@ -333,8 +383,8 @@ unsigned VMFunctionBuilder::AllocConstantsString(unsigned count, FString *ptrs)
 	unsigned addr = StringConstantList.Reserve(count);
 	for (unsigned i = 0; i < count; i++)
 	{
-		StringConstantList[addr + i] = ptrs[i];
-		StringConstantMap.Insert(ptrs[i], addr + i);
+		StringConstantList[addr + i] = FString(ptrs[i].GetChars(), ptrs[i].Len());
+		StringConstantMap.Insert(StringConstantList[addr + i], addr + i);
 	}
 	return addr;
 }
@@ -803,118 +853,262 @@ VMFunction *FFunctionBuildList::AddFunction(PNamespace *gnspc, const VersionInfo
 }
 
 
-void FFunctionBuildList::Build()
+//==========================================================================
+//
+// FFunctionBuildList :: Resolve
+//
+// Resolves an item's code and sets up its arguments' registers. Returns
+// nullptr if there is nothing to emit. This may create new types and
+// symbols so it always runs on the main thread.
+//
+//==========================================================================
+
+VMFunctionBuilder *FFunctionBuildList::Resolve(Item &item)
 {
-	int codesize = 0;
-	int datasize = 0;
-	FILE *dump = nullptr;
+	assert(item.Code != NULL);
 
-	if (Args->CheckParm("-dumpdisasm")) dump = fopen("disasm.txt", "w");
+	// We don't know the return type in advance for anonymous functions.
+	FCompileContext ctx(item.CurGlobals, item.Func, item.Func->SymbolName == NAME_None ? nullptr : item.Func->Variants[0].Proto, item.FromDecorate, item.StateIndex, item.StateCount, item.Lump, item.Version);
 
-	for (auto &item : mItems)
+	// Allocate registers for the function's arguments and create local variable nodes before starting to resolve it.
+	auto buildit = new VMFunctionBuilder(item.Func->GetImplicitArgs());
+	for (unsigned i = 0; i < item.Func->Variants[0].Proto->ArgumentTypes.Size(); i++)
 	{
-		assert(item.Code != NULL);
+		auto type = item.Func->Variants[0].Proto->ArgumentTypes[i];
+		auto name = item.Func->Variants[0].ArgNames[i];
+		auto flags = item.Func->Variants[0].ArgFlags[i];
+		// this won't get resolved and won't get emitted. It is only needed so that the code generator can retrieve the necessary info about this argument to do its work.
+		auto local = new FxLocalVariableDeclaration(type, name, nullptr, flags, FScriptPosition());
+		if (!(flags & VARF_Out)) local->RegNum = buildit->Registers[type->GetRegType()].Get(type->GetRegCount());
+		else local->RegNum = buildit->Registers[REGT_POINTER].Get(1);
+		ctx.FunctionArgs.Push(local);
+	}
 
-		// We don't know the return type in advance for anonymous functions.
-		FCompileContext ctx(item.CurGlobals, item.Func, item.Func->SymbolName == NAME_None ? nullptr : item.Func->Variants[0].Proto, item.FromDecorate, item.StateIndex, item.StateCount, item.Lump, item.Version);
+	FScriptPosition::StrictErrors = !item.FromDecorate;
+	item.Code = item.Code->Resolve(ctx);
+	// If we need extra space, load the frame pointer into a register so that we do not have to call the wasteful LFP instruction more than once.
+	if (item.Function->ExtraSpace > 0)
+	{
+		buildit->FramePointer = ExpEmit(buildit, REGT_POINTER);
+		buildit->FramePointer.Fixed = true;
+		buildit->Emit(OP_LFP, buildit->FramePointer.RegNum);
+	}
 
-		// Allocate registers for the function's arguments and create local variable nodes before starting to resolve it.
-		VMFunctionBuilder buildit(item.Func->GetImplicitArgs());
-		for (unsigned i = 0; i < item.Func->Variants[0].Proto->ArgumentTypes.Size(); i++)
+	// Make sure resolving it didn't obliterate it.
+	if (item.Code != nullptr)
+	{
+		if (!item.Code->CheckReturn())
 		{
-			auto type = item.Func->Variants[0].Proto->ArgumentTypes[i];
-			auto name = item.Func->Variants[0].ArgNames[i];
-			auto flags = item.Func->Variants[0].ArgFlags[i];
-			// this won't get resolved and won't get emitted. It is only needed so that the code generator can retrieve the necessary info about this argument to do its work.
-			auto local = new FxLocalVariableDeclaration(type, name, nullptr, flags, FScriptPosition());
-			if (!(flags & VARF_Out)) local->RegNum = buildit.Registers[type->GetRegType()].Get(type->GetRegCount());
-			else local->RegNum = buildit.Registers[REGT_POINTER].Get(1);
-			ctx.FunctionArgs.Push(local);
+			auto newcmpd = new FxCompoundStatement(item.Code->ScriptPosition);
+			newcmpd->Add(item.Code);
+			newcmpd->Add(new FxReturnStatement(nullptr, item.Code->ScriptPosition));
+			item.Code = newcmpd->Resolve(ctx);
 		}
 
-		FScriptPosition::StrictErrors = !item.FromDecorate;
-		item.Code = item.Code->Resolve(ctx);
-		// If we need extra space, load the frame pointer into a register so that we do not have to call the wasteful LFP instruction more than once.
-		if (item.Function->ExtraSpace > 0)
+		item.Proto = ctx.ReturnProto;
+		if (item.Proto == nullptr)
 		{
-			buildit.FramePointer = ExpEmit(&buildit, REGT_POINTER);
-			buildit.FramePointer.Fixed = true;
-			buildit.Emit(OP_LFP, buildit.FramePointer.RegNum);
+			item.Code->ScriptPosition.Message(MSG_ERROR, "Function %s without prototype", item.PrintableName.GetChars());
+			delete buildit;
+			return nullptr;
 		}
 
-		// Make sure resolving it didn't obliterate it.
-		if (item.Code != nullptr)
+		// Generate prototype for anonymous functions.
+		VMScriptFunction *sfunc = item.Function;
+		// create a new prototype from the now known return type and the argument list of the function's template prototype.
+		if (sfunc->Proto == nullptr)
 		{
-			if (!item.Code->CheckReturn())
-			{
-				auto newcmpd = new FxCompoundStatement(item.Code->ScriptPosition);
-				newcmpd->Add(item.Code);
-				newcmpd->Add(new FxReturnStatement(nullptr, item.Code->ScriptPosition));
-				item.Code = newcmpd->Resolve(ctx);
-			}
+			sfunc->Proto = NewPrototype(item.Proto->ReturnTypes, item.Func->Variants[0].Proto->ArgumentTypes);
+			sfunc->ArgFlags = item.Func->Variants[0].ArgFlags;
+		}
+		item.Unsafe = ctx.Unsafe;
+		return buildit;
+	}
+	delete buildit;
+	return nullptr;
+}
 
-			item.Proto = ctx.ReturnProto;
-			if (item.Proto == nullptr)
-			{
-				item.Code->ScriptPosition.Message(MSG_ERROR, "Function %s without prototype", item.PrintableName.GetChars());
-				continue;
-			}
+//==========================================================================
+//
+// FFunctionBuildList :: Emit
+//
+// Generates the code of a resolved item. This only touches the item, its
+// builder, its slot in the script cache and the (locked) class data arena,
+// so different items can be emitted on different threads.
+//
+//==========================================================================
 
-			// Generate prototype for anonymous functions.
-			VMScriptFunction *sfunc = item.Function;
-			// create a new prototype from the now known return type and the argument list of the function's template prototype.
-			if (sfunc->Proto == nullptr)
-			{
-				sfunc->Proto = NewPrototype(item.Proto->ReturnTypes, item.Func->Variants[0].Proto->ArgumentTypes);
-				sfunc->ArgFlags = item.Func->Variants[0].ArgFlags;
-			}
+bool FFunctionBuildList::Emit(Item &item, VMFunctionBuilder *buildit)
+{
+	VMScriptFunction *sfunc = item.Function;
+	unsigned index = unsigned(&item - &mItems[0]);
+	FScriptPosition::StrictErrors = !item.FromDecorate;
 
-			// Emit code
-			try
-			{
-				sfunc->SourceFileName = item.Code->ScriptPosition.FileName;	// remember the file name for printing error messages if something goes wrong in the VM.
-				buildit.BeginStatement(item.Code);
-				item.Code->Emit(&buildit);
-				buildit.EndStatement();
-				buildit.MakeFunction(sfunc);
-				sfunc->NumArgs = 0;
-				// NumArgs for the VMFunction must be the amount of stack elements, which can differ from the amount of logical function arguments if vectors are in the list.
-				// For the VM a vector is 2 or 3 args, depending on size.
-				for (auto s : item.Func->Variants[0].Proto->ArgumentTypes)
-				{
-					sfunc->NumArgs += s->GetRegCount();
-				}
+	try
+	{
+		sfunc->SourceFileName = item.Code->ScriptPosition.FileName;	// remember the file name for printing error messages if something goes wrong in the VM.
+		if (mCache == nullptr || !mCache->Load(index, item.PrintableName.GetChars(), sfunc))
+		{
+			buildit->BeginStatement(item.Code);
+			item.Code->Emit(buildit);
+			buildit->EndStatement();
+			buildit->MakeFunction(sfunc);
+			if (mCache != nullptr) mCache->Store(index, item.PrintableName.GetChars(), sfunc, buildit);
+		}
+		sfunc->NumArgs = 0;
+		// NumArgs for the VMFunction must be the amount of stack elements, which can differ from the amount of logical function arguments if vectors are in the list.
+		// For the VM a vector is 2 or 3 args, depending on size.
+		for (auto s : item.Func->Variants[0].Proto->ArgumentTypes)
+		{
+			sfunc->NumArgs += s->GetRegCount();
+		}
+		sfunc->Unsafe = item.Unsafe;
+		return true;
+	}
+	catch (CRecoverableError &err)
+	{
+		// catch errors from the code generator and pring something meaningful.
+		item.Code->ScriptPosition.Message(MSG_ERROR, "%s in %s", err.GetMessage(), item.PrintableName.GetChars());
+		return false;
+	}
+}
 
-				if (dump != nullptr)
-				{
-					DumpFunction(dump, sfunc, item.PrintableName.GetChars(), (int)item.PrintableName.Len());
-					codesize += sfunc->CodeSize;
-					datasize += sfunc->LineInfoCount * sizeof(FStatementInfo) + sfunc->ExtraSpace + sfunc->NumKonstD * sizeof(int) +
-						sfunc->NumKonstA * sizeof(void*) + sfunc->NumKonstF * sizeof(double) + sfunc->NumKonstS * sizeof(FString);
-				}
-				sfunc->Unsafe = ctx.Unsafe;
-			}
-			catch (CRecoverableError &err)
+//==========================================================================
+//
+// FFunctionBuildList :: EmitParallel
+//
+// Emits all resolved items on a worker pool. Every item's messages go to
+// its own buffer, so they can be printed in the same order as a serial
+// build would have printed them.
+//
+//==========================================================================
+
+void FFunctionBuildList::EmitParallel(TArray<VMFunctionBuilder *> &builders, TArray<bool> &emitted, TArray<FScriptMessageBuffer> &messages)
+{
+	enum { BATCH = 64 };
+
+	auto emitRange = [&](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; i++)
+		{
+			if (builders[i] != nullptr)
 			{
-				// catch errors from the code generator and pring something meaningful.
-				item.Code->ScriptPosition.Message(MSG_ERROR, "%s in %s", err.GetMessage(), item.PrintableName.GetChars());
+				FScriptPosition::Capture = &messages[i];
+				emitted[i] = Emit(mItems[i], builders[i]);
 			}
 		}
+		FScriptPosition::Capture = nullptr;
+		FScriptPosition::StrictErrors = false;
+	};
+
+	auto &pool = WorkerPool();
+	std::vector<std::future<void>> tasks;
+	for (unsigned first = 0; first < mItems.Size(); first += BATCH)
+	{
+		unsigned last = MIN<unsigned>(first + BATCH, mItems.Size());
+		tasks.push_back(pool.push([=](int) { emitRange(first, last); }));
+	}
+	// All tasks must be finished before anything they reference goes away, even if one of them failed.
+	WorkerPoolWait(tasks);
+}
+
+//==========================================================================
+//
+// FFunctionBuildList :: Build
+//
+// With -parallelcodegen all functions are resolved first and then emitted
+// on a worker pool. Otherwise each function is resolved and emitted in turn.
+// With vm_cachescripts the emitted code is also kept in a cache file and
+// reused by the next start with the same scripts.
+//
+//==========================================================================
+
+void FFunctionBuildList::Build()
+{
+	int codesize = 0;
+	int datasize = 0;
+	FILE *dump = nullptr;
+
+	if (Args->CheckParm("-dumpdisasm")) dump = fopen("disasm.txt", "w");
+
+	// Timed so that the effect of vm_cachescripts can be measured.
+	uint64_t buildstart = I_nsTime();
+	uint64_t emittime = 0;
+	unsigned numfunctions = mItems.Size();
+	if (vm_cachescripts) mCache = new FScriptCache(mItems.Size());
+
+	auto finish = [&](Item &item, VMFunctionBuilder *buildit, bool emitted)
+	{
+		if (emitted && dump != nullptr)
+		{
+			VMScriptFunction *sfunc = item.Function;
+			DumpFunction(dump, sfunc, item.PrintableName.GetChars(), (int)item.PrintableName.Len());
+			codesize += sfunc->CodeSize;
+			datasize += sfunc->LineInfoCount * sizeof(FStatementInfo) + sfunc->ExtraSpace + sfunc->NumKonstD * sizeof(int) +
+				sfunc->NumKonstA * sizeof(void*) + sfunc->NumKonstF * sizeof(double) + sfunc->NumKonstS * sizeof(FString);
+		}
+		delete buildit;
 		delete item.Code;
 		if (dump != nullptr)
 		{
 			fflush(dump);
 		}
+	};
+
+	if (!Args->CheckParm("-parallelcodegen"))
+	{
+		for (auto &item : mItems)
+		{
+			VMFunctionBuilder *buildit = Resolve(item);
+			uint64_t emitstart = I_nsTime();
+			bool emitted = buildit != nullptr && Emit(item, buildit);
+			emittime += I_nsTime() - emitstart;
+			finish(item, buildit, emitted);
+		}
 	}
+	else
+	{
+		TArray<VMFunctionBuilder *> builders(mItems.Size(), true);
+		TArray<bool> emitted(mItems.Size(), true);
+		TArray<FScriptMessageBuffer> messages(mItems.Size(), true);
+
+		for (unsigned i = 0; i < mItems.Size(); i++)
+		{
+			FScriptPosition::Capture = &messages[i];
+			builders[i] = Resolve(mItems[i]);
+			emitted[i] = false;
+		}
+		FScriptPosition::Capture = nullptr;
+
+		uint64_t emitstart = I_nsTime();
+		EmitParallel(builders, emitted, messages);
+		emittime = I_nsTime() - emitstart;
+
+		for (unsigned i = 0; i < mItems.Size(); i++)
+		{
+			messages[i].Flush();
+			finish(mItems[i], builders[i], emitted[i]);
+		}
+	}
+
 	if (dump != nullptr)
 	{
 		fprintf(dump, "\n*************************************************************************\n%i code bytes\n%i data bytes", codesize * 4, datasize);
 		fclose(dump);
 	}
+	if (mCache != nullptr)
+	{
+		if (FScriptPosition::ErrorCounter == 0) mCache->Write();
+		delete mCache;
+		mCache = nullptr;
+	}
+	DPrintf(DMSG_NOTIFY, "%u script functions built in %.1f ms, %.1f ms of that generating code\n",
+		numfunctions, (I_nsTime() - buildstart) / 1e6, emittime / 1e6);
 	VMFunction::CreateRegUseInfo();
 	FScriptPosition::StrictErrors = false;
 
 	if (FScriptPosition::ErrorCounter == 0 && Args->CheckParm("-dumpjit")) DumpJit();
+	if (FScriptPosition::ErrorCounter == 0) JitStartEager();
 	mItems.Clear();
 	mItems.ShrinkToFit();
 	FxAlloc.FreeAllBlocks();
@@ -1065,9 +1259,7 @@ ExpEmit FunctionCallEmitter::EmitCall(VMFunctionBuilder *build, TArray<ExpEmit>
 	{
 		// Pass a hidden type information parameter to vararg functions.
 		// It would really be nicer to actually pass real types but that'd require a far more complex interface on the compiler side than what we have.
-		uint8_t *regbuffer = (uint8_t*)ClassDataAllocator.Alloc(reginfo.Size());	// Allocate in the arena so that the pointer does not need to be maintained.
-		memcpy(regbuffer, reginfo.Data(), reginfo.Size());
-		build->Emit(OP_PARAM, REGT_POINTER | REGT_KONST, build->GetConstantAddress(regbuffer));
+		build->Emit(OP_PARAM, REGT_POINTER | REGT_KONST, build->GetConstantBlob(reginfo.Data(), reginfo.Size()));
 		paramcount++;
 	}
 
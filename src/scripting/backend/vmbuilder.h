@@ -5,10 +5,17 @@
 #include "vmintern.h"
 #include <vector>
 #include <functional>
+#include <mutex>
 
 class VMFunctionBuilder;
 class FxExpression;
 class FxLocalVariableDeclaration;
+class FScriptCache;
+struct FScriptMessageBuffer;
+
+// ClassDataAllocator is not thread safe, but with -parallelcodegen the
+// code generator allocates from it on several threads at once.
+extern std::mutex ClassDataMutex;
 
 struct ExpEmit
 {
@@ -55,7 +62,9 @@ public:
 	unsigned GetConstantInt(int val);
 	unsigned GetConstantFloat(double val);
 	unsigned GetConstantAddress(void *ptr);
-	unsigned GetConstantString(FString str);
+	unsigned GetConstantString(const FString &str);
+	unsigned GetConstantBlob(const void *data, unsigned size);
+	unsigned GetBlobSize(void *ptr);
 
 	unsigned AllocConstantsInt(unsigned int count, int *values);
 	unsigned AllocConstantsFloat(unsigned int count, double *values);
@@ -110,6 +119,7 @@ private:
 	TMap<double, unsigned> FloatConstantMap;
 	TMap<void *, unsigned> AddressConstantMap;
 	TMap<FString, unsigned> StringConstantMap;
+	TMap<void *, unsigned> BlobSizes;
 
 	int MaxParam;
 	int ActiveParam;
@@ -143,10 +153,15 @@ class FFunctionBuildList
 		int Lump;
 		VersionInfo Version;
 		bool FromDecorate;
+		bool Unsafe = false;
 	};
 
 	TArray<Item> mItems;
+	FScriptCache *mCache = nullptr;
 
+	VMFunctionBuilder *Resolve(Item &item);
+	bool Emit(Item &item, VMFunctionBuilder *buildit);
+	void EmitParallel(TArray<VMFunctionBuilder *> &builders, TArray<bool> &emitted, TArray<FScriptMessageBuffer> &messages);
 	void DumpJit();
 
 public:
@@ -1,6 +1,11 @@
 
 #include "jit.h"
 #include "jitintern.h"
+#include "i_time.h"
+#include "c_dispatch.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 extern PString *TypeString;
 extern PStruct *TypeVector2;
@@ -8,7 +13,32 @@ extern PStruct *TypeVector3;
 
 static void OutputJitLog(const asmjit::StringLogger &logger);
 
-JitFuncPtr JitCompile(VMScriptFunction *sfunc)
+struct JitClassStats
+{
+	int numfuncs = 0;
+	uint64_t time = 0;
+	size_t codesize = 0;
+};
+
+static std::map<FString, JitClassStats> JitStats;
+static std::mutex JitStatsMutex;
+
+static void AddJitStats(VMScriptFunction *sfunc, uint64_t time, size_t codesize)
+{
+	// Group by the class part of "Class.Function". This can run on a worker thread,
+	// so the key gets its own copy of the characters.
+	const char *name = sfunc->PrintableName.GetChars();
+	const char *dot = strchr(name, '.');
+	FString classname = dot ? FString(name, dot - name) : FString("(global)");
+
+	std::lock_guard<std::mutex> lock(JitStatsMutex);
+	auto &stats = JitStats[classname];
+	stats.numfuncs++;
+	stats.time += time;
+	stats.codesize += codesize;
+}
+
+JitFuncPtr JitCompile(VMScriptFunction *sfunc, FString *errorlog)
 {
 #if 0
 	if (strcmp(sfunc->PrintableName.GetChars(), "StatusScreen.drawNum") != 0)
@@ -19,6 +49,7 @@ JitFuncPtr JitCompile(VMScriptFunction *sfunc)
 	StringLogger logger;
 	try
 	{
+		uint64_t start = I_nsTime();
 		ThrowingErrorHandler errorHandler;
 		CodeHolder code;
 		code.init(GetHostCodeInfo());
@@ -26,16 +57,52 @@ JitFuncPtr JitCompile(VMScriptFunction *sfunc)
 		code.setLogger(&logger);
 
 		JitCompiler compiler(&code, sfunc);
-		return reinterpret_cast<JitFuncPtr>(AddJitFunction(&code, &compiler));
+		auto func = reinterpret_cast<JitFuncPtr>(AddJitFunction(&code, &compiler));
+		if (func) AddJitStats(sfunc, I_nsTime() - start, code.getCodeSize());
+		return func;
 	}
 	catch (const CRecoverableError &e)
 	{
+		if (errorlog != nullptr)
+		{
+			// Printf may not be called from the eager JIT threads.
+			errorlog->AppendFormat("%s\n%s: Unexpected JIT error: %s\n", logger.getString(), sfunc->PrintableName.GetChars(), e.what());
+			return nullptr;
+		}
 		OutputJitLog(logger);
 		Printf("%s: Unexpected JIT error: %s\n",sfunc->PrintableName.GetChars(), e.what());
 		return nullptr;
 	}
 }
 
+CCMD(jitstats)
+{
+	TArray<std::pair<FString, JitClassStats>> sorted;
+	JitClassStats total;
+	{
+		std::lock_guard<std::mutex> lock(JitStatsMutex);
+		for (auto &pair : JitStats)
+		{
+			sorted.Push(pair);
+			total.numfuncs += pair.second.numfuncs;
+			total.time += pair.second.time;
+			total.codesize += pair.second.codesize;
+		}
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<FString, JitClassStats> &a, const std::pair<FString, JitClassStats> &b)
+	{
+		return a.second.time > b.second.time;
+	});
+
+	int count = argv.argc() > 1 ? atoi(argv[1]) : 20;
+	for (unsigned i = 0; i < sorted.Size() && int(i) < count; i++)
+	{
+		auto &stats = sorted[i].second;
+		Printf("%-32s %5d functions, %8.2f ms, %8zu bytes\n", sorted[i].first.GetChars(), stats.numfuncs, stats.time / 1e6, stats.codesize);
+	}
+	Printf("Total: %d functions in %u classes, %.2f ms, %zu bytes\n", total.numfuncs, sorted.Size(), total.time / 1e6, total.codesize);
+}
+
 void JitDumpLog(FILE *file, VMScriptFunction *sfunc)
 {
 	using namespace asmjit;
@@ -131,7 +198,9 @@ asmjit::CCFunc *JitCompiler::Codegen()
 
 		labels[i].cursor = cc.getCursor();
 		ResetTemp();
+		spillCursor = cc.getCursor();
 		EmitOpcode();
+		if (spillRegisters) StoreSpilledRegisters();
 
 		pc++;
 	}
@@ -261,8 +330,12 @@ void JitCompiler::Setup()
 
 	labels.Resize(sfunc->CodeSize);
 
+	// Asmjit has a 256 register limit. Stay safely away from it as the jit compiler uses a few for temporaries as well.
+	spillRegisters = sfunc->NumRegA + sfunc->NumRegD + sfunc->NumRegF + sfunc->NumRegS >= 200;
+
 	CreateRegisters();
 	IncrementVMCalls();
+	if (vm_jit_profile) EmitProfilerCheck();
 	SetupFrame();
 }
 
@@ -276,7 +349,7 @@ void JitCompiler::SetupFrame()
 	offsetD = offsetA + (int)(sfunc->NumRegA * sizeof(void*));
 	offsetExtra = (offsetD + (int)(sfunc->NumRegD * sizeof(int32_t)) + 15) & ~15;
 
-	if (sfunc->SpecialInits.Size() == 0 && sfunc->NumRegS == 0)
+	if (sfunc->SpecialInits.Size() == 0 && sfunc->NumRegS == 0 && !spillRegisters)
 	{
 		SetupSimpleFrame();
 	}
@@ -369,6 +442,9 @@ void JitCompiler::SetupFullVMFrame()
 	cc.mov(vmframe, x86::ptr(vmframe, VMFrameStack::OffsetLastFrame())); // Blocks->LastFrame
 	vmframeAllocated = true;
 
+	if (spillRegisters)
+		return;
+
 	for (int i = 0; i < sfunc->NumRegD; i++)
 		cc.mov(regD[i], x86::dword_ptr(vmframe, offsetD + i * sizeof(int32_t)));
 
@@ -389,7 +465,7 @@ static void PopFullVMFrame(VMFrameStack *stack)
 
 void JitCompiler::EmitPopFrame()
 {
-	if (sfunc->SpecialInits.Size() != 0 || sfunc->NumRegS != 0)
+	if (sfunc->SpecialInits.Size() != 0 || sfunc->NumRegS != 0 || spillRegisters)
 	{
 		auto popFrame = CreateCall<void, VMFrameStack *>(PopFullVMFrame);
 		popFrame->setArg(0, stack);
@@ -407,6 +483,32 @@ void JitCompiler::IncrementVMCalls()
 	cc.mov(asmjit::x86::dword_ptr(vmcallsptr), vmcalls);
 }
 
+static void JitProfileSample()
+{
+	VMProfileSample(nullptr, nullptr);
+}
+
+void JitCompiler::EmitProfilerCheck()
+{
+	using namespace asmjit;
+
+	// The sampling call is placed out of line, like the exception throws.
+	auto sampleLabel = cc.newLabel();
+	auto continueLabel = cc.newLabel();
+
+	auto flagptr = newTempIntPtr();
+	cc.mov(flagptr, imm_ptr(&VMProfileSampleRequest));
+	cc.cmp(x86::byte_ptr(flagptr), 0);
+	cc.jne(sampleLabel);
+	cc.bind(continueLabel);
+
+	auto cursor = cc.getCursor();
+	cc.bind(sampleLabel);
+	cc.call(imm_ptr(reinterpret_cast<void*>(&JitProfileSample)), FuncSignature0<void>());
+	cc.jmp(continueLabel);
+	cc.setCursor(cursor);
+}
+
 void JitCompiler::CreateRegisters()
 {
 	regD.Resize(sfunc->NumRegD);
@@ -414,6 +516,9 @@ void JitCompiler::CreateRegisters()
 	regA.Resize(sfunc->NumRegA);
 	regS.Resize(sfunc->NumRegS);
 
+	if (spillRegisters)
+		return;
+
 	for (int i = 0; i < sfunc->NumRegD; i++)
 	{
 		regname.Format("regD%d", i);
@@ -439,6 +544,72 @@ void JitCompiler::CreateRegisters()
 	}
 }
 
+void JitCompiler::LoadSpilledRegister(int regtype, unsigned int index, asmjit::X86Gp &reg)
+{
+	using namespace asmjit;
+
+	// The load goes to the start of the opcode so that it runs on every path through it.
+	auto cursor = cc.setCursor(spillCursor);
+	bool atStart = cursor == spillCursor;
+
+	if (regtype == REGT_INT)
+	{
+		reg = newTempInt32();
+		cc.mov(reg, x86::dword_ptr(vmframe, offsetD + index * sizeof(int32_t)));
+	}
+	else if (regtype == REGT_STRING)
+	{
+		reg = newTempIntPtr();
+		cc.lea(reg, x86::ptr(vmframe, offsetS + index * sizeof(FString)));
+	}
+	else
+	{
+		reg = newTempIntPtr();
+		cc.mov(reg, x86::ptr(vmframe, offsetA + index * sizeof(void*)));
+	}
+
+	spillCursor = cc.getCursor();
+	cc.setCursor(atStart ? spillCursor : cursor);
+}
+
+void JitCompiler::LoadSpilledRegister(int regtype, unsigned int index, asmjit::X86Xmm &reg)
+{
+	using namespace asmjit;
+
+	auto cursor = cc.setCursor(spillCursor);
+	bool atStart = cursor == spillCursor;
+
+	reg = newTempXmmSd();
+	cc.movsd(reg, x86::qword_ptr(vmframe, offsetF + index * sizeof(double)));
+
+	spillCursor = cc.getCursor();
+	cc.setCursor(atStart ? spillCursor : cursor);
+}
+
+void JitCompiler::StoreSpilledRegister(int regtype, unsigned int index, const asmjit::X86Gp &reg)
+{
+	using namespace asmjit;
+
+	if (regtype == REGT_INT)
+		cc.mov(x86::dword_ptr(vmframe, offsetD + index * sizeof(int32_t)), reg);
+	else if (regtype == REGT_POINTER)
+		cc.mov(x86::ptr(vmframe, offsetA + index * sizeof(void*)), reg);
+	// String registers are pointers into the frame, there is nothing to write back.
+}
+
+void JitCompiler::StoreSpilledRegister(int regtype, unsigned int index, const asmjit::X86Xmm &reg)
+{
+	cc.movsd(asmjit::x86::qword_ptr(vmframe, offsetF + index * sizeof(double)), reg);
+}
+
+void JitCompiler::StoreSpilledRegisters()
+{
+	regD.StoreSpilled();
+	regF.StoreSpilled();
+	regA.StoreSpilled();
+	regS.StoreSpilled();
+}
+
 void JitCompiler::EmitNullPointerThrow(int index, EVMAbortException reason)
 {
 	auto label = EmitThrowExceptionLabel(reason);
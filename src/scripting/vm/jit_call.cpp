@@ -1,7 +1,10 @@
 
 #include "jitintern.h"
+#include "c_dispatch.h"
+#include <algorithm>
 #include <map>
 #include <memory>
+#include <mutex>
 
 void JitCompiler::EmitPARAM()
 {
@@ -40,8 +43,56 @@ void JitCompiler::EmitVtbl(const VMOP *op)
 	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[a], c * (int)sizeof(void*)));
 }
 
+//==========================================================================
+//
+// Call site statistics for the jitnativecalls command. Functions can get
+// compiled on the eager JIT threads so this needs a lock.
+//
+//==========================================================================
+
+static std::map<VMFunction *, int> GenericNativeCalls;
+static int DirectCallSites, GenericCallSites, IndirectCallSites;
+static std::mutex CallStatsMutex;
+
+static void CountCallSite(VMFunction *target, bool direct)
+{
+	std::lock_guard<std::mutex> lock(CallStatsMutex);
+	if (target == nullptr)
+	{
+		IndirectCallSites++;
+	}
+	else if (direct)
+	{
+		DirectCallSites++;
+	}
+	else
+	{
+		GenericCallSites++;
+		GenericNativeCalls[target]++;
+	}
+}
+
+CCMD(jitnativecalls)
+{
+	TArray<std::pair<VMFunction *, int>> sorted;
+	{
+		std::lock_guard<std::mutex> lock(CallStatsMutex);
+		Printf("Native call sites in JIT code: %d direct, %d through VMValue parameters, %d virtual or indirect\n", DirectCallSites, GenericCallSites, IndirectCallSites);
+		for (auto &pair : GenericNativeCalls) sorted.Push(pair);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<VMFunction *, int> &a, const std::pair<VMFunction *, int> &b)
+	{
+		return a.second > b.second;
+	});
+	for (auto &pair : sorted)
+	{
+		Printf("%5d %s\n", pair.second, pair.first->PrintableName.GetChars());
+	}
+}
+
 void JitCompiler::EmitCALL()
 {
+	CountCallSite(nullptr, false);
 	EmitVMCall(regA[A], nullptr);
 	pc += C; // Skip RESULTs
 }
@@ -56,10 +107,12 @@ void JitCompiler::EmitCALL_K()
 
 	if (ntarget && ntarget->DirectNativeCall)
 	{
+		CountCallSite(ntarget, true);
 		EmitNativeCall(ntarget);
 	}
 	else
 	{
+		if (ntarget) CountCallSite(ntarget, false);
 		auto ptr = newTempIntPtr();
 		cc.mov(ptr, asmjit::imm_ptr(target));
 		EmitVMCall(ptr, target);
@@ -395,9 +448,30 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 				break;
 
 			case REGT_INT | REGT_ADDROF:
+				CheckVMFrame();
+				tmp = newTempIntPtr();
+				cc.lea(tmp, x86::ptr(vmframe, offsetD + (int)(bc * sizeof(int32_t))));
+				cc.mov(x86::dword_ptr(tmp), regD[bc]);
+				call->setArg(slot, tmp);
+				break;
 			case REGT_POINTER | REGT_ADDROF:
+				CheckVMFrame();
+				tmp = newTempIntPtr();
+				cc.lea(tmp, x86::ptr(vmframe, offsetA + (int)(bc * sizeof(void*))));
+				cc.mov(x86::ptr(tmp), regA[bc]);
+				call->setArg(slot, tmp);
+				break;
 			case REGT_FLOAT | REGT_ADDROF:
-				I_Error("REGT_ADDROF not implemented for native direct calls\n");
+				CheckVMFrame();
+				tmp = newTempIntPtr();
+				cc.lea(tmp, x86::ptr(vmframe, offsetF + (int)(bc * sizeof(double))));
+				// When passing the address to a float we don't know if the receiving function will treat it as float, vec2 or vec3.
+				for (int j = 0; j < 3; j++)
+				{
+					if ((unsigned int)(bc + j) < regF.Size())
+						cc.movsd(x86::qword_ptr(tmp, j * sizeof(double)), regF[bc + j]);
+				}
+				call->setArg(slot, tmp);
 				break;
 
 			default:
@@ -480,6 +554,8 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 
 	cc.setCursor(cursorAfter);
 
+	LoadInOuts();
+
 	if (startret == 1 && numret > 0)
 	{
 		int type = retval[0].b;
@@ -544,6 +620,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 }
 
 static std::map<FString, std::unique_ptr<TArray<uint8_t>>> argsCache;
+static std::mutex argsCacheMutex;
 
 asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 {
@@ -659,7 +736,8 @@ asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 	}
 
 	// FuncSignature only keeps a pointer to its args array. Store a copy of each args array variant.
-	std::unique_ptr<TArray<uint8_t>> &cachedArgs = argsCache[key];
+	std::lock_guard<std::mutex> lock(argsCacheMutex);
+	std::unique_ptr<TArray<uint8_t>> &cachedArgs = argsCache[FString(key.GetChars(), key.Len())];
 	if (!cachedArgs) cachedArgs.reset(new TArray<uint8_t>(args));
 
 	FuncSignature signature;
@@ -18,6 +18,9 @@ void JitCompiler::EmitTESTN()
 
 void JitCompiler::EmitJMP()
 {
+	if (JMPOFS(pc) < 0 && vm_jit_profile)
+		EmitProfilerCheck();
+
 	auto dest = pc + JMPOFS(pc) + 1;
 	int i = (int)(ptrdiff_t)(dest - sfunc->Code);
 	cc.jmp(GetLabel(i));
@@ -11,6 +11,8 @@
 #include <cstdlib>
 #include <memory>
 #endif
+#include <mutex>
+#include <algorithm>
 
 struct JitFuncInfo
 {
@@ -22,26 +24,37 @@ struct JitFuncInfo
 };
 
 static TArray<JitFuncInfo> JitDebugInfo;
+static TArray<unsigned int> JitDebugInfoByAddress;	// for the script profiler
 static TArray<uint8_t*> JitBlocks;
 static TArray<uint8_t*> JitFrames;
 static size_t JitBlockPos = 0;
 static size_t JitBlockSize = 0;
 
+// Functions may get compiled on the eager JIT worker threads, so everything
+// touching the code blocks and the debug info above must hold this lock.
+static std::mutex JitMutex;
+
 asmjit::CodeInfo GetHostCodeInfo()
 {
-	static bool firstCall = true;
-	static asmjit::CodeInfo codeInfo;
-
-	if (firstCall)
+	static const asmjit::CodeInfo codeInfo = []()
 	{
 		asmjit::JitRuntime rt;
-		codeInfo = rt.getCodeInfo();
-		firstCall = false;
-	}
+		return rt.getCodeInfo();
+	}();
 
 	return codeInfo;
 }
 
+static JitFuncInfo CreateJitFuncInfo(JitCompiler *compiler, void *start, void *end)
+{
+	// The strings must not share their buffers with the script function
+	// because the reference counting in FString is not thread safe.
+	auto sfunc = compiler->GetScriptFunction();
+	FString name(sfunc->PrintableName.GetChars(), sfunc->PrintableName.Len());
+	FString filename(sfunc->SourceFileName.GetChars(), sfunc->SourceFileName.Len());
+	return { name, filename, compiler->LineInfo, start, end };
+}
+
 static void *AllocJitMemory(size_t size)
 {
 	using namespace asmjit;
@@ -271,6 +284,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 
 	codeSize = (codeSize + 15) / 16 * 16;
 
+	std::lock_guard<std::mutex> lock(JitMutex);
 	uint8_t *p = (uint8_t *)AllocJitMemory(codeSize + unwindInfoSize + functionTableSize);
 	if (!p)
 		return nullptr;
@@ -303,7 +317,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 	if (result == 0)
 		I_Error("RtlAddFunctionTable failed");
 
-	JitDebugInfo.Push({ compiler->GetScriptFunction()->PrintableName, compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr });
+	JitDebugInfo.Push(CreateJitFuncInfo(compiler, startaddr, endaddr));
 #endif
 
 	return p;
@@ -662,6 +676,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 
 	codeSize = (codeSize + 15) / 16 * 16;
 
+	std::lock_guard<std::mutex> lock(JitMutex);
 	uint8_t *p = (uint8_t *)AllocJitMemory(codeSize + unwindInfoSize);
 	if (!p)
 		return nullptr;
@@ -727,7 +742,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 #endif
 	}
 
-	JitDebugInfo.Push({ compiler->GetScriptFunction()->PrintableName, compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr });
+	JitDebugInfo.Push(CreateJitFuncInfo(compiler, startaddr, endaddr));
 
 	return p;
 }
@@ -735,6 +750,7 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 
 void JitRelease()
 {
+	std::lock_guard<std::mutex> lock(JitMutex);
 #ifdef _WIN64
 	for (auto p : JitFrames)
 	{
@@ -751,6 +767,7 @@ void JitRelease()
 		asmjit::OSUtils::releaseVirtualMemory(p, 1024 * 1024);
 	}
 	JitDebugInfo.Clear();
+	JitDebugInfoByAddress.Clear();
 	JitFrames.Clear();
 	JitBlocks.Clear();
 	JitBlockPos = 0;
@@ -929,6 +946,7 @@ int JITPCToLine(uint8_t *pc, const JitFuncInfo *info)
 
 FString JitGetStackFrameName(NativeSymbolResolver *nativeSymbols, void *pc)
 {
+	std::unique_lock<std::mutex> lock(JitMutex);
 	for (unsigned int i = 0; i < JitDebugInfo.Size(); i++)
 	{
 		const auto &info = JitDebugInfo[i];
@@ -946,10 +964,53 @@ FString JitGetStackFrameName(NativeSymbolResolver *nativeSymbols, void *pc)
 			return s;
 		}
 	}
+	lock.unlock();
 
 	return nativeSymbols ? nativeSymbols->GetName(pc) : FString();
 }
 
+//==========================================================================
+//
+// Appends "function:line" for every JIT frame on the stack, innermost
+// first. This runs for every profiler sample, so instead of searching
+// JitDebugInfo linearly, it uses a list sorted by address that gets
+// rebuilt whenever functions were added.
+//
+//==========================================================================
+
+void JitCaptureScriptFrames(TArray<FString> &frames)
+{
+	void *pcs[64];
+	int numframes = CaptureStackTrace(64, pcs);
+
+	std::lock_guard<std::mutex> lock(JitMutex);
+	if (JitDebugInfoByAddress.Size() != JitDebugInfo.Size())
+	{
+		JitDebugInfoByAddress.Resize(JitDebugInfo.Size());
+		for (unsigned int i = 0; i < JitDebugInfo.Size(); i++)
+			JitDebugInfoByAddress[i] = i;
+		std::sort(JitDebugInfoByAddress.begin(), JitDebugInfoByAddress.end(), [](unsigned int a, unsigned int b) { return JitDebugInfo[a].start < JitDebugInfo[b].start; });
+	}
+
+	for (int i = 0; i < numframes; i++)
+	{
+		// Find the last function starting at or before the address.
+		auto it = std::upper_bound(JitDebugInfoByAddress.begin(), JitDebugInfoByAddress.end(), pcs[i], [](void *pc, unsigned int index) { return pc < JitDebugInfo[index].start; });
+		if (it == JitDebugInfoByAddress.begin())
+			continue;
+
+		const auto &info = JitDebugInfo[*(it - 1)];
+		if (pcs[i] >= info.end)
+			continue;
+
+		int line = JITPCToLine((uint8_t *)pcs[i], &info);
+		if (line == -1)
+			frames.Push(info.name);
+		else
+			frames.Push(FStringf("%s:%d", info.name.GetChars(), line));
+	}
+}
+
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames)
 {
 	void *frames[32];
@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "stats.h"
+#include "c_cvars.h"
 
 // To do: get cmake to define these..
 #define ASMJIT_BUILD_EMBED
@@ -16,6 +17,8 @@
 extern cycle_t VMCycles[10];
 extern int VMCalls[10];
 
+EXTERN_CVAR(Bool, vm_jit_profile)
+
 #define A				(pc[0].a)
 #define B				(pc[0].b)
 #define C				(pc[0].c)
@@ -53,6 +56,7 @@ private:
 	void Setup();
 	void CreateRegisters();
 	void IncrementVMCalls();
+	void EmitProfilerCheck();
 	void SetupFrame();
 	void SetupSimpleFrame();
 	void SetupFullVMFrame();
@@ -264,10 +268,66 @@ private:
 	const FString *konsts;
 	const FVoidObj *konsta;
 
-	TArray<asmjit::X86Gp> regD;
-	TArray<asmjit::X86Xmm> regF;
-	TArray<asmjit::X86Gp> regA;
-	TArray<asmjit::X86Gp> regS;
+	// Normally every VM register is a virtual register of its own. Functions with more registers
+	// than asmjit can handle keep them in the VMFrame instead. An opcode then loads the ones it
+	// uses into temporaries at its start and writes them back at its end.
+	template<typename RegType>
+	class JitRegisterFile
+	{
+	public:
+		JitRegisterFile(JitCompiler *compiler, int regtype) : compiler(compiler), regtype(regtype) { }
+
+		void Resize(unsigned int count)
+		{
+			regs.Resize(count);
+			loaded.Resize(count);
+			for (auto &l : loaded) l = false;
+		}
+
+		unsigned int Size() const { return regs.Size(); }
+
+		RegType &operator[](unsigned int index)
+		{
+			if (compiler->spillRegisters && !loaded[index])
+			{
+				compiler->LoadSpilledRegister(regtype, index, regs[index]);
+				loaded[index] = true;
+				touched.Push(index);
+			}
+			return regs[index];
+		}
+
+		void StoreSpilled()
+		{
+			for (auto index : touched)
+			{
+				compiler->StoreSpilledRegister(regtype, index, regs[index]);
+				loaded[index] = false;
+			}
+			touched.Clear();
+		}
+
+	private:
+		JitCompiler *compiler;
+		int regtype;
+		TArray<RegType> regs;
+		TArray<bool> loaded;
+		TArray<unsigned int> touched;
+	};
+
+	void LoadSpilledRegister(int regtype, unsigned int index, asmjit::X86Gp &reg);
+	void LoadSpilledRegister(int regtype, unsigned int index, asmjit::X86Xmm &reg);
+	void StoreSpilledRegister(int regtype, unsigned int index, const asmjit::X86Gp &reg);
+	void StoreSpilledRegister(int regtype, unsigned int index, const asmjit::X86Xmm &reg);
+	void StoreSpilledRegisters();
+
+	bool spillRegisters = false;
+	asmjit::CBNode *spillCursor = nullptr;
+
+	JitRegisterFile<asmjit::X86Gp> regD { this, REGT_INT };
+	JitRegisterFile<asmjit::X86Xmm> regF { this, REGT_FLOAT };
+	JitRegisterFile<asmjit::X86Gp> regA { this, REGT_POINTER };
+	JitRegisterFile<asmjit::X86Gp> regS { this, REGT_STRING };
 
 	struct OpcodeLabel
 	{
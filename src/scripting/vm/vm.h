@@ -54,6 +54,8 @@ extern FMemArena ClassDataAllocator;
 #define MAX_TRY_DEPTH	8	// Maximum number of nested TRYs in a single function
 
 void JitRelease();
+void JitStartEager();
+void JitCancelEager();
 
 
 typedef unsigned char		VM_UBYTE;
@@ -425,6 +427,7 @@ public:
 	void operator delete[](void *block) {}
 	static void DeleteAll()
 	{
+		JitCancelEager();
 		for (auto f : AllFunctions)
 		{
 			f->~VMFunction();
@@ -60,6 +60,8 @@ static int ExecScriptFunc(VMFrameStack *stack, VMReturn *ret, int numret)
 
 	const VMRegisters reg(f);
 
+	if (VMProfileSampleRequest.load(std::memory_order_relaxed)) VMProfileSample(sfunc, pc);
+
 	void *ptr;
 	double fb, fc;
 	const double *fbp, *fcp;
@@ -550,6 +552,11 @@ static int ExecScriptFunc(VMFrameStack *stack, VMReturn *ret, int numret)
 		}
 		NEXTOP;
 	OP(JMP):
+		if (JMPOFS(pc) < 0)
+		{
+			if (sfunc->IsCounting()) sfunc->BackEdgeCount++;
+			if (VMProfileSampleRequest.load(std::memory_order_relaxed)) VMProfileSample(sfunc, pc);
+		}
 		pc += JMPOFS(pc);
 		NEXTOP;
 	OP(IJMP):
@@ -691,6 +698,7 @@ static int ExecScriptFunc(VMFrameStack *stack, VMReturn *ret, int numret)
 			int numret;
 
 			b = B;
+			f->PC = pc;
 			FillReturns(reg, f, returns, pc+1, C);
 			if (call->VarFlags & VARF_Native)
 			{
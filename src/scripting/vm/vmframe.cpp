@@ -43,6 +43,12 @@
 #include "jit.h"
 #include "c_cvars.h"
 #include "version.h"
+#include "m_misc.h"
+#include "files.h"
+#include "i_system.h"
+#include "ctpl.h"
+#include <atomic>
+#include <algorithm>
 
 #ifdef HAVE_VM_JIT
 CUSTOM_CVAR(Bool, vm_jit, true, CVAR_NOINITCALL)
@@ -50,10 +56,23 @@ CUSTOM_CVAR(Bool, vm_jit, true, CVAR_NOINITCALL)
 	Printf("You must restart " GAMENAME " for this change to take effect.\n");
 	Printf("This cvar is currently not saved. You must specify it on the command line.");
 }
+
+// 0: compile a function when it is first called
+// 1: compile all script functions on background threads after the scripts are loaded
+// 2: like 1 but only the functions that got called in the previous session
+CVAR(Int, vm_jit_eager, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+
+// Functions not handled by vm_jit_eager stay in the interpreter until they
+// got called this many times, loop iterations included. 0 compiles them on
+// the first call.
+CVAR(Int, vm_jit_threshold, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 #else
 CVAR(Bool, vm_jit, false, CVAR_NOINITCALL|CVAR_NOSET)
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames) { return FString(); }
 void JitRelease() {}
+void JitCaptureScriptFrames(TArray<FString> &frames) {}
+void JitStartEager() {}
+void JitCancelEager() {}
 #endif
 
 cycle_t VMCycles[10];
@@ -130,6 +149,8 @@ VMScriptFunction::VMScriptFunction(FName name)
 	NumKonstA = 0;
 	MaxParam = 0;
 	NumArgs = 0;
+	CallCount = 0;
+	BackEdgeCount = 0;
 	ScriptCall = &VMScriptFunction::FirstScriptCall;
 }
 
@@ -264,24 +285,225 @@ int VMScriptFunction::PCToLine(const VMOP *pc)
 	return -1;
 }
 
-static bool CanJit(VMScriptFunction *func)
+#ifdef HAVE_VM_JIT
+
+//==========================================================================
+//
+// Eager JIT
+//
+// The worker threads only compile. The result gets stored in ScriptCall by
+// FirstScriptCall on the game thread, so script code never sees a function
+// pointer change while it is running and the JIT'ed code, which reads
+// ScriptCall directly, needs no synchronization.
+//
+//==========================================================================
+
+enum
+{
+	EJ_Queued,
+	EJ_Compiling,
+	EJ_Done,
+	EJ_Taken,		// compiled on the game thread or installed
+};
+
+struct FEagerJitJob
+{
+	VMScriptFunction *func;
+	std::atomic<int> state;
+	JitFuncPtr result;
+	FString errors;
+};
+
+// Not the shared worker pool: compiling runs for a long time and would keep
+// its workers from the short batches the other users push there.
+static ctpl::thread_pool EagerJitPool;
+static std::unique_ptr<FEagerJitJob[]> EagerJobs;
+static unsigned NumEagerJobs;
+static std::atomic<unsigned> NextEagerJob;
+static std::atomic<bool> EagerCancel;
+static std::vector<std::future<void>> EagerTasks;
+static TMap<VMFunction *, FEagerJitJob *> EagerJobMap;
+static TArray<FString> HotList;
+
+static FString GetHotListPath(bool create)
+{
+	FString path = M_GetCachePath(create);
+	if (create) CreatePath(path);
+	path << "/jithotlist.txt";
+	return path;
+}
+
+static void WriteHotList()
+{
+	if (HotList.Size() == 0) return;
+
+	FString path = GetHotListPath(true);
+	FileWriter *fw = FileWriter::Open(path);
+	if (fw == nullptr) return;
+	for (auto &name : HotList)
+	{
+		fw->Write(name.GetChars(), name.Len());
+		fw->Write("\n", 1);
+	}
+	delete fw;
+}
+
+static bool ReadHotList(TMap<FString, bool> &names)
 {
-	// Asmjit has a 256 register limit. Stay safely away from it as the jit compiler uses a few for temporaries as well.
-	// Any function exceeding the limit will use the VM - a fair punishment to someone for writing a function so bloated ;)
+	FileReader fr;
+	if (!fr.OpenFile(GetHotListPath(false))) return false;
 
-	int maxregs = 200;
-	if (func->NumRegA + func->NumRegD + func->NumRegF + func->NumRegS < maxregs)
-		return true;
+	auto text = fr.Read();
+	text.Push(0);
+	FString content((const char *)text.Data());
+	for (auto &line : content.Split("\n", FString::TOK_SKIPEMPTY))
+	{
+		line.StripRight();
+		names[line] = true;
+	}
+	return true;
+}
+
+static void RunEagerJobs()
+{
+	while (!EagerCancel)
+	{
+		unsigned index = NextEagerJob++;
+		if (index >= NumEagerJobs) break;
+
+		auto &job = EagerJobs[index];
+		int expected = EJ_Queued;
+		if (!job.state.compare_exchange_strong(expected, EJ_Compiling)) continue;
+		job.result = JitCompile(job.func, &job.errors);
+		job.state = EJ_Done;
+	}
+}
+
+void JitStartEager()
+{
+	static bool writehotlist;
+	if (vm_jit_eager == 2 && !writehotlist)
+	{
+		writehotlist = true;
+		atterm(WriteHotList);
+	}
+	if (!vm_jit || vm_jit_eager <= 0 || EagerJobs != nullptr) return;
+
+	TArray<VMScriptFunction *> funcs;
+	if (vm_jit_eager == 1)
+	{
+		for (auto f : VMFunction::AllFunctions)
+		{
+			if (!(f->VarFlags & VARF_Native)) funcs.Push(static_cast<VMScriptFunction *>(f));
+		}
+	}
+	else
+	{
+		// Keep the order of the list so that the functions needed first are also done first.
+		TMap<FString, bool> names;
+		if (!ReadHotList(names)) return;
+		for (auto f : VMFunction::AllFunctions)
+		{
+			if (!(f->VarFlags & VARF_Native) && names.CheckKey(f->PrintableName)) funcs.Push(static_cast<VMScriptFunction *>(f));
+		}
+	}
+
+	EagerJobs.reset(new FEagerJitJob[funcs.Size()]);
+	NumEagerJobs = 0;
+	for (auto f : funcs)
+	{
+		if (f->ScriptCall != &VMScriptFunction::FirstScriptCall || f->Code == nullptr) continue;
+
+		auto &job = EagerJobs[NumEagerJobs++];
+		job.func = f;
+		job.state = EJ_Queued;
+		job.result = nullptr;
+		EagerJobMap[f] = &job;
+	}
+	if (NumEagerJobs == 0) return;
+
+	// Half the cores, so that the shared worker pool still has some to itself.
+	if (EagerJitPool.size() == 0)
+	{
+		EagerJitPool.resize(MAX<int>(std::thread::hardware_concurrency() / 2, 1));
+	}
+	NextEagerJob = 0;
+	EagerCancel = false;
+	for (int i = 0; i < EagerJitPool.size(); i++)
+	{
+		EagerTasks.push_back(EagerJitPool.push([](int) { RunEagerJobs(); }));
+	}
+}
+
+//==========================================================================
+//
+// Must be called before the script functions get destroyed.
+//
+//==========================================================================
+
+void JitCancelEager()
+{
+	EagerCancel = true;
+	for (auto &task : EagerTasks)
+	{
+		task.get();
+	}
+	EagerTasks.clear();
+	EagerJobMap.Clear();
+	EagerJobs.reset();
+	NumEagerJobs = 0;
+}
 
-	Printf(TEXTCOLOR_ORANGE "%s is using too many registers (%d of max %d)! Function will not use native code.\n", func->PrintableName.GetChars(), func->NumRegA + func->NumRegD + func->NumRegF + func->NumRegS, maxregs);
+//==========================================================================
+//
+// Returns false if the function is being compiled right now. In that case
+// the call must go to the interpreter without touching ScriptCall.
+//
+//==========================================================================
 
-	return false;
+static bool InstallEagerJit(FEagerJitJob &job)
+{
+	int expected = EJ_Queued;
+	if (job.state.compare_exchange_strong(expected, EJ_Taken))
+	{
+		// Not started yet so compile it right here.
+		job.func->ScriptCall = JitCompile(job.func);
+	}
+	else if (expected == EJ_Compiling)
+	{
+		return false;
+	}
+	else
+	{
+		if (job.errors.IsNotEmpty()) Printf("%s", job.errors.GetChars());
+		job.errors = "";
+		job.state = EJ_Taken;
+		job.func->ScriptCall = job.result;
+	}
+	return true;
 }
 
+#endif // HAVE_VM_JIT
+
 int VMScriptFunction::FirstScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret)
 {
 #ifdef HAVE_VM_JIT
-	if (vm_jit && CanJit(static_cast<VMScriptFunction*>(func)))
+	auto pjob = vm_jit ? EagerJobMap.CheckKey(func) : nullptr;
+	if (pjob != nullptr)
+	{
+		if (!InstallEagerJit(**pjob))
+		{
+			// A worker is busy with it. Interpret this call and come back here on the next one.
+			return VMExec(func, params, numparams, ret, numret);
+		}
+		if (!func->ScriptCall)
+			func->ScriptCall = VMExec;
+	}
+	else if (vm_jit && vm_jit_threshold > 0)
+	{
+		func->ScriptCall = &VMScriptFunction::CountedScriptCall;
+	}
+	else if (vm_jit)
 	{
 		func->ScriptCall = JitCompile(static_cast<VMScriptFunction*>(func));
 		if (!func->ScriptCall)
@@ -293,9 +515,52 @@ int VMScriptFunction::FirstScriptCall(VMFunction *func, VMValue *params, int num
 		func->ScriptCall = VMExec;
 	}
 
+#ifdef HAVE_VM_JIT
+	if (vm_jit_eager == 2)
+	{
+		HotList.Push(func->PrintableName);
+	}
+#endif
 	return func->ScriptCall(func, params, numparams, ret, numret);
 }
 
+//==========================================================================
+//
+// Interpreter tier for vm_jit_threshold. Only functions in this tier are
+// counted, so with the default threshold of 0 nothing is. The interpreter
+// counts their backwards jumps so that functions which spend their time in
+// a loop get promoted as well.
+//
+//==========================================================================
+
+int VMScriptFunction::CountedScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret)
+{
+#ifdef HAVE_VM_JIT
+	auto sfunc = static_cast<VMScriptFunction*>(func);
+	if (++sfunc->CallCount + sfunc->BackEdgeCount >= (unsigned)vm_jit_threshold)
+	{
+		func->ScriptCall = JitCompile(sfunc);
+		if (!func->ScriptCall)
+			func->ScriptCall = VMExec;
+		return func->ScriptCall(func, params, numparams, ret, numret);
+	}
+#endif
+	return VMExec(func, params, numparams, ret, numret);
+}
+
+const char *VMScriptFunction::GetTierName() const
+{
+	if (ScriptCall == &VMScriptFunction::FirstScriptCall) return "not called";
+	if (ScriptCall == &VMScriptFunction::CountedScriptCall) return "counting";
+	if (ScriptCall == VMExec) return "interpreted";
+	return "native";
+}
+
+bool VMScriptFunction::IsInterpreted() const
+{
+	return ScriptCall == VMExec || ScriptCall == &VMScriptFunction::CountedScriptCall;
+}
+
 int VMNativeFunction::NativeScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *returns, int numret)
 {
 	try
@@ -394,6 +659,7 @@ VMFrame *VMFrameStack::AllocFrame(VMScriptFunction *func)
 	frame->NumRegA = func->NumRegA;
 	frame->MaxParam = func->MaxParam;
 	frame->Func = func;
+	frame->PC = func->Code;
 	frame->InitRegS();
 	if (func->SpecialInits.Size())
 	{
@@ -733,6 +999,37 @@ ADD_STAT(VM)
 	return FStringf("VM time in last 10 tics: %f ms, %d calls, peak = %f ms", added, addedc, peak);
 }
 
+//-----------------------------------------------------------------------------
+//
+// Lists the script functions that have spent the most time in the interpreter
+// while waiting for the JIT. Empty unless vm_jit_threshold is set.
+//
+//-----------------------------------------------------------------------------
+
+CCMD(vmcounters)
+{
+	TArray<VMScriptFunction *> funcs;
+	for (auto f : VMFunction::AllFunctions)
+	{
+		if (!(f->VarFlags & VARF_Native))
+		{
+			auto sfunc = static_cast<VMScriptFunction *>(f);
+			if (sfunc->CallCount + sfunc->BackEdgeCount > 0) funcs.Push(sfunc);
+		}
+	}
+	std::sort(funcs.begin(), funcs.end(), [](VMScriptFunction *a, VMScriptFunction *b)
+	{
+		return a->CallCount + a->BackEdgeCount > b->CallCount + b->BackEdgeCount;
+	});
+
+	unsigned count = argv.argc() > 1 ? (unsigned)atoi(argv[1]) : 20;
+	for (unsigned i = 0; i < funcs.Size() && i < count; i++)
+	{
+		auto sfunc = funcs[i];
+		Printf("%-48s %8u calls %8u back edges  %s\n", sfunc->PrintableName.GetChars(), sfunc->CallCount, sfunc->BackEdgeCount, sfunc->GetTierName());
+	}
+}
+
 //-----------------------------------------------------------------------------
 //
 //
@@ -2,6 +2,7 @@
 
 #include "vm.h"
 #include <csetjmp>
+#include <atomic>
 
 class VMScriptFunction;
 
@@ -252,6 +253,7 @@ struct VMFrame
 	VM_UBYTE NumRegA;
 	VM_UHALF MaxParam;
 	VM_UHALF NumParam;		// current number of parameters
+	const VMOP *PC;			// last call made by this frame, only maintained by the interpreter. Function start until the first call.
 
 	static int FrameSize(int numregd, int numregf, int numregs, int numrega, int numparam, int numextra)
 	{
@@ -437,6 +439,10 @@ void VMDisasm(FILE *out, const VMOP *code, int codesize, const VMScriptFunction
 
 extern thread_local VMFrameStack GlobalVMStack;
 
+// Set by the script profiler's timer, see vmprofiler.cpp
+extern std::atomic<bool> VMProfileSampleRequest;
+void VMProfileSample(VMScriptFunction *sfunc, const VMOP *pc);
+
 typedef std::pair<const class PType *, unsigned> FTypeAndOffset;
 
 typedef int(*JitFuncPtr)(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
@@ -470,12 +476,19 @@ public:
 	VM_UHALF MaxParam;		// Maximum number of parameters this function has on the stack at once
 	VM_UBYTE NumArgs;		// Number of arguments this function takes
 	TArray<FTypeAndOffset> SpecialInits;	// list of all contents on the extra stack which require construction and destruction
+	unsigned CallCount;		// Only counted while the function runs in the interpreter and waits for the JIT (see vm_jit_threshold)
+	unsigned BackEdgeCount;	// Backwards jumps taken by the interpreter, counted like CallCount
 
 	void InitExtra(void *addr);
 	void DestroyExtra(void *addr);
 	int AllocExtraStack(PType *type);
 	int PCToLine(const VMOP *pc);
+	const char *GetTierName() const;
+	bool IsInterpreted() const;
+	bool IsCounting() const { return ScriptCall == &VMScriptFunction::CountedScriptCall; }
 
 private:
 	static int FirstScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
+	static int CountedScriptCall(VMFunction *func, VMValue *params, int numparams, VMReturn *ret, int numret);
+	friend void JitStartEager();
 };
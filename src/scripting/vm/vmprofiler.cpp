@@ -0,0 +1,178 @@
+/*
+** vmprofiler.cpp
+** Sampling profiler for script code
+**
+** A timer thread raises VMProfileSampleRequest. Script code checks it on
+** function entry and on backwards jumps, both in the interpreter and in
+** JIT'ed code, and records the current script call stack when it is set.
+** The JIT only emits these checks while vm_jit_profile is on, so functions
+** compiled before that only show up as callers of sampled functions.
+** Time spent in native code therefore gets attributed to the next script
+** function entry or loop iteration.
+**
+** The result is written in the collapsed stack format that flame graph
+** tools read: one line per distinct stack, outermost function first,
+** followed by the number of samples.
+**
+*/
+
+#include <thread>
+#include <chrono>
+#include "vmintern.h"
+#include "jit.h"
+#include "c_dispatch.h"
+#include "i_system.h"
+#include "files.h"
+#include "c_cvars.h"
+#include "templates.h"
+
+EXTERN_CVAR(Bool, vm_jit)
+
+// Makes the JIT emit the sampling checks. Affects functions compiled afterwards,
+// so set it on the command line to profile JIT'ed code.
+CVAR(Bool, vm_jit_profile, false, 0)
+
+std::atomic<bool> VMProfileSampleRequest;
+
+static std::thread SamplerThread;
+static std::atomic<bool> SamplerRunning;
+static TMap<FString, int> Samples;
+static int NumSamples;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static FString FrameName(VMScriptFunction *sfunc, const VMOP *pc)
+{
+	int line = pc != nullptr ? sfunc->PCToLine(pc) : -1;
+	if (line < 0) return sfunc->PrintableName;
+	return FStringf("%s:%d", sfunc->PrintableName.GetChars(), line);
+}
+
+//==========================================================================
+//
+// The interpreter passes its own function and position. JIT'ed code
+// passes nothing because the JIT frames get found through the native stack.
+//
+// If interpreted and JIT'ed functions are mixed on the stack, the JIT'ed
+// ones are listed below the interpreted ones, because there is no way to
+// tell how the two stacks interleave.
+//
+//==========================================================================
+
+void VMProfileSample(VMScriptFunction *sfunc, const VMOP *pc)
+{
+	VMProfileSampleRequest = false;
+	if (!SamplerRunning) return;
+
+	TArray<FString> frames;	// innermost first
+	VMFrame *frame = GlobalVMStack.TopFrame();
+	if (sfunc != nullptr)
+	{
+		frames.Push(FrameName(sfunc, pc));
+		if (frame != nullptr) frame = frame->ParentFrame;
+	}
+	for (; frame != nullptr; frame = frame->ParentFrame)
+	{
+		if (static_cast<VMScriptFunction *>(frame->Func)->IsInterpreted())
+		{
+			frames.Push(FrameName(static_cast<VMScriptFunction *>(frame->Func), frame->PC));
+		}
+	}
+	JitCaptureScriptFrames(frames);
+	if (frames.Size() == 0) return;
+
+	FString stack;
+	for (int i = frames.Size() - 1; i >= 0; i--)
+	{
+		stack << frames[i];
+		if (i > 0) stack << ';';
+	}
+	Samples[stack]++;
+	NumSamples++;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void StopSampler()
+{
+	if (SamplerRunning)
+	{
+		SamplerRunning = false;
+		SamplerThread.join();
+	}
+	VMProfileSampleRequest = false;
+}
+
+static void WriteProfile(const char *filename)
+{
+	FileWriter *fw = FileWriter::Open(filename);
+	if (fw == nullptr)
+	{
+		Printf("Could not open %s\n", filename);
+		return;
+	}
+
+	TMap<FString, int>::Iterator it(Samples);
+	TMap<FString, int>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		fw->Printf("%s %d\n", pair->Key.GetChars(), pair->Value);
+	}
+	delete fw;
+	Printf("%d samples written to %s\n", NumSamples, filename);
+}
+
+CCMD(vmprofile)
+{
+	if (argv.argc() >= 2 && !stricmp(argv[1], "start"))
+	{
+		static bool registered;
+		if (!registered)
+		{
+			registered = true;
+			atterm(StopSampler);
+		}
+
+		// Anything faster than 10 kHz only measures the sampling itself.
+		int rate = argv.argc() >= 3 ? atoi(argv[2]) : 1000;
+		if (rate <= 0) rate = 1000;
+		rate = clamp(rate, 1, 10000);
+
+		StopSampler();
+		Samples.Clear();
+		NumSamples = 0;
+		SamplerRunning = true;
+		SamplerThread = std::thread([=]()
+		{
+			auto interval = std::chrono::microseconds(1000000 / rate);
+			while (SamplerRunning)
+			{
+				std::this_thread::sleep_for(interval);
+				VMProfileSampleRequest = true;
+			}
+		});
+		Printf("Script profiler started with %d samples per second\n", rate);
+		if (vm_jit && !vm_jit_profile)
+		{
+			Printf("vm_jit_profile is off, JIT'ed functions will not be sampled\n");
+		}
+	}
+	else if (argv.argc() >= 2 && !stricmp(argv[1], "stop"))
+	{
+		StopSampler();
+		WriteProfile(argv.argc() >= 3 ? argv[2] : "vmprofile.txt");
+	}
+	else
+	{
+		Printf("Usage: vmprofile start [samples per second, 1-10000]\n");
+		Printf("       vmprofile stop [filename]\n");
+	}
+}
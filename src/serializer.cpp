@@ -60,6 +60,7 @@
 #include "cmdlib.h"
 #include "g_levellocals.h"
 #include "utf8.h"
+#include "memarena.h"
 
 char nulspace[1024 * 1024 * 4];
 bool save_full = false;	// for testing. Should be removed afterward.
@@ -140,6 +141,298 @@ struct FJSONObject
 	}
 };
 
+//==========================================================================
+//
+// Binary encoding of the same event stream the JSON writers get.
+// The reader turns it back into a rapidjson document, so everything above
+// the writer and reader is identical for both formats.
+//
+// Keys are interned: the first occurrence of a key is written out in full,
+// every later one only as an index into the list of keys seen so far.
+// Integers are stored as variable length numbers.
+//
+//==========================================================================
+
+static const char BinaryMagic[4] = { 'Z', 'S', 'B', 1 };
+
+enum EBinaryTag
+{
+	BT_Null,
+	BT_False,
+	BT_True,
+	BT_Int,
+	BT_Uint,
+	BT_Int64,
+	BT_Uint64,
+	BT_Double,
+	BT_String,
+	BT_StartObject,
+	BT_EndObject,
+	BT_StartArray,
+	BT_EndArray,
+	BT_NewKey,
+	BT_Key,
+};
+
+struct FBinaryWriter
+{
+	struct FKeySlot
+	{
+		unsigned hash;
+		int index;
+	};
+
+	rapidjson::StringBuffer &mOut;
+	TArray<const char *> mKeyNames;		// points into mKeyStorage
+	TArray<FKeySlot> mKeySlots;
+	FMemArena mKeyStorage;
+
+	FBinaryWriter(rapidjson::StringBuffer &out) : mOut(out)
+	{
+		mKeySlots.Resize(1024);
+		for (auto &k : mKeySlots) k.index = -1;
+		memcpy(mOut.Push(sizeof(BinaryMagic)), BinaryMagic, sizeof(BinaryMagic));
+	}
+
+	void Tag(int tag)
+	{
+		mOut.Put((char)tag);
+	}
+
+	void Varint(uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			mOut.Put(char(v | 0x80));
+			v >>= 7;
+		}
+		mOut.Put(char(v));
+	}
+
+	void Bytes(const char *k, size_t len)
+	{
+		Varint(len);
+		if (len > 0) memcpy(mOut.Push(len), k, len);
+	}
+
+	void Grow()
+	{
+		TArray<FKeySlot> old = std::move(mKeySlots);
+		mKeySlots.Resize(old.Size() * 2);
+		for (auto &k : mKeySlots) k.index = -1;
+		for (auto &k : old)
+		{
+			if (k.index < 0) continue;
+			unsigned i = k.hash & (mKeySlots.Size() - 1);
+			while (mKeySlots[i].index >= 0) i = (i + 1) & (mKeySlots.Size() - 1);
+			mKeySlots[i] = k;
+		}
+	}
+
+	void Key(const char *k)
+	{
+		size_t len = strlen(k);
+		unsigned hash = SuperFastHash(k, len);
+		unsigned i = hash & (mKeySlots.Size() - 1);
+		while (mKeySlots[i].index >= 0)
+		{
+			if (mKeySlots[i].hash == hash && !strcmp(mKeyNames[mKeySlots[i].index], k))
+			{
+				Tag(BT_Key);
+				Varint(mKeySlots[i].index);
+				return;
+			}
+			i = (i + 1) & (mKeySlots.Size() - 1);
+		}
+		char *copy = (char *)mKeyStorage.Alloc(len + 1);
+		memcpy(copy, k, len + 1);
+		mKeySlots[i] = { hash, (int)mKeyNames.Push(copy) };
+		if (mKeyNames.Size() * 2 > mKeySlots.Size()) Grow();
+		Tag(BT_NewKey);
+		Bytes(k, len);
+	}
+
+	void StartObject() { Tag(BT_StartObject); }
+	void EndObject() { Tag(BT_EndObject); }
+	void StartArray() { Tag(BT_StartArray); }
+	void EndArray() { Tag(BT_EndArray); }
+	void Null() { Tag(BT_Null); }
+	void Bool(bool k) { Tag(k ? BT_True : BT_False); }
+	void String(const char *k) { Tag(BT_String); Bytes(k, strlen(k)); }
+	void Int(int32_t k) { Tag(BT_Int); Varint((uint32_t(k) << 1) ^ uint32_t(k >> 31)); }
+	void Uint(uint32_t k) { Tag(BT_Uint); Varint(k); }
+	void Int64(int64_t k) { Tag(BT_Int64); Varint((uint64_t(k) << 1) ^ uint64_t(k >> 63)); }
+	void Uint64(uint64_t k) { Tag(BT_Uint64); Varint(k); }
+
+	void Double(double k)
+	{
+		uint64_t bits;
+		memcpy(&bits, &k, sizeof(bits));
+		Tag(BT_Double);
+		char *p = mOut.Push(8);
+		for (int i = 0; i < 8; i++) p[i] = char(bits >> (i * 8));
+	}
+};
+
+struct FBinaryReader
+{
+	struct FContainer
+	{
+		unsigned count;
+		bool isObject;
+	};
+
+	const uint8_t *p, *end;
+	TArray<std::pair<const char *, unsigned>> mKeyNames;
+	TArray<FContainer> mStack;
+
+	FBinaryReader(const char *buffer, size_t length)
+	{
+		p = (const uint8_t *)buffer;
+		end = p + length;
+	}
+
+	static bool IsBinary(const char *buffer, size_t length)
+	{
+		return length >= sizeof(BinaryMagic) && !memcmp(buffer, BinaryMagic, sizeof(BinaryMagic));
+	}
+
+	bool Varint(uint64_t &v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7)
+		{
+			uint8_t b = *p++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	bool Bytes(const char *&str, unsigned &len)
+	{
+		uint64_t l;
+		if (!Varint(l) || l > uint64_t(end - p)) return false;
+		str = (const char *)p;
+		len = unsigned(l);
+		p += l;
+		return true;
+	}
+
+	void Value()
+	{
+		if (mStack.Size() > 0 && !mStack.Last().isObject) mStack.Last().count++;
+	}
+
+	template<class Handler>
+	bool operator()(Handler &h)
+	{
+		p += sizeof(BinaryMagic);
+		while (p < end)
+		{
+			uint64_t v;
+			const char *str;
+			unsigned len;
+
+			switch (*p++)
+			{
+			case BT_Null:
+				Value();
+				h.Null();
+				break;
+
+			case BT_False:
+			case BT_True:
+				Value();
+				h.Bool(p[-1] == BT_True);
+				break;
+
+			case BT_Int:
+				if (!Varint(v)) return false;
+				Value();
+				h.Int(int32_t(uint32_t(v >> 1) ^ (0 - uint32_t(v & 1))));
+				break;
+
+			case BT_Uint:
+				if (!Varint(v)) return false;
+				Value();
+				h.Uint(uint32_t(v));
+				break;
+
+			case BT_Int64:
+				if (!Varint(v)) return false;
+				Value();
+				h.Int64(int64_t((v >> 1) ^ (0 - (v & 1))));
+				break;
+
+			case BT_Uint64:
+				if (!Varint(v)) return false;
+				Value();
+				h.Uint64(v);
+				break;
+
+			case BT_Double:
+			{
+				if (end - p < 8) return false;
+				uint64_t bits = 0;
+				for (int i = 0; i < 8; i++) bits |= uint64_t(p[i]) << (i * 8);
+				p += 8;
+				double d;
+				memcpy(&d, &bits, sizeof(d));
+				Value();
+				h.Double(d);
+				break;
+			}
+
+			case BT_String:
+				if (!Bytes(str, len)) return false;
+				Value();
+				h.String(str, len, true);
+				break;
+
+			case BT_StartObject:
+			case BT_StartArray:
+				Value();
+				mStack.Push({ 0, p[-1] == BT_StartObject });
+				if (mStack.Last().isObject) h.StartObject();
+				else h.StartArray();
+				break;
+
+			case BT_EndObject:
+				if (mStack.Size() == 0 || !mStack.Last().isObject) return false;
+				h.EndObject(mStack.Last().count);
+				mStack.Pop();
+				break;
+
+			case BT_EndArray:
+				if (mStack.Size() == 0 || mStack.Last().isObject) return false;
+				h.EndArray(mStack.Last().count);
+				mStack.Pop();
+				break;
+
+			case BT_NewKey:
+				if (!Bytes(str, len)) return false;
+				mKeyNames.Push({ str, len });
+				if (mStack.Size() == 0 || !mStack.Last().isObject) return false;
+				mStack.Last().count++;
+				h.Key(str, len, true);
+				break;
+
+			case BT_Key:
+				if (!Varint(v) || v >= mKeyNames.Size()) return false;
+				if (mStack.Size() == 0 || !mStack.Last().isObject) return false;
+				mStack.Last().count++;
+				h.Key(mKeyNames[unsigned(v)].first, mKeyNames[unsigned(v)].second, true);
+				break;
+
+			default:
+				return false;
+			}
+		}
+		return mStack.Size() == 0;
+	}
+};
+
 //==========================================================================
 //
 // some wrapper stuff to keep the RapidJSON dependencies out of the global headers.
@@ -154,21 +447,27 @@ struct FWriter
 
 	Writer *mWriter1;
 	PrettyWriter *mWriter2;
+	FBinaryWriter *mWriter3;
 	TArray<bool> mInObject;
 	rapidjson::StringBuffer mOutString;
 	TArray<DObject *> mDObjects;
 	TMap<DObject *, int> mObjectMap;
 	
-	FWriter(bool pretty)
+	FWriter(bool pretty, bool binary = false)
 	{
-		if (!pretty)
+		mWriter1 = nullptr;
+		mWriter2 = nullptr;
+		mWriter3 = nullptr;
+		if (binary)
+		{
+			mWriter3 = new FBinaryWriter(mOutString);
+		}
+		else if (!pretty)
 		{
 			mWriter1 = new Writer(mOutString);
-			mWriter2 = nullptr;
 		}
 		else
 		{
-			mWriter1 = nullptr;
 			mWriter2 = new PrettyWriter(mOutString);
 		}
 	}
@@ -177,6 +476,7 @@ struct FWriter
 	{
 		if (mWriter1) delete mWriter1;
 		if (mWriter2) delete mWriter2;
+		if (mWriter3) delete mWriter3;
 	}
 
 
@@ -189,36 +489,42 @@ struct FWriter
 	{
 		if (mWriter1) mWriter1->StartObject();
 		else if (mWriter2) mWriter2->StartObject();
+		else if (mWriter3) mWriter3->StartObject();
 	}
 
 	void EndObject()
 	{
 		if (mWriter1) mWriter1->EndObject();
 		else if (mWriter2) mWriter2->EndObject();
+		else if (mWriter3) mWriter3->EndObject();
 	}
 
 	void StartArray()
 	{
 		if (mWriter1) mWriter1->StartArray();
 		else if (mWriter2) mWriter2->StartArray();
+		else if (mWriter3) mWriter3->StartArray();
 	}
 
 	void EndArray()
 	{
 		if (mWriter1) mWriter1->EndArray();
 		else if (mWriter2) mWriter2->EndArray();
+		else if (mWriter3) mWriter3->EndArray();
 	}
 
 	void Key(const char *k)
 	{
 		if (mWriter1) mWriter1->Key(k);
 		else if (mWriter2) mWriter2->Key(k);
+		else if (mWriter3) mWriter3->Key(k);
 	}
 
 	void Null()
 	{
 		if (mWriter1) mWriter1->Null();
 		else if (mWriter2) mWriter2->Null();
+		else if (mWriter3) mWriter3->Null();
 	}
 
 	void StringU(const char *k, bool encode)
@@ -226,6 +532,7 @@ struct FWriter
 		if (encode) k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void String(const char *k)
@@ -233,6 +540,7 @@ struct FWriter
 		k = StringToUnicode(k);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void String(const char *k, int size)
@@ -240,36 +548,42 @@ struct FWriter
 		k = StringToUnicode(k, size);
 		if (mWriter1) mWriter1->String(k);
 		else if (mWriter2) mWriter2->String(k);
+		else if (mWriter3) mWriter3->String(k);
 	}
 
 	void Bool(bool k)
 	{
 		if (mWriter1) mWriter1->Bool(k);
 		else if (mWriter2) mWriter2->Bool(k);
+		else if (mWriter3) mWriter3->Bool(k);
 	}
 
 	void Int(int32_t k)
 	{
 		if (mWriter1) mWriter1->Int(k);
 		else if (mWriter2) mWriter2->Int(k);
+		else if (mWriter3) mWriter3->Int(k);
 	}
 
 	void Int64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Int64(k);
 		else if (mWriter2) mWriter2->Int64(k);
+		else if (mWriter3) mWriter3->Int64(k);
 	}
 
 	void Uint(uint32_t k)
 	{
 		if (mWriter1) mWriter1->Uint(k);
 		else if (mWriter2) mWriter2->Uint(k);
+		else if (mWriter3) mWriter3->Uint(k);
 	}
 
 	void Uint64(int64_t k)
 	{
 		if (mWriter1) mWriter1->Uint64(k);
 		else if (mWriter2) mWriter2->Uint64(k);
+		else if (mWriter3) mWriter3->Uint64(k);
 	}
 
 	void Double(double k)
@@ -282,6 +596,10 @@ struct FWriter
 		{
 			mWriter2->Double(k);
 		}
+		else if (mWriter3)
+		{
+			mWriter3->Double(k);
+		}
 	}
 
 };
@@ -303,8 +621,15 @@ struct FReader
 
 	FReader(const char *buffer, size_t length)
 	{
-		rapidjson::Document doc;
-		mDoc.Parse(buffer, length);
+		if (FBinaryReader::IsBinary(buffer, length))
+		{
+			FBinaryReader reader(buffer, length);
+			mDoc.Populate(reader);
+		}
+		else
+		{
+			mDoc.Parse(buffer, length);
+		}
 		mObjects.Push(FJSONObject(&mDoc));
 		memset(mPlayers, -1, sizeof(mPlayers));
 	}
@@ -361,6 +686,22 @@ bool FSerializer::OpenWriter(bool pretty)
 //
 //==========================================================================
 
+bool FSerializer::OpenBinaryWriter()
+{
+	if (w != nullptr || r != nullptr) return false;
+
+	mErrors = 0;
+	w = new FWriter(false, true);
+	BeginObject(nullptr);
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 bool FSerializer::OpenReader(const char *buffer, size_t length)
 {
 	if (w != nullptr || r != nullptr) return false;
@@ -1039,26 +1380,19 @@ const char *FSerializer::GetOutput(unsigned *len)
 
 //==========================================================================
 //
-//
+// Deflates buff.mSize bytes from data into a new buffer in the raw
+// zip-compatible form FCompressedBuffer expects.
 //
 //==========================================================================
 
-FCompressedBuffer FSerializer::GetCompressedOutput()
+static bool CompressData(FCompressedBuffer &buff, const char *data)
 {
-	if (isReading()) return{ 0,0,0,0,0,nullptr };
-	FCompressedBuffer buff;
-	WriteObjects();
-	EndObject();
-	buff.mSize = (unsigned)w->mOutString.GetSize();
-	buff.mZipFlags = 0;
-	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
-
 	uint8_t *compressbuf = new uint8_t[buff.mSize+1];
 
 	z_stream stream;
 	int err;
 
-	stream.next_in = (Bytef *)w->mOutString.GetString();
+	stream.next_in = (Bytef *)data;
 	stream.avail_in = buff.mSize;
 	stream.next_out = (Bytef*)compressbuf;
 	stream.avail_out = buff.mSize;
@@ -1070,34 +1404,101 @@ FCompressedBuffer FSerializer::GetCompressedOutput()
 	err = deflateInit2(&stream, 8, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
 	if (err != Z_OK)
 	{
-		goto error;
+		delete[] compressbuf;
+		return false;
 	}
 
 	err = deflate(&stream, Z_FINISH);
 	if (err != Z_STREAM_END) 
 	{
 		deflateEnd(&stream);
-		goto error;
+		delete[] compressbuf;
+		return false;
 	}
-	buff.mCompressedSize = stream.total_out;
 
 	err = deflateEnd(&stream);
-	if (err == Z_OK)
+	if (err != Z_OK)
 	{
-		buff.mBuffer = new char[buff.mCompressedSize];
-		buff.mMethod = METHOD_DEFLATE;
-		memcpy(buff.mBuffer, compressbuf, buff.mCompressedSize);
 		delete[] compressbuf;
-		return buff;
+		return false;
 	}
+	buff.mCompressedSize = stream.total_out;
+	buff.mBuffer = new char[buff.mCompressedSize];
+	buff.mMethod = METHOD_DEFLATE;
+	memcpy(buff.mBuffer, compressbuf, buff.mCompressedSize);
+	delete[] compressbuf;
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FCompressedBuffer FSerializer::GetCompressedOutput()
+{
+	if (isReading()) return{ 0,0,0,0,0,nullptr };
+	FCompressedBuffer buff;
+	WriteObjects();
+	EndObject();
+	buff.mSize = (unsigned)w->mOutString.GetSize();
+	buff.mZipFlags = 0;
+	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
+
+	if (!CompressData(buff, w->mOutString.GetString()))
+	{
+		buff.mBuffer = new char[buff.mSize + 1];
+		memcpy(buff.mBuffer, w->mOutString.GetString(), buff.mSize + 1);
+		buff.mCompressedSize = buff.mSize;
+		buff.mMethod = METHOD_STORED;
+	}
+	return buff;
+}
 
-error:
-	memcpy(compressbuf, w->mOutString.GetString(), buff.mSize + 1);
-	buff.mCompressedSize = buff.mSize;
+//==========================================================================
+//
+// Same as above but leaves the data uncompressed so that the deflating
+// can be done later with DeflateBuffer, e.g. on another thread.
+//
+//==========================================================================
+
+FCompressedBuffer FSerializer::GetStoredOutput()
+{
+	if (isReading()) return{ 0,0,0,0,0,nullptr };
+	FCompressedBuffer buff;
+	WriteObjects();
+	EndObject();
+	buff.mSize = buff.mCompressedSize = (unsigned)w->mOutString.GetSize();
 	buff.mMethod = METHOD_STORED;
+	buff.mZipFlags = 0;
+	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
+	buff.mBuffer = new char[buff.mSize + 1];
+	memcpy(buff.mBuffer, w->mOutString.GetString(), buff.mSize + 1);
 	return buff;
 }
 
+//==========================================================================
+//
+// Converts a stored buffer into a deflated one. This does not touch any
+// global state so it is safe to call from a worker thread. If the data
+// does not compress the buffer is left alone.
+//
+//==========================================================================
+
+bool DeflateBuffer(FCompressedBuffer &buff)
+{
+	if (buff.mMethod != METHOD_STORED || buff.mBuffer == nullptr) return false;
+
+	char *stored = buff.mBuffer;
+	if (!CompressData(buff, stored))
+	{
+		return false;
+	}
+	delete[] stored;
+	return true;
+}
+
 //==========================================================================
 //
 //
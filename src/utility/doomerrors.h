@@ -82,6 +82,17 @@ protected:
 	char m_Message[MAX_ERRORTEXT];
 };
 
+// Thrown to leave the game through the regular shutdown, unwinding the
+// main loop instead of calling exit() from somewhere inside it.
+class CExitEvent : public std::exception
+{
+	int m_reason;
+public:
+	CExitEvent(int reason) { m_reason = reason; }
+	char const *what() const noexcept override { return "The game wants to exit"; }
+	int Reason() const { return m_reason; }
+};
+
 class CNoRunExit : public std::runtime_error
 {
 public:
@@ -33,6 +33,17 @@
 **
 */
 
+#include <climits>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "files.h"
 #include "templates.h"
 
@@ -313,6 +324,77 @@ char *MemoryReader::Gets(char *strbuf, int len)
 	return strbuf;
 }
 
+//==========================================================================
+//
+// MappedFileReader
+//
+// reads data from a memory mapping of an entire file.
+// The mapping is copy-on-write so that code which modifies a lump's
+// cache in place does not change the file on disk.
+//
+//==========================================================================
+
+class MappedFileReader : public MemoryReader
+{
+#ifdef _WIN32
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+#endif
+
+public:
+	MappedFileReader()
+	{}
+
+	~MappedFileReader()
+	{
+#ifdef _WIN32
+		if (bufptr != nullptr) UnmapViewOfFile(bufptr);
+		if (Mapping != nullptr) CloseHandle(Mapping);
+		if (File != INVALID_HANDLE_VALUE) CloseHandle(File);
+#else
+		if (bufptr != nullptr) munmap(const_cast<char*>(bufptr), Length);
+#endif
+	}
+
+	bool Open(const char *filename)
+	{
+#ifdef _WIN32
+		auto widename = WideString(filename);
+		File = CreateFileW(widename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (File == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(File, &size) || size.QuadPart <= 0 || size.QuadPart > LONG_MAX) return false;
+
+		Mapping = CreateFileMappingW(File, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (Mapping == nullptr) return false;
+
+		bufptr = (const char *)MapViewOfFile(Mapping, FILE_MAP_COPY, 0, 0, 0);
+		if (bufptr == nullptr) return false;
+		Length = (long)size.QuadPart;
+#else
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 || info.st_size > LONG_MAX)
+		{
+			close(fd);
+			return false;
+		}
+
+		void *map = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);	// the mapping stays valid after the descriptor is closed.
+		if (map == MAP_FAILED) return false;
+
+		bufptr = (const char *)map;
+		Length = (long)info.st_size;
+#endif
+		FilePos = 0;
+		return true;
+	}
+};
+
 //==========================================================================
 //
 // MemoryArrayReader
@@ -377,6 +459,19 @@ bool FileReader::OpenFilePart(FileReader &parent, FileReader::Size start, FileRe
 	return true;
 }
 
+bool FileReader::OpenMappedFile(const char *filename)
+{
+	auto reader = new MappedFileReader;
+	if (!reader->Open(filename))
+	{
+		delete reader;
+		return false;
+	}
+	Close();
+	mReader = reader;
+	return true;
+}
+
 bool FileReader::OpenMemory(const void *mem, FileReader::Size length)
 {
 	Close();
@@ -164,6 +164,7 @@ public:
 
 	bool OpenFile(const char *filename, Size start = 0, Size length = -1);
 	bool OpenFilePart(FileReader &parent, Size start, Size length);
+	bool OpenMappedFile(const char *filename);	// maps the entire file into memory so that GetBuffer can be used.
 	bool OpenMemory(const void *mem, Size length);	// read directly from the buffer
 	bool OpenMemoryArray(const void *mem, Size length);	// read from a copy of the buffer.
 	bool OpenMemoryArray(std::function<bool(TArray<uint8_t>&)> getter);	// read contents to a buffer and return a reader to it
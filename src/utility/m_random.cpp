@@ -398,6 +398,45 @@ FRandom *FRandom::StaticFindRNG (const char *name)
 	return probe;
 }
 
+//==========================================================================
+//
+// FRandom :: StaticGetRNGCRC
+//
+// Returns the CRC StaticFindRNG finds this RNG by, or 0 if it cannot be
+// found that way. Together with StaticFindRNGByCRC this allows storing
+// references to RNGs outside the running program.
+//
+//==========================================================================
+
+uint32_t FRandom::StaticGetRNGCRC(const FRandom *rng)
+{
+	for (FRandom *probe = RNGList; probe != NULL; probe = probe->Next)
+	{
+		if (probe == rng)
+		{
+			return StaticFindRNGByCRC(probe->NameCRC) == rng ? rng->NameCRC : 0;
+		}
+	}
+	return 0;
+}
+
+//==========================================================================
+//
+// FRandom :: StaticFindRNGByCRC
+//
+// Like StaticFindRNG but never creates a new RNG.
+//
+//==========================================================================
+
+FRandom *FRandom::StaticFindRNGByCRC(uint32_t crc)
+{
+	for (FRandom *probe = RNGList; probe != NULL && probe->NameCRC <= crc; probe = probe->Next)
+	{
+		if (probe->NameCRC == crc) return probe;
+	}
+	return NULL;
+}
+
 //==========================================================================
 //
 // FRandom :: StaticPrintSeeds
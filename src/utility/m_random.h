@@ -177,6 +177,8 @@ public:
 	static void StaticReadRNGState (FSerializer &arc);
 	static void StaticWriteRNGState (FSerializer &file);
 	static FRandom *StaticFindRNG(const char *name);
+	static uint32_t StaticGetRNGCRC(const FRandom *rng);
+	static FRandom *StaticFindRNGByCRC(uint32_t crc);
 
 #ifndef NDEBUG
 	static void StaticPrintSeeds ();
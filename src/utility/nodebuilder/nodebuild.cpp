@@ -43,11 +43,18 @@
 
 #include "doomdata.h"
 #include "nodebuild.h"
+#include "workerpool.h"
 
 const int MaxSegs = 64;
 const int SplitCost = 8;
 const int AAPreference = 16;
 
+// Splitters are only scored in parallel if there are enough of them and
+// they have to be tested against enough segs to be worth the handoff.
+const unsigned int MinParallelSplitters = 8;
+const uint64_t MinParallelWork = 1 << 16;
+
+
 #if 0
 #define D(x) x
 #else
@@ -104,8 +111,10 @@ void FNodeBuilder::Clear()
 	SegList.Clear();
 	PlaneChecked.Clear();
 	Planes.Clear();
-	Touched.Clear();
-	Colinear.Clear();
+	Scratch.Touched.Clear();
+	Scratch.Colinear.Clear();
+	Candidates.Clear();
+	CandidateScores.Clear();
 	SplitSharers.Clear();
 	if (VertexMap == NULL)
 	{
@@ -428,7 +437,7 @@ bool FNodeBuilder::ShoveSegBehind (uint32_t set, node_t &node, uint32_t seg, uin
 		node.dx = -node.dx;
 		node.dy = -node.dy;
 	}
-	return Heuristic (node, set, false) > 0;
+	return Heuristic (node, set, false, Scratch) > 0;
 }
 
 // Splitters are chosen to coincide with segs in the given set. To reduce the
@@ -444,6 +453,7 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 	int bestvalue;
 	uint32_t bestseg;
 	uint32_t seg;
+	unsigned int setsize;
 	bool nosplitters = false;
 
 	bestvalue = 0;
@@ -451,11 +461,15 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 
 	seg = set;
 	stepleft = 0;
+	setsize = 0;
 
 	memset (&PlaneChecked[0], 0, PlaneChecked.Size());
+	Candidates.Clear ();
 
 	D(Printf (PRINT_LOG, "Processing set %d\n", set));
 
+	// Which segs get tried as splitters only depends on the set itself, not
+	// on how well the splitters score, so collect them first.
 	while (seg != UINT_MAX)
 	{
 		FPrivSeg *pseg = &Segs[seg];
@@ -473,26 +487,33 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 				}
 
 				stepleft = step;
-				SetNodeFromSeg (node, pseg);
-
-				int value = Heuristic (node, set, nosplit);
-
-				D(Printf (PRINT_LOG, "Seg %5d, ld %d (%5d,%5d)-(%5d,%5d) scores %d\n", seg, Segs[seg].linedef, node.x>>16, node.y>>16,
-					(node.x+node.dx)>>16, (node.y+node.dy)>>16, value));
-
-				if (value > bestvalue)
-				{
-					bestvalue = value;
-					bestseg = seg;
-				}
-				else if (value < 0)
-				{
-					nosplitters = true;
-				}
+				Candidates.Push (seg);
 			}
 		}
 
 		seg = pseg->next;
+		setsize++;
+	}
+
+	ScoreSplitters (set, nosplit, setsize);
+
+	// Pick the best one in the order the segs are linked, so that ties
+	// are resolved exactly as if they had been scored one after another.
+	for (unsigned int i = 0; i < Candidates.Size(); ++i)
+	{
+		int value = CandidateScores[i];
+
+		D(Printf (PRINT_LOG, "Seg %5d, ld %d scores %d\n", Candidates[i], Segs[Candidates[i]].linedef, value));
+
+		if (value > bestvalue)
+		{
+			bestvalue = value;
+			bestseg = Candidates[i];
+		}
+		else if (value < 0)
+		{
+			nosplitters = true;
+		}
 	}
 
 	if (bestseg == UINT_MAX)
@@ -508,13 +529,53 @@ int FNodeBuilder::SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg
 	return 1;
 }
 
+// Fills CandidateScores with the Heuristic value of every seg in Candidates.
+// Scoring only reads the segs and vertices, so for large sets the candidates
+// are divided among worker threads, each with its own scratch space. Near the
+// top of the tree of a big map this is where nearly all the time goes.
+void FNodeBuilder::ScoreSplitters (uint32_t set, bool nosplit, unsigned int setsize)
+{
+	unsigned int numcandidates = Candidates.Size();
+	CandidateScores.Resize (numcandidates);
+
+	auto scoreRange = [=](unsigned int first, unsigned int last, FSplitScratch &scratch)
+	{
+		node_t node;
+		for (unsigned int i = first; i < last; ++i)
+		{
+			SetNodeFromSeg (node, &Segs[Candidates[i]]);
+			CandidateScores[i] = Heuristic (node, set, nosplit, scratch);
+		}
+	};
+
+	if (numcandidates < MinParallelSplitters || uint64_t(numcandidates) * setsize < MinParallelWork)
+	{
+		scoreRange (0, numcandidates, Scratch);
+		return;
+	}
+
+	auto &pool = WorkerPool();
+	unsigned int numtasks = MIN<unsigned int>(pool.size() + 1, numcandidates);
+	TArray<FSplitScratch> scratch (numtasks, true);
+	std::vector<std::future<void>> tasks;
+	for (unsigned int t = 1; t < numtasks; ++t)
+	{
+		unsigned int first = numcandidates * t / numtasks;
+		unsigned int last = numcandidates * (t + 1) / numtasks;
+		FSplitScratch *taskscratch = &scratch[t];
+		tasks.push_back (pool.push ([=](int) { scoreRange (first, last, *taskscratch); }));
+	}
+	scoreRange (0, numcandidates / numtasks, scratch[0]);
+	WorkerPoolWait (tasks);
+}
+
 // Given a splitter (node), returns a score based on how "good" the resulting
 // split in a set of segs is. Higher scores are better. -1 means this splitter
 // splits something it shouldn't and will only be returned if honorNoSplit is
 // true. A score of 0 means that the splitter does not split any of the segs
 // in the set.
 
-int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
+int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit, FSplitScratch &scratch)
 {
 	// Set the initial score above 0 so that near vertex anti-weighting is less likely to produce a negative score.
 	int score = 1000000;
@@ -529,8 +590,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	unsigned int max, m2, p, q;
 	double frac;
 
-	Touched.Clear ();
-	Colinear.Clear ();
+	scratch.Touched.Clear ();
+	scratch.Colinear.Clear ();
 
 	while (i != UINT_MAX)
 	{
@@ -556,32 +617,32 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 			{
 				if ((sidev[0] | sidev[1]) != 0)
 				{
-					max = Touched.Size();
+					max = scratch.Touched.Size();
 					for (p = 0; p < max; ++p)
 					{
-						if (Touched[p] == test->loopnum)
+						if (scratch.Touched[p] == test->loopnum)
 						{
 							break;
 						}
 					}
 					if (p == max)
 					{
-						Touched.Push (test->loopnum);
+						scratch.Touched.Push (test->loopnum);
 					}
 				}
 				else
 				{
-					max = Colinear.Size();
+					max = scratch.Colinear.Size();
 					for (p = 0; p < max; ++p)
 					{
-						if (Colinear[p] == test->loopnum)
+						if (scratch.Colinear[p] == test->loopnum)
 						{
 							break;
 						}
 					}
 					if (p == max)
 					{
-						Colinear.Push (test->loopnum);
+						scratch.Colinear.Push (test->loopnum);
 					}
 				}
 			}
@@ -698,8 +759,8 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 	// seg of that sector must be crossing the container's corner and does not
 	// actually split the container.
 
-	max = Touched.Size ();
-	m2 = Colinear.Size ();
+	max = scratch.Touched.Size ();
+	m2 = scratch.Colinear.Size ();
 
 	// If honorNoSplit is false, then both these lists will be empty.
 
@@ -712,10 +773,10 @@ int FNodeBuilder::Heuristic (node_t &node, uint32_t set, bool honorNoSplit)
 
 	for (p = 0; p < max; ++p)
 	{
-		int look = Touched[p];
+		int look = scratch.Touched[p];
 		for (q = 0; q < m2; ++q)
 		{
-			if (look == Colinear[q])
+			if (look == scratch.Colinear[q])
 			{
 				break;
 			}
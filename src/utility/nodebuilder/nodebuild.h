@@ -145,6 +145,14 @@ class FNodeBuilder
 		uint32_t Partner;
 	};
 
+	// Working storage for Heuristic, so that several splitters can be
+	// scored at once.
+	struct FSplitScratch
+	{
+		TArray<int> Touched;	// Loops a splitter touches on a vertex
+		TArray<int> Colinear;	// Loops with edges colinear to a splitter
+	};
+
 
 	// Like a blockmap, but for vertices instead of lines
 	class IVertexMap
@@ -265,8 +273,9 @@ private:
 	TArray<uint8_t> PlaneChecked;
 	TArray<FSimpleLine> Planes;
 
-	TArray<int> Touched;	// Loops a splitter touches on a vertex
-	TArray<int> Colinear;	// Loops with edges colinear to a splitter
+	FSplitScratch Scratch;
+	TArray<uint32_t> Candidates;	// Splitters considered by SelectSplitter
+	TArray<int> CandidateScores;
 	FEventTree Events;		// Vertices intersected by the current splitter
 
 	TArray<FSplitSharer> SplitSharers;	// Segs colinear with the current splitter
@@ -297,7 +306,8 @@ private:
 	bool ShoveSegBehind (uint32_t set, node_t &node, uint32_t seg, uint32_t mate);	int SelectSplitter (uint32_t set, node_t &node, uint32_t &splitseg, int step, bool nosplit);
 	void SplitSegs (uint32_t set, node_t &node, uint32_t splitseg, uint32_t &outset0, uint32_t &outset1, unsigned int &count0, unsigned int &count1);
 	uint32_t SplitSeg (uint32_t segnum, int splitvert, int v1InFront);
-	int Heuristic (node_t &node, uint32_t set, bool honorNoSplit);
+	void ScoreSplitters (uint32_t set, bool nosplit, unsigned int setsize);
+	int Heuristic (node_t &node, uint32_t set, bool honorNoSplit, FSplitScratch &scratch);
 
 	// Returns:
 	//	0 = seg is in front
@@ -68,6 +68,8 @@
 #include "templates.h"
 #include "doomstat.h"
 #include "v_text.h"
+#include "c_cvars.h"
+#include "m_crc32.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -298,6 +300,10 @@ void FScanner::OpenString (const char *name, FString buffer)
 //
 //==========================================================================
 
+EXTERN_CVAR(Bool, vm_cachescripts)
+
+TArray<FScanner::FOpenedLump> FScanner::OpenedLumps;
+
 void FScanner :: OpenLumpNum (int lump)
 {
 	Close ();
@@ -307,6 +313,11 @@ void FScanner :: OpenLumpNum (int lump)
 	}
 	ScriptName = Wads.GetLumpFullPath(lump);
 	LumpNum = lump;
+	if (vm_cachescripts)
+	{
+		unsigned len = (unsigned)ScriptBuffer.Len();
+		OpenedLumps.Push({ lump, len, CalcCRC32((const uint8_t *)ScriptBuffer.GetChars(), len) });
+	}
 	PrepareScript ();
 }
 
@@ -1145,8 +1156,9 @@ void FScanner::CheckOpen()
 //==========================================================================
 int FScriptPosition::ErrorCounter;
 int FScriptPosition::WarnCounter;
-bool FScriptPosition::StrictErrors;	// makes all OPTERROR messages real errors.
+thread_local bool FScriptPosition::StrictErrors;	// makes all OPTERROR messages real errors.
 bool FScriptPosition::errorout;		// call I_Error instead of printing the error itself.
+thread_local FScriptMessageBuffer *FScriptPosition::Capture;
 
 FScriptPosition::FScriptPosition(const FScriptPosition &other)
 {
@@ -1219,13 +1231,15 @@ void FScriptPosition::Message (int severity, const char *message, ...) const
 	case MSG_WARNING:
 	case MSG_DEBUGWARN:
 	case MSG_DEBUGERROR:	// This is intentionally not being printed as an 'error', the difference to MSG_DEBUGWARN is only the severity level at which it gets triggered.
-		WarnCounter++;
+		if (Capture != nullptr) Capture->Warnings++;
+		else WarnCounter++;
 		type = "warning";
 		color = TEXTCOLOR_ORANGE;
 		break;
 
 	case MSG_ERROR:
-		ErrorCounter++;
+		if (Capture != nullptr) Capture->Errors++;
+		else ErrorCounter++;
 		type = "error";
 		color = TEXTCOLOR_RED;
 		break;
@@ -1248,8 +1262,37 @@ void FScriptPosition::Message (int severity, const char *message, ...) const
 			FileName.GetChars(), ScriptLine, composed.GetChars());
 		return;
 	}
+	if (Capture != nullptr)
+	{
+		FString text;
+		text.Format("%sScript %s, \"%s\" line %d:\n%s%s\n",
+			color, type, FileName.GetChars(), ScriptLine, color, composed.GetChars());
+		Capture->Messages.Push({ level, text });
+		return;
+	}
 	Printf (level, "%sScript %s, \"%s\" line %d:\n%s%s\n",
 		color, type, FileName.GetChars(), ScriptLine, color, composed.GetChars());
 }
 
+//==========================================================================
+//
+// FScriptMessageBuffer::Flush
+//
+// Prints everything that was captured and adds it to the global counters.
+// Must be called on the main thread.
+//
+//==========================================================================
+
+void FScriptMessageBuffer::Flush()
+{
+	for (auto &msg : Messages)
+	{
+		Printf(msg.PrintLevel, "%s", msg.Text.GetChars());
+	}
+	FScriptPosition::ErrorCounter += Errors;
+	FScriptPosition::WarnCounter += Warnings;
+	Messages.Clear();
+	Errors = Warnings = 0;
+}
+
 
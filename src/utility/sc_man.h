@@ -94,6 +94,18 @@ public:
 	int LumpNum;
 	FString ScriptName;
 
+	// All lumps opened as scripts since the lump directory was last built,
+	// for validating caches of data compiled from them. The contents are
+	// checksummed while they are in memory anyway, so the cache doesn't
+	// have to read them again. Only recorded while vm_cachescripts is on.
+	struct FOpenedLump
+	{
+		int Lump;
+		uint32_t Length;
+		uint32_t CRC;
+	};
+	static TArray<FOpenedLump> OpenedLumps;
+
 protected:
 	void PrepareScript();
 	void CheckOpen();
@@ -158,12 +170,30 @@ enum
 //
 //==========================================================================
 
+// Receives the output of FScriptPosition::Message on the thread that has
+// set it as FScriptPosition::Capture, so that messages produced on several
+// threads can still be printed in a fixed order.
+struct FScriptMessageBuffer
+{
+	struct Entry
+	{
+		int PrintLevel;
+		FString Text;
+	};
+	TArray<Entry> Messages;
+	int Errors = 0;
+	int Warnings = 0;
+
+	void Flush();
+};
+
 struct FScriptPosition
 {
 	static int WarnCounter;
 	static int ErrorCounter;
-	static bool StrictErrors;
+	static thread_local bool StrictErrors;
 	static bool errorout;
+	static thread_local FScriptMessageBuffer *Capture;
 	FName FileName;
 	int ScriptLine;
 
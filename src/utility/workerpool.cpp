@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------------
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// Worker pool shared by the engine's parallel loops
+//
+//-----------------------------------------------------------------------------
+
+#include <thread>
+#include <chrono>
+#include "workerpool.h"
+#include "templates.h"
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+ctpl::thread_pool &WorkerPool()
+{
+	static ctpl::thread_pool pool(MAX<int>(std::thread::hardware_concurrency() - 1, 1));
+	return pool;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void WorkerPoolWait(std::vector<std::future<void>> &jobs)
+{
+	auto &pool = WorkerPool();
+	for (auto &job : jobs)
+	{
+		while (job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			auto func = pool.pop();
+			if (!func)
+			{
+				job.wait();
+				break;
+			}
+			func(-1);
+		}
+	}
+
+	std::exception_ptr error;
+	for (auto &job : jobs)
+	{
+		try
+		{
+			job.get();
+		}
+		catch (...)
+		{
+			if (!error) error = std::current_exception();
+		}
+	}
+	jobs.clear();
+	if (error) std::rethrow_exception(error);
+}
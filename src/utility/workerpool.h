@@ -0,0 +1,18 @@
+#pragma once
+
+#include <future>
+#include <vector>
+#include "ctpl.h"
+
+// Worker threads shared by everything that splits its work into independent
+// jobs. The pool is started on first use with one thread less than the CPU
+// has cores, because the thread handing out the jobs usually takes a share
+// of the work itself.
+ctpl::thread_pool &WorkerPool();
+
+// Waits for jobs pushed to WorkerPool(). Jobs still queued are run on the
+// calling thread meanwhile, so a batch never waits for workers that are busy
+// with long-running background jobs. Jobs run that way get -1 as thread id.
+// Once all jobs are finished the first exception one of them threw is
+// rethrown.
+void WorkerPoolWait(std::vector<std::future<void>> &jobs);
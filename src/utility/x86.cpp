@@ -69,12 +69,37 @@ void DumpCPUInfo(const CPUInfo *cpu)
 #define __cpuid(output, func) __asm__ __volatile__("cpuid" : "=a" ((output)[0]),\
 	"=b" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) : "a" (func));
 #endif
+
+// Same as above, for the leaves that take a subleaf in ecx.
+#if defined(__i386__) && defined(__PIC__)
+#define __cpuidex(output, func, subfunc) \
+	__asm__ __volatile__("xchgl\t%%ebx, %1\n\t" \
+						 "cpuid\n\t" \
+						 "xchgl\t%%ebx, %1\n\t" \
+		: "=a" ((output)[0]), "=r" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) \
+		: "a" (func), "c" (subfunc));
+#else
+#define __cpuidex(output, func, subfunc) __asm__ __volatile__("cpuid" : "=a" ((output)[0]),\
+	"=b" ((output)[1]), "=c" ((output)[2]), "=d" ((output)[3]) : "a" (func), "c" (subfunc));
+#endif
+
+static inline uint64_t GetXCR0()
+{
+	uint32_t eax, edx;
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+	return ((uint64_t)edx << 32) | eax;
+}
+#else
+static inline uint64_t GetXCR0()
+{
+	return _xgetbv(0);
+}
 #endif
 
 void CheckCPUID(CPUInfo *cpu)
 {
 	int foo[4];
-	unsigned int maxext;
+	unsigned int maxstd, maxext;
 
 	memset(cpu, 0, sizeof(*cpu));
 
@@ -126,6 +151,7 @@ haveid:
 
 	// Get vendor ID
 	__cpuid(foo, 0);
+	maxstd = (unsigned int)foo[0];
 	cpu->dwVendorID[0] = foo[1];
 	cpu->dwVendorID[1] = foo[3];
 	cpu->dwVendorID[2] = foo[2];
@@ -164,6 +190,24 @@ haveid:
 		cpu->Model |= (foo[0] >> 12) & 0xF0;
 	}
 
+	// AVX2 and AVX-512 need both the CPU flags and the OS saving the
+	// YMM (and for AVX-512 also the ZMM/opmask) registers on context switches.
+	if (maxstd >= 7 && (cpu->FeatureFlags[1] & (1 << 27)))	// OSXSAVE
+	{
+		uint64_t xcr0 = GetXCR0();
+		__cpuidex(foo, 7, 0);
+		if ((xcr0 & 0x06) == 0x06)
+		{
+			cpu->bAVX2 = (foo[1] & (1 << 5)) != 0;
+		}
+		if ((xcr0 & 0xE6) == 0xE6)
+		{
+			// Only flag it when the byte/word instructions are there as well,
+			// the drawers work on 16-bit color channels.
+			cpu->bAVX512 = cpu->bAVX2 && (foo[1] & (1 << 16)) && (foo[1] & (1 << 30));
+		}
+	}
+
 	// Check for extended functions.
 	__cpuid(foo, 0x80000000);
 	maxext = (unsigned int)foo[0];
@@ -250,6 +294,8 @@ void DumpCPUInfo(const CPUInfo *cpu)
 		if (cpu->bSSSE3)		Printf(" SSSE3");
 		if (cpu->bSSE41)		Printf(" SSE4.1");
 		if (cpu->bSSE42)		Printf(" SSE4.2");
+		if (cpu->bAVX2)			Printf(" AVX2");
+		if (cpu->bAVX512)		Printf(" AVX-512");
 		if (cpu->b3DNow)		Printf(" 3DNow!");
 		if (cpu->b3DNowPlus)	Printf(" 3DNow!+");
 		if (cpu->HyperThreading)	Printf(" HyperThreading");
@@ -1046,6 +1046,11 @@ void DoMain (HINSTANCE hInstance)
 		I_DetectOS ();
 		D_DoomMain ();
 	}
+	catch (const CExitEvent &exit)	// This is a regular exit initiated from deeper in the code.
+	{
+		I_ShutdownGraphics();
+		::exit(exit.Reason());
+	}
 	catch (class CNoRunExit &)
 	{
 		I_ShutdownGraphics();